@@ -0,0 +1,31 @@
+#ifndef BUFFER_TEXTURE_H
+#define BUFFER_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// A buffer texture whose contents are replaced every frame: upload() orphans the
+// buffer and refills it, so the CPU does not wait for draws still reading the old data.
+class BufferTexture
+{
+public:
+    BufferTexture() = default;
+    ~BufferTexture();
+    BufferTexture(const BufferTexture &) = delete;
+    BufferTexture &operator=(const BufferTexture &) = delete;
+
+    // creates the buffer and a texture reading it as `format` texels, sampled from `unit`
+    void create(GLenum format, unsigned int unit);
+    bool created() const { return buffer != 0; }
+    // replaces the contents with `bytes` of `data`
+    void upload(const void *data, size_t bytes);
+    // binds the texture to its unit
+    void bind() const;
+
+private:
+    GLuint buffer = 0, texture = 0;
+    unsigned int unit = 0;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Bounding volume hierarchy over world space triangles, for the offline bakers that trace rays
+// through the scene on the CPU. Built top-down by splitting the centroids at the median of the
+// longest axis; nodes are stored depth first so the left child always follows its parent.
+class TriangleBvh
+{
+public:
+    struct Triangle
+    {
+        glm::vec3 v0, v1, v2;
+        unsigned int id;    // caller's tag, e.g. the mesh it came from
+    };
+    struct Hit
+    {
+        float t;            // distance along the (unit) direction
+        float u, v;         // barycentric coordinates of v1 and v2
+        unsigned int triangle;
+    };
+
+    void build(const std::vector<Triangle> &triangles);
+
+    // nearest triangle along origin + t * dir with 0 < t < maxT, false when the ray escapes
+    bool intersect(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, Hit &hit) const;
+    // true as soon as any triangle blocks the segment, for shadow rays
+    bool occluded(const glm::vec3 &origin, const glm::vec3 &dir, float maxT) const;
+
+    const Triangle &triangle(unsigned int index) const { return triangles[index]; }
+    size_t triangleCount() const { return triangles.size(); }
+    bool empty() const { return nodes.empty(); }
+
+private:
+    static const unsigned int LEAF_SIZE = 4;
+
+    struct Node
+    {
+        glm::vec3 boundsMin, boundsMax;
+        unsigned int first;     // leaf: first triangle, inner node: the right child
+        unsigned int count;     // triangles in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+
+    unsigned int buildNode(std::vector<glm::vec3> &centroids, unsigned int first, unsigned int count);
+    template <bool AnyHit>
+    bool trace(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, Hit &hit) const;
+};
+
+#endif
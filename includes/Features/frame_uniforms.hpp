@@ -0,0 +1,34 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+// Mirrors of the std140 `Frame` uniform block declared in mainvertex.vs / mainfragment.fs
+// (lightvertex.vs declares only the camera part). Written once per frame into frameUploads.
+// In std140 a vec3 takes 16 bytes unless a float follows it, hence the padding.
+
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+struct DirLightUniforms {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient; float pad1;
+    glm::vec3 diffuse; float pad2;
+    glm::vec3 specular; float pad3;
+};
+
+struct FrameUniforms {
+    VecMat::mat4 projection;
+    VecMat::mat4 view;
+    glm::vec3 viewPos;
+    unsigned int lightmaps;         // non zero: lightmapped surfaces take the baked lights from there
+    DirLightUniforms dirLight;
+    // the point lights are binned into clusters (LightClusters in light_clusters.hpp)
+    glm::vec4 clusterScale;         // xy: clusters per pixel, zw: slice = log(depth) * z + w
+    unsigned int clusterDims[4];    // clusters across, up and deep, and the light count
+};
+
+static_assert(sizeof(DirLightUniforms) == 64, "DirLight does not match std140");
+static_assert(sizeof(FrameUniforms) == 240, "Frame block does not match std140");
+
+#endif
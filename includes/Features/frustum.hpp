@@ -0,0 +1,42 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+// clip = projection * view, [column][row] like VecMat
+void clipMatrix(const VecMat::mat4 &projection, const VecMat::mat4 &view, float out[4][4]);
+
+// View frustum as six planes (left, right, bottom, top, near, far) pointing inwards,
+// extracted from the combined projection * view matrix (Gribb & Hartmann).
+// Planes are stored as structure of arrays so four of them are tested per SSE instruction.
+class Frustum
+{
+public:
+    Frustum();
+
+    // the side planes can be pulled in to a rectangle of normalised device coordinates,
+    // e.g. the screen space bounds of a portal
+    void extract(const VecMat::mat4 &projection, const VecMat::mat4 &view,
+                 float left = -1.0f, float right = 1.0f, float bottom = -1.0f, float top = 1.0f);
+
+    // false only when the box / sphere is completely outside one of the planes
+    bool intersectsBox(const glm::vec3 &center, const glm::vec3 &extent) const;
+    bool intersectsSphere(const glm::vec3 &center, float radius) const;
+    // plane i (left, right, bottom, top, near, far) as normal and distance, for shaders doing the same test
+    void plane(int i, float out[4]) const { out[0] = nx[i]; out[1] = ny[i]; out[2] = nz[i]; out[3] = d[i]; }
+
+private:
+    // padded to 8 planes by repeating the near plane
+    alignas(16) float nx[8], ny[8], nz[8], d[8];
+};
+
+// axis aligned box in model space -> enclosing axis aligned box in world space (center / half extent form)
+void transformBox(const VecMat::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                  glm::vec3 &center, glm::vec3 &extent);
+
+// bounding sphere in model space -> world space, the radius follows the largest axis scale
+void transformSphere(const VecMat::mat4 &transform, const glm::vec3 &center, float radius,
+                     glm::vec3 &worldCenter, float &worldRadius);
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include "glstate.hpp"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// First-fit free-list allocator over a range of elements [0, capacity).
+// Freed blocks are merged with their neighbours so the list stays short.
+class RangeAllocator
+{
+public:
+    static const unsigned int INVALID = 0xffffffffu;
+
+    explicit RangeAllocator(unsigned int capacity = 0);
+
+    unsigned int allocate(unsigned int count);   // returns INVALID when no block is large enough
+    void free(unsigned int offset, unsigned int count);
+    void grow(unsigned int newCapacity);          // the new space is appended as a free block
+
+    unsigned int capacity() const { return total; }
+    unsigned int used() const { return total - freeCount; }
+    unsigned int freeBlocks() const { return (unsigned int)blocks.size(); }
+    unsigned int largestFreeBlock() const;
+
+private:
+    std::map<unsigned int, unsigned int> blocks;  // offset -> size of every free block
+    unsigned int total;
+    unsigned int freeCount;
+};
+
+// Where a mesh lives inside the arena buffers.
+struct GeometryRange
+{
+    unsigned int baseVertex = 0;
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+// layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    size_t offset;
+};
+
+// One big vertex buffer and one big index buffer shared by every mesh of a vertex format,
+// with a single VAO. Meshes are sub-allocated and drawn with base vertex / first index offsets.
+// The buffers grow (copying on the GPU) when an allocation does not fit, and like the
+// per-mesh buffers they replace they live until the context goes away.
+// With direct state access the buffers get immutable storage and are edited without binding.
+class GeometryArena
+{
+public:
+    struct Stats
+    {
+        unsigned int vertexCapacity, vertexUsed;
+        unsigned int indexCapacity, indexUsed;
+        unsigned int freeBlocks;
+        float occupancy;        // used / capacity over both buffers, in bytes
+        float fragmentation;    // 1 - largest free block / all free space, worst of both buffers
+    };
+
+    GeometryArena(GLsizei vertexStride, const std::vector<VertexAttribute> &attributes,
+                  unsigned int vertexCapacity = 1 << 16, unsigned int indexCapacity = 1 << 18);
+
+    GeometryRange allocate(const void *vertices, unsigned int vertexCount,
+                           const unsigned int *indices, unsigned int indexCount);
+    void free(const GeometryRange &range);
+
+    void bind() const { glState.bindVertexArray(VAO); }
+    GLuint vertexArray() const { return VAO; }
+    // draws `count` indices starting `indexOffset` indices into the range, `instances` times
+    void draw(const GeometryRange &range, unsigned int indexOffset, unsigned int count, unsigned int instances = 1) const;
+    // the same draw as an indirect command, instanced attributes start at `baseInstance`
+    static DrawElementsIndirectCommand command(const GeometryRange &range, unsigned int indexOffset, unsigned int count,
+                                               unsigned int instances, unsigned int baseInstance);
+
+    Stats stats() const;
+
+private:
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+    RangeAllocator vertexSpace, indexSpace;
+    GLuint VAO, VBO, EBO;
+
+    void createBuffers();
+    GLuint createBuffer(size_t bytes);
+    void attachVertexBuffer();
+    void attachElementBuffer();
+    void upload(GLuint buffer, size_t offset, size_t bytes, const void *data);
+    GLuint resize(GLuint buffer, size_t oldBytes, size_t newBytes);
+};
+
+#endif
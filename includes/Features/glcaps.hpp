@@ -0,0 +1,141 @@
+#ifndef GLCAPS_H
+#define GLCAPS_H
+
+#include <glad/glad.h>
+
+// The bundled glad only covers OpenGL 3.3 core. The few newer entry points the renderer can
+// use are loaded here at runtime, next to what the context turned out to support.
+// A glad generated for 4.x defines these names itself, in which case this block steps aside.
+#ifndef GL_VERSION_4_3
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect,
+                                                            GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLCLEARBUFFERDATAPROC)(GLenum target, GLenum internalformat, GLenum format, GLenum type,
+                                                  const void *data);
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glcaps_glMultiDrawElementsIndirect;
+extern PFNGLDISPATCHCOMPUTEPROC glcaps_glDispatchCompute;
+extern PFNGLMEMORYBARRIERPROC glcaps_glMemoryBarrier;
+extern PFNGLCLEARBUFFERDATAPROC glcaps_glClearBufferData;
+#define glMultiDrawElementsIndirect glcaps_glMultiDrawElementsIndirect
+#define glDispatchCompute glcaps_glDispatchCompute
+#define glMemoryBarrier glcaps_glMemoryBarrier
+#define glClearBufferData glcaps_glClearBufferData
+#endif
+
+// GL 4.4 / ARB_buffer_storage: immutable buffers, optionally mapped for as long as they live
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+extern PFNGLBUFFERSTORAGEPROC glcaps_glBufferStorage;
+#define glBufferStorage glcaps_glBufferStorage
+#endif
+
+// GL 4.5 / ARB_direct_state_access: objects are created and edited by name, without binding
+#ifndef GL_VERSION_4_5
+
+typedef void (APIENTRYP PFNGLCREATEBUFFERSPROC)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSTORAGEPROC)(GLuint buffer, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data);
+typedef void (APIENTRYP PFNGLCOPYNAMEDBUFFERSUBDATAPROC)(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset,
+                                                         GLintptr writeOffset, GLsizeiptr size);
+typedef void (APIENTRYP PFNGLCREATEVERTEXARRAYSPROC)(GLsizei n, GLuint *arrays);
+typedef void (APIENTRYP PFNGLVERTEXARRAYVERTEXBUFFERPROC)(GLuint vaobj, GLuint bindingindex, GLuint buffer,
+                                                          GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXARRAYELEMENTBUFFERPROC)(GLuint vaobj, GLuint buffer);
+typedef void (APIENTRYP PFNGLENABLEVERTEXARRAYATTRIBPROC)(GLuint vaobj, GLuint index);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBFORMATPROC)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type,
+                                                          GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBBINDINGPROC)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n, GLuint *textures);
+typedef void (APIENTRYP PFNGLTEXTURESTORAGE2DPROC)(GLuint texture, GLsizei levels, GLenum internalformat,
+                                                   GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE2DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+                                                    GLsizei width, GLsizei height, GLenum format, GLenum type,
+                                                    const void *pixels);
+typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE3DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+                                                    GLint zoffset, GLsizei width, GLsizei height, GLsizei depth,
+                                                    GLenum format, GLenum type, const void *pixels);
+typedef void (APIENTRYP PFNGLTEXTUREPARAMETERIPROC)(GLuint texture, GLenum pname, GLint param);
+typedef void (APIENTRYP PFNGLGENERATETEXTUREMIPMAPPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLBINDTEXTUREUNITPROC)(GLuint unit, GLuint texture);
+
+extern PFNGLCREATEBUFFERSPROC glcaps_glCreateBuffers;
+extern PFNGLNAMEDBUFFERSTORAGEPROC glcaps_glNamedBufferStorage;
+extern PFNGLNAMEDBUFFERSUBDATAPROC glcaps_glNamedBufferSubData;
+extern PFNGLCOPYNAMEDBUFFERSUBDATAPROC glcaps_glCopyNamedBufferSubData;
+extern PFNGLCREATEVERTEXARRAYSPROC glcaps_glCreateVertexArrays;
+extern PFNGLVERTEXARRAYVERTEXBUFFERPROC glcaps_glVertexArrayVertexBuffer;
+extern PFNGLVERTEXARRAYELEMENTBUFFERPROC glcaps_glVertexArrayElementBuffer;
+extern PFNGLENABLEVERTEXARRAYATTRIBPROC glcaps_glEnableVertexArrayAttrib;
+extern PFNGLVERTEXARRAYATTRIBFORMATPROC glcaps_glVertexArrayAttribFormat;
+extern PFNGLVERTEXARRAYATTRIBBINDINGPROC glcaps_glVertexArrayAttribBinding;
+extern PFNGLCREATETEXTURESPROC glcaps_glCreateTextures;
+extern PFNGLTEXTURESTORAGE2DPROC glcaps_glTextureStorage2D;
+extern PFNGLTEXTURESUBIMAGE2DPROC glcaps_glTextureSubImage2D;
+extern PFNGLTEXTURESUBIMAGE3DPROC glcaps_glTextureSubImage3D;
+extern PFNGLTEXTUREPARAMETERIPROC glcaps_glTextureParameteri;
+extern PFNGLGENERATETEXTUREMIPMAPPROC glcaps_glGenerateTextureMipmap;
+extern PFNGLBINDTEXTUREUNITPROC glcaps_glBindTextureUnit;
+#define glCreateBuffers glcaps_glCreateBuffers
+#define glNamedBufferStorage glcaps_glNamedBufferStorage
+#define glNamedBufferSubData glcaps_glNamedBufferSubData
+#define glCopyNamedBufferSubData glcaps_glCopyNamedBufferSubData
+#define glCreateVertexArrays glcaps_glCreateVertexArrays
+#define glVertexArrayVertexBuffer glcaps_glVertexArrayVertexBuffer
+#define glVertexArrayElementBuffer glcaps_glVertexArrayElementBuffer
+#define glEnableVertexArrayAttrib glcaps_glEnableVertexArrayAttrib
+#define glVertexArrayAttribFormat glcaps_glVertexArrayAttribFormat
+#define glVertexArrayAttribBinding glcaps_glVertexArrayAttribBinding
+#define glCreateTextures glcaps_glCreateTextures
+#define glTextureStorage2D glcaps_glTextureStorage2D
+#define glTextureSubImage2D glcaps_glTextureSubImage2D
+#define glTextureSubImage3D glcaps_glTextureSubImage3D
+#define glTextureParameteri glcaps_glTextureParameteri
+#define glGenerateTextureMipmap glcaps_glGenerateTextureMipmap
+#define glBindTextureUnit glcaps_glBindTextureUnit
+#endif
+
+// GL 4.6 / ARB_indirect_parameters: the draw count of a multi-draw read from a buffer
+#ifndef GL_VERSION_4_6
+#define GL_PARAMETER_BUFFER 0x80EE
+
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)(GLenum mode, GLenum type, const void *indirect,
+                                                                 GLintptr drawcount, GLsizei maxdrawcount,
+                                                                 GLsizei stride);
+extern PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC glcaps_glMultiDrawElementsIndirectCount;
+#define glMultiDrawElementsIndirectCount glcaps_glMultiDrawElementsIndirectCount
+#endif
+
+struct GlCapabilities {
+    int major = 3, minor = 3;
+    bool baseInstance = false;       // GL 4.2 / ARB_base_instance: instanced attributes honour baseInstance
+    bool multiDrawIndirect = false;  // GL 4.3 / ARB_multi_draw_indirect
+    bool conservativeQueries = false; // GL 4.3 / ARB_ES3_compatibility: GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+    bool computeShaders = false;     // GL 4.3 / ARB_compute_shader with shader storage buffers
+    bool indirectCount = false;      // GL 4.6 / ARB_indirect_parameters
+    bool bufferStorage = false;      // GL 4.4 / ARB_buffer_storage: persistent, coherent mappings
+    bool directStateAccess = false;  // GL 4.5 / ARB_direct_state_access: buffers, textures and VAOs are
+                                     // created with immutable storage and edited without binding
+    int maxTextureBufferSize = 65536; // texels a buffer texture can hold, 3.3 guarantees 65536
+};
+
+// texture levels down to 1x1, what glTextureStorage2D needs to be told up front
+int mipLevels(int width, int height);
+
+extern GlCapabilities glCaps;
+
+// call once after gladLoadGLLoader, with the same loader
+void loadGlCapabilities(GLADloadproc load);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Shadow copy of the GL bindings the renderer changes. Every setter compares against what it
+// last set and only calls into GL when the value actually changes; frameStats counts both.
+// All binds have to go through it, otherwise the copy goes stale (invalidate() recovers).
+class GlState
+{
+public:
+    static const unsigned int TEXTURE_UNITS = 16;
+
+    GlState() { invalidate(); }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // indexed bindings (uniform blocks, shader storage) always go to GL; they bind the buffer to
+    // the target's generic point as well, which the cache follows
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, size_t bytes);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+    void activeTexture(unsigned int unit);
+    void bindTexture(GLenum target, GLuint texture);                     // on the active unit
+    void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void colorMask(bool write);                         // all four channels
+    void setEnabled(GLenum capability, bool enabled);   // GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE
+    void blendFunc(GLenum source, GLenum destination);
+
+    // deleting an object unbinds it in GL, the cache has to follow
+    void bufferDeleted(GLuint buffer);
+
+    // forget everything, the next call of each setter goes to GL
+    void invalidate();
+
+private:
+    enum { BUFFER_TARGETS = 9, TEXTURE_TARGETS = 4, CAPABILITIES = 3 };
+    static const GLuint UNKNOWN = 0xffffffffu;
+
+    GLuint program, vertexArray;
+    GLuint buffers[BUFFER_TARGETS];
+    unsigned int unit;
+    GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLuint depth, depthWrite, colorWrite, blendSource, blendDestination;
+    GLuint capabilities[CAPABILITIES];
+
+    static bool update(GLuint &cached, GLuint value);
+};
+
+extern GlState glState;
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include "frustum.hpp"
+#include "gpu_timer.hpp"
+#include "mesh.hpp"
+#include "render_queue.hpp"
+#include "shader.hpp"
+
+#include <vector>
+
+// one mesh draw as the compute shader reads it (std430, the DrawRecord struct in cull.comp)
+struct GpuDrawRecord
+{
+    float boundsMin[3];
+    GLuint object;
+    float boundsMax[3];
+    GLuint group;
+    float sphereCenter[3];
+    float sphereRadius;
+    GLuint firstIndex[LOD_MAX_LEVELS];
+    GLuint indexCount[LOD_MAX_LEVELS];
+    GLint baseVertex;
+    GLuint levels;
+    GLuint pad[2];
+};
+
+// GPU-driven culling. Every registered mesh becomes a record in a shader storage buffer, with
+// its model space bounds, its levels of detail in the mesh's vertexArena() and the slot of its
+// transform.
+// Each frame a compute shader tests all records against the frustum, picks a level and appends
+// the draws that survive to an indirect buffer, packed per material. Drawing is then one
+// glMultiDrawElementsIndirect per material, whatever the number of objects; the CPU only
+// uploads the transforms that changed. The transforms double as the per instance model matrices
+// (base instance = slot), so nothing is copied per draw.
+// Without GL 4.6 the unused tail of each material's range is cleared to empty commands, with it
+// the GPU reads the draw counts itself (glMultiDrawElementsIndirectCount).
+class GpuCulling
+{
+public:
+    static const unsigned int WORKGROUP_SIZE = 64;  // local_size_x in cull.comp
+
+    GpuCulling() = default;
+    ~GpuCulling();
+    GpuCulling(const GpuCulling &) = delete;
+    GpuCulling &operator=(const GpuCulling &) = delete;
+
+    // loads the compute program; false when the context has no compute shaders or multi-draw
+    // indirect, and then nothing else may be called
+    bool init(const char *computePath);
+    bool available() const { return program != nullptr; }
+
+    // a transform slot, the objects' meshes are drawn with it
+    unsigned int addObject(const VecMat::mat4 &transform);
+    void setTransform(unsigned int object, const VecMat::mat4 &transform);
+    // the mesh (every level of it) drawn with the slot's transform
+    void addMesh(unsigned int object, const Mesh &mesh);
+
+    // tests every record on the GPU and writes this frame's indirect commands
+    void cull(const Frustum &frustum, const glm::vec3 &eye, float tanHalfFov, const float lodScreenSize[LOD_MAX_LEVELS - 1]);
+    // draws what survived with `shader` (instanced), depth GL_LESS; `queue` is the render queue
+    // that draws from the same arenas, its instance arrays are released for the model matrices
+    void draw(const Shader &shader, RenderQueue &queue);
+
+    unsigned int recordCount() const { return (unsigned int)records.size(); }
+    // buffers for checking the results (GpuCullCheck): commands packed per group, counts per group
+    GLuint commandBuffer() const { return commandsBuffer; }
+    GLuint countBuffer() const { return countsBuffer; }
+    const std::vector<GLuint> &groupOffsets() const { return offsets; }
+
+private:
+    struct Group
+    {
+        unsigned int material;
+        const Mesh *mesh;           // any mesh of the material, to bind it
+    };
+
+    Shader *program = nullptr;
+    std::vector<GpuDrawRecord> records;
+    std::vector<const Mesh *> recordMeshes;     // records[i] draws recordMeshes[i]
+    std::vector<Group> groups;
+    std::vector<GLuint> offsets;                // first command of each group
+    std::vector<VecMat::mat4> transforms;
+    unsigned int dirtyBegin = 0, dirtyEnd = 0;  // transforms changed since the last upload
+    bool recordsDirty = false;
+    GLuint recordsBuffer = 0, transformsBuffer = 0, offsetsBuffer = 0, countsBuffer = 0, commandsBuffer = 0;
+    size_t transformCapacity = 0;
+    GpuTimer timer;
+
+    void uploadRecords();
+    void uploadTransforms();
+};
+
+#endif
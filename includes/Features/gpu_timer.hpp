@@ -0,0 +1,27 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// Measures the GPU time of the commands between begin() and end() with GL_TIME_ELAPSED
+// queries. Results are read a few frames later, once the GPU has them, so reading never
+// stalls; milliseconds() is the latest one that came back. Only one timer can run at a time.
+class GpuTimer
+{
+public:
+    void begin();
+    void end();
+    float milliseconds() const { return last; }
+
+private:
+    static const unsigned int QUERIES = 4;
+    GLuint queries[QUERIES] = {};
+    bool pending[QUERIES] = {};
+    unsigned int next = 0;
+    bool running = false;
+    float last = 0.0f;
+
+    void collect();
+};
+
+#endif
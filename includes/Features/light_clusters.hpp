@@ -0,0 +1,113 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include "buffer_texture.hpp"
+#include "frame_uniforms.hpp"
+#include "material.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// how far a point light's shadow reaches at most, past it everything is lit
+const float SHADOW_MAX_RANGE = 100.0f;
+
+// A point light. Its radius is where the attenuated light drops below LIGHT_CUTOFF of its
+// brightest colour; nothing past it is lit by it.
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 ambient, diffuse, specular;
+    float constant = 1.0f, linear = 0.0f, quadratic = 0.0f;
+    float radius = 0.0f;    // 0: computed by LightClusters::add
+    int shadow = -1;        // its slot in ShadowMaps (shadow_maps.hpp), -1 casts no shadows
+    bool baked = false;     // in the lightmaps (lightmap.hpp), surfaces that have one leave it out
+
+    float shadowRange() const { return std::min(radius, SHADOW_MAX_RANGE); }
+};
+
+// The lights one draw shades with instead of its clusters' lists, as indices into the light
+// buffer (a per instance attribute, aLights in mainvertex.vs). Unused slots hold END; CLUSTERED
+// in the first slot means the draw has no list of its own.
+struct DrawLights {
+    static const uint16_t END = 0xffff;
+    static const uint16_t CLUSTERED = 0xfffe;
+    static const unsigned int COUNT = 4;
+
+    uint16_t index[COUNT] = {CLUSTERED, END, END, END};
+};
+
+// Clustered forward lighting. The view frustum is cut into TILES_X * TILES_Y screen tiles and
+// SLICES depth slices (exponentially spaced, so near clusters stay small). Each frame the
+// lights are binned on the CPU: every cluster gets the list of lights whose sphere of influence
+// touches its box. The fragment shader looks up its own cluster and shades only those lights,
+// so the cost per fragment follows the lights nearby rather than all lights in the scene.
+// The lights, the per cluster (offset, count) pairs and the light lists go to the shader as
+// buffer textures, which GL 3.3 has; they are orphaned and refilled every frame.
+class LightClusters
+{
+public:
+    static const unsigned int TILES_X = 16;     // same aspect as the window
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTERS = TILES_X * TILES_Y * SLICES;
+    static const unsigned int MAX_LIGHTS = DrawLights::CLUSTERED;   // light indices are 16 bit
+    static const unsigned int LIGHT_TEXELS = 5;     // RGBA32F texels per light in clusterLights
+
+    static float influenceRadius(const PointLight &light);
+    // MAX_LIGHTS, or fewer when the driver's buffer textures can't hold that many lights' texels
+    static unsigned int lightCapacity();
+
+    // starts a new frame's set of lights
+    void clear()
+    {
+        lights.clear();
+        droppedLights = 0;
+    }
+    // lights whose radius comes out as 0 are dropped, as are those past lightCapacity()
+    // (counted in frameStats)
+    void add(PointLight light);
+    const std::vector<PointLight> &all() const { return lights; }
+
+    // bins the lights for this camera (a symmetric perspective projection) and a width x height
+    // framebuffer, uploads the buffers and fills in the cluster fields of `frame`
+    void build(const VecMat::mat4 &projection, const VecMat::mat4 &view, int width, int height, FrameUniforms &frame);
+    // binds the buffer textures to their units (TEXTURE_CLUSTER_*)
+    void bind() const;
+    // the last build()'s binning as uploaded, for checking it (LightClusterCheck): (offset,
+    // count) per cluster into the light lists
+    const std::vector<uint32_t> &clusterGrid() const { return grid; }
+    const std::vector<uint16_t> &clusterIndices() const { return indices; }
+
+    // the DrawLights::COUNT lights that matter most for a world box (center / half extent):
+    // of those whose sphere reaches it, the brightest at its nearest point. Only lights that
+    // went into the last build() can be picked; with `skipBaked` the baked ones neither, for
+    // draws that have them from a lightmap or the probes
+    void select(const glm::vec3 &center, const glm::vec3 &extent, DrawLights &out, bool skipBaked = false) const;
+
+private:
+    struct Box
+    {
+        glm::vec3 min, max;
+    };
+
+    std::vector<PointLight> lights;
+    std::vector<float> brightest;           // per light, its brightest colour component
+    std::vector<Box> boxes;                 // view space bounds of every cluster
+    float boxesFor[4] = {0, 0, 0, 0};       // the projection they were computed for: x / y scale, near, far
+    std::vector<uint32_t> hitCluster;       // (cluster, light) pairs found by binning
+    std::vector<uint16_t> hitLight;
+    std::vector<uint32_t> grid;             // offset and count per cluster
+    std::vector<uint16_t> indices;
+    std::vector<glm::vec4> texels;          // LIGHT_TEXELS per light
+    unsigned int droppedLights = 0;         // added past lightCapacity() since clear()
+    BufferTexture textures[3];              // lights, grid, indices
+
+    void create();
+    void computeBoxes(float scaleX, float scaleY, float nearPlane, float farPlane);
+};
+
+#endif
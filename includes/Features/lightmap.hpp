@@ -0,0 +1,65 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// lightmap resolution: texels per world unit, cut back for meshes that wouldn't fit LIGHTMAP_MAX_SIZE
+const float LIGHTMAP_TEXELS_PER_UNIT = 16.0f;
+const unsigned int LIGHTMAP_MAX_SIZE = 1024;
+// texels left around every chart, the baker fills them from the chart's edge so that bilinear
+// filtering never reads another chart
+const unsigned int LIGHTMAP_PADDING = 2;
+
+// Gives a static mesh (world space, full detail indices only) its second UV set. Triangles are
+// grouped into charts: connected triangles facing the same way along one axis, projected onto
+// that axis's plane at LIGHTMAP_TEXELS_PER_UNIT. The charts are shelf packed into one square
+// lightmap per mesh. Vertices on a chart border are split, one copy per chart, and
+// `lightmapCoords` gets each vertex's place in the lightmap.
+// Returns the lightmap's size in texels, 0 (and nothing changed) when even a much coarser
+// layout doesn't fit. Deterministic, so the renderer and LightmapBake arrive at the same layout
+// from the same geometry.
+unsigned int unwrapLightmap(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                            std::vector<glm::vec2> &lightmapCoords);
+
+// The baked lighting of every static mesh, in the renderer's mesh order (the same as the
+// potentially visible set's): a size x size grid of RGB values per mesh, written by
+// LightmapBake. Each value is the light arriving at the surface, what the shader multiplies the
+// diffuse texture with, so lightmapped surfaces cost one texture fetch for all baked lights.
+class LightmapSet
+{
+public:
+    // one black lightmap per mesh
+    void create(const std::vector<unsigned int> &sizes, uint32_t signature);
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+    void clear() { sizes.clear(); offsets.clear(); values.clear(); }
+    bool loaded() const { return !sizes.empty(); }
+
+    unsigned int meshCount() const { return (unsigned int)sizes.size(); }
+    unsigned int size(unsigned int mesh) const { return sizes[mesh]; }
+    // row 0 is at lightmap coordinate y = 0
+    glm::vec3 *texels(unsigned int mesh) { return &values[offsets[mesh]]; }
+    const glm::vec3 *texels(unsigned int mesh) const { return &values[offsets[mesh]]; }
+    uint32_t signature() const { return hash; }
+
+    // a half float texture of one mesh's lightmap, for Mesh::setLightmap
+    GLuint upload(unsigned int mesh) const;
+
+    // fingerprint of the unwrapped static meshes (index and vertex counts, lightmap sizes)
+    static uint32_t signatureOf(const std::vector<unsigned int> &meshCounts);
+
+private:
+    std::vector<unsigned int> sizes;
+    std::vector<size_t> offsets;
+    std::vector<glm::vec3> values;
+    uint32_t hash = 0;
+};
+
+#endif
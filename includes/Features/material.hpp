@@ -0,0 +1,50 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+// Texture unit of every sampler the main shader knows (material.diffuse / material.specular /
+// material.lightmap in mainfragment.fs). The sampler uniforms are pointed at these once, when
+// the program is set up.
+enum Material_Slot {
+    MATERIAL_DIFFUSE,
+    MATERIAL_SPECULAR,
+    MATERIAL_NORMAL,
+    MATERIAL_HEIGHT,
+    MATERIAL_LIGHTMAP,  // baked by LightmapBake, only static meshes have one
+    MATERIAL_SLOTS
+};
+
+// Units after the material's, for the textures the main shader reads per frame rather than
+// per mesh; pointed at once like the material's.
+enum Frame_Texture_Unit {
+    TEXTURE_CLUSTER_LIGHTS = MATERIAL_SLOTS,    // clusterLights (LightClusters)
+    TEXTURE_CLUSTER_GRID,                       // clusterGrid
+    TEXTURE_CLUSTER_INDICES,                    // clusterIndices
+    TEXTURE_SHADOW_MAPS,                        // shadowMaps (ShadowMaps)
+    TEXTURE_PROBES                              // probeCoefficients (ProbeLighting)
+};
+
+const float MATERIAL_DEFAULT_SHININESS = 32.0f;
+
+// A material resolved once at load time: the GL texture for each unit plus its constant
+// parameters. Binding it is a handful of integer calls, no uniform names are looked up.
+struct MaterialBinding {
+    GLuint textures[MATERIAL_SLOTS] = {0, 0, 0, 0, 0};  // 0: nothing on that unit
+    float shininess = MATERIAL_DEFAULT_SHININESS;       // specular exponent, Ns in the .mtl
+    unsigned int id = 0;                                // equal tables share an id, see registerMaterial
+
+    // binds the textures to their units and sets the shininess (skipped for location -1),
+    // the program has to be bound already
+    void bind(GLint shininessLocation) const;
+};
+
+// slot for the mesh texture type names ("texture_diffuse", ...), -1 for unknown ones
+int materialSlot(const std::string &type);
+
+// small id for a binding table, starting at 1; equal tables get the same id
+unsigned int registerMaterial(const MaterialBinding &binding);
+
+#endif
@@ -6,124 +6,283 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "shader.hpp"
+#include "vertex.hpp"
+#include "geometry_arena.hpp"
+#include "material.hpp"
+#include "simplify.hpp"
+#include "stats.hpp"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
+// one level of detail; every level indexes into the same vertex buffer
+struct MeshLod {
+    unsigned int indexOffset;   // first index of this level inside `indices`
+    unsigned int indexCount;
+    float error;                // simplification error in object space (0 for the full mesh)
 };
 
+// LOD chain generation
+const unsigned int LOD_MAX_LEVELS = 4;
+const unsigned int LOD_MIN_TRIANGLES = 256;     // smaller meshes are always drawn at full detail
+const float LOD_REDUCTION = 0.5f;               // each level keeps this fraction of the previous one
+
 struct Textures {
     unsigned int id;
     string type;
     string path;
+    int width = 0, height = 0;  // size of the image file, 0 when it couldn't be read
+    int channels = 0;           // channels stored in the file (uploaded as RGBA8 regardless)
 };
 
+// every Vertex-format mesh is sub-allocated from this arena (created on first use, needs a GL context)
+inline GeometryArena &meshArena()
+{
+    static GeometryArena *arena = new GeometryArena(sizeof(Vertex), {
+        {0, 3, GL_FLOAT, offsetof(Vertex, Position)},
+        {1, 3, GL_FLOAT, offsetof(Vertex, Normal)},
+        {2, 2, GL_FLOAT, offsetof(Vertex, TexCoords)}});
+    return *arena;
+}
+
+// Static batches unwrapped for a lightmap live here instead, their vertices carrying the
+// lightmap coordinates as attribute 8 (3-7 are per instance, render_queue.hpp); every other
+// mesh stays at sizeof(Vertex).
+inline GeometryArena &lightmappedArena()
+{
+    static GeometryArena *arena = new GeometryArena(sizeof(LightmappedVertex), {
+        {0, 3, GL_FLOAT, offsetof(LightmappedVertex, vertex) + offsetof(Vertex, Position)},
+        {1, 3, GL_FLOAT, offsetof(LightmappedVertex, vertex) + offsetof(Vertex, Normal)},
+        {2, 2, GL_FLOAT, offsetof(LightmappedVertex, vertex) + offsetof(Vertex, TexCoords)},
+        {8, 2, GL_FLOAT, offsetof(LightmappedVertex, LightmapCoords)}});
+    return *arena;
+}
+
+// Depth-only passes (prepass, shadows, occlusion) read positions from this arena: 12 bytes
+// per vertex instead of sizeof(Vertex), and fewer vertices since seams are welded.
+inline GeometryArena &positionArena()
+{
+    static GeometryArena *arena = new GeometryArena(3 * sizeof(float), {{0, 3, GL_FLOAT, 0}});
+    return *arena;
+}
+
+// uploads a position-only stream next to each mesh, set before models are loaded
+inline bool keepPositionStreams = true;
+
 class Mesh {
 public:
     /*  Mesh Data  */
     vector<Vertex> vertices;
-    vector<unsigned int> indices;
+    vector<unsigned int> indices;   // all LODs back to back, full detail first
+    vector<glm::vec2> lightmapCoords;   // per vertex, only static batches unwrapped for a lightmap have them
+    vector<MeshLod> lods;
     vector<Textures> textures;
-    unsigned int VAO;
+    MaterialBinding material;       // textures by unit and shininess, resolved from `textures` once
+    GeometryRange geometry;         // where the vertices and indices live in vertexArena()
+    GeometryRange positionGeometry; // the position-only stream in positionArena(), empty without one
+    glm::vec3 boundsMin, boundsMax; // axis aligned bounding box of the vertices
+    glm::vec3 sphereCenter;         // bounding sphere around the box center
+    float sphereRadius;
+    unsigned int lightmapSize = 0;  // texels across the lightmap lightmapCoords point into, 0 without one
 
     /*  Functions  */
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Textures> textures)
+    // constructor, upload = false keeps the mesh on the CPU only (tools that run without a GL context)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Textures> textures, bool upload = true,
+         float shininess = MATERIAL_DEFAULT_SHININESS, vector<glm::vec2> lightmapCoords = {})
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->lightmapCoords = lightmapCoords;
+        resolveMaterial(shininess);
+        computeBounds();
+
+        // simplified index lists are appended to `indices` before the upload
+        buildLods();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            setupMesh();
+    }
+
+    // the arena holding the mesh's vertices: lightmappedArena() once it has lightmap coordinates
+    GeometryArena &vertexArena() const
+    {
+        return lightmapCoords.empty() ? meshArena() : lightmappedArena();
     }
 
-    // render the mesh
-    void Draw(Shader shader) 
+    // binds the material's textures to their fixed units (see Material_Slot) and sets its shininess
+    void bindMaterial(GLint shininessLocation) const
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        material.bind(shininessLocation);
+    }
+
+    // issues the draw call for one level, the vertexArena() VAO has to be bound already
+    void drawGeometry(unsigned int lod, unsigned int instances = 1) const
+    {
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        vertexArena().draw(geometry, level.indexOffset, level.indexCount, instances);
+        frameStats.drawCalls++;
+        frameStats.instances += instances;
+        frameStats.triangles += (unsigned long long)(level.indexCount / 3) * instances;
+    }
+
+    bool hasPositionStream() const { return positionGeometry.indexCount > 0; }
+
+    // same as drawGeometry from the position-only stream, positionArena() has to be bound
+    // (falls back to the full vertices when the mesh has no position stream, and binds
+    // positionArena() again afterwards so the caller's next draw finds it)
+    void drawPositions(unsigned int lod, unsigned int instances = 1) const
+    {
+        if (!hasPositionStream())
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
-			else if(name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-			    number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-            shader.setInt((name + number), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            vertexArena().bind();
+            drawGeometry(lod, instances);
+            positionArena().bind();
+            return;
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        positionArena().draw(positionGeometry, level.indexOffset, level.indexCount, instances);
+        frameStats.drawCalls++;
+        frameStats.instances += instances;
+        frameStats.triangles += (unsigned long long)(level.indexCount / 3) * instances;
     }
 
-private:
-    /*  Render data  */
-    unsigned int VBO, EBO;
+    // welded positions and the index list remapped onto them; the LODs keep their offsets
+    void buildPositionStream(vector<float> &positions, vector<unsigned int> &positionIndices) const
+    {
+        vector<unsigned int> remap = weldPositions(&vertices[0].Position.x, vertices.size(), sizeof(Vertex), positions);
+        positionIndices.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            positionIndices[i] = remap[indices[i]];
+    }
+
+    // the draw drawGeometry would issue, as a multi-draw indirect command
+    DrawElementsIndirectCommand indirectCommand(unsigned int lod, unsigned int instances, unsigned int baseInstance) const
+    {
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        return GeometryArena::command(geometry, level.indexOffset, level.indexCount, instances, baseInstance);
+    }
+
+    // drawPositions as a multi-draw indirect command, only valid when hasPositionStream()
+    DrawElementsIndirectCommand positionIndirectCommand(unsigned int lod, unsigned int instances, unsigned int baseInstance) const
+    {
+        const MeshLod &level = lods[std::min<size_t>(lod, lods.size() - 1)];
+        return GeometryArena::command(positionGeometry, level.indexOffset, level.indexCount, instances, baseInstance);
+    }
+
+    // hands the GPU storage back to the arena, the mesh can't be drawn afterwards
+    void release()
+    {
+        if (geometry.vertexCount == 0 && geometry.indexCount == 0)
+            return;
+        vertexArena().free(geometry);
+        geometry = GeometryRange();
+        if (hasPositionStream())
+            positionArena().free(positionGeometry);
+        positionGeometry = GeometryRange();
+    }
+
+    // baked lighting of a static mesh (see lightmap.hpp), bound along with its material
+    void setLightmap(GLuint texture)
+    {
+        material.textures[MATERIAL_LIGHTMAP] = texture;
+        material.id = registerMaterial(material);
+    }
+
+    bool hasLightmap() const { return material.textures[MATERIAL_LIGHTMAP] != 0; }
+
+    // true when both meshes bind the same material, i.e. they can be drawn as one
+    bool sameMaterial(const Mesh &other) const
+    {
+        return material.id == other.material.id;
+    }
 
+private:
     /*  Functions    */
-    // initializes all the buffer objects/arrays
+    // first texture of each type goes to that type's unit, the rest have no sampler to go to
+    void resolveMaterial(float shininess)
+    {
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            int slot = materialSlot(textures[i].type);
+            if (slot >= 0 && material.textures[slot] == 0)
+                material.textures[slot] = textures[i].id;
+        }
+        // Ns 0 would make pow(x, 0) light the whole surface
+        material.shininess = std::max(shininess, 1.0f);
+        material.id = registerMaterial(material);
+    }
+
+    void computeBounds()
+    {
+        boundsMin = glm::vec3(FLT_MAX);
+        boundsMax = glm::vec3(-FLT_MAX);
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            const glm::vec3 &p = vertices[i].Position;
+            boundsMin = glm::vec3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+            boundsMax = glm::vec3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+        }
+        // tighter than half the box diagonal for anything that isn't box shaped
+        sphereCenter = (boundsMin + boundsMax) * 0.5f;
+        sphereRadius = 0.0f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            sphereRadius = std::max(sphereRadius, glm::length(vertices[i].Position - sphereCenter));
+    }
+
+    // simplifies the full mesh into a chain of coarser index lists (quadric error metrics)
+    void buildLods()
+    {
+        lods.clear();
+        lods.push_back({0, (unsigned int)indices.size(), 0.0f});
+        if (indices.size() / 3 < LOD_MIN_TRIANGLES)
+            return;
+
+        vector<unsigned int> source(indices);
+        size_t target = source.size();
+        while (lods.size() < LOD_MAX_LEVELS)
+        {
+            target = size_t(target / 3 * LOD_REDUCTION) * 3;
+            float error = 0.0f;
+            // always simplify from the full mesh, the quadrics are more accurate that way
+            vector<unsigned int> lod = simplifyMesh(&vertices[0].Position.x, vertices.size(), sizeof(Vertex),
+                                                    source, target, &error);
+            // stop once the simplifier can't make meaningful progress anymore
+            if (lod.empty() || lod.size() > lods.back().indexCount * 9 / 10)
+                break;
+            lods.push_back({(unsigned int)indices.size(), (unsigned int)lod.size(), error});
+            indices.insert(indices.end(), lod.begin(), lod.end());
+        }
+    }
+
+    // sub-allocates the vertex and index data (all LODs) from the shared arena of its layout
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-        glBindVertexArray(0);
+        if (lightmapCoords.empty())
+            geometry = meshArena().allocate(vertices.data(), (unsigned int)vertices.size(),
+                                            indices.data(), (unsigned int)indices.size());
+        else
+        {
+            vector<LightmappedVertex> lightmapped(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                lightmapped[i] = {vertices[i], lightmapCoords[i]};
+            geometry = lightmappedArena().allocate(lightmapped.data(), (unsigned int)lightmapped.size(),
+                                                   indices.data(), (unsigned int)indices.size());
+        }
+        if (!keepPositionStreams || vertices.empty())
+            return;
+        vector<float> positions;
+        vector<unsigned int> positionIndices;
+        buildPositionStream(positions, positionIndices);
+        positionGeometry = positionArena().allocate(positions.data(), (unsigned int)(positions.size() / 3),
+                                                    positionIndices.data(), (unsigned int)positionIndices.size());
     }
 };
 #endif
@@ -10,7 +10,15 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include "frustum.hpp"
+#include "lightmap.hpp"
 #include "mesh.hpp"
+#include "object.hpp"
+#include "objloader.hpp"
+#include "occlusion.hpp"
+#include "occlusion_queries.hpp"
+#include "pvs.hpp"
+#include "render_queue.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 
@@ -20,6 +28,8 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <cfloat>
 // #includes "stb_image.h"
 using namespace std;
 inline unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
@@ -32,22 +42,157 @@ public:
     vector<Mesh> meshes;
     string directory;
     bool gammaCorrection;
+    bool uploadToGpu;   // false: geometry and textures are only read, nothing touches OpenGL
+    // bounding sphere of all meshes in model space, used for LOD selection
+    glm::vec3 boundsCenter;
+    float boundsRadius;
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // the native loader only handles .obj files, anything else still goes through Assimp.
+    // upload = false loads without a GL context, for the command line tools
+    Model(string const &path, bool gamma = false, Model_Loader loader = LOADER_ASSIMP, bool upload = true)
+        : gammaCorrection(gamma), uploadToGpu(upload), boundsCenter(0.0f), boundsRadius(0.0f)
     {
-        loadModel(path);
+        bool isObj = path.size() >= 4 && path.compare(path.size() - 4, 4, ".obj") == 0;
+        if(loader == LOADER_NATIVE_OBJ && isObj)
+            loadObjModel(path);
+        else
+            loadModel(path);
 		cout << "Loading Model from path : " << path << endl;
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader shader)
+    // queues every mesh for the render queue instead of drawing it right away,
+    // skipping the meshes whose world space bounding box is outside the frustum or hidden
+    // behind the occluders (when those are given). With GPU occlusion queries each mesh is
+    // tracked under `object` and its index, and may be drawn conditionally. With a baked
+    // visibility set (the eye cell's bits) mesh i is bit pvsFirst + i, and clear bits are skipped first.
+    void Submit(RenderQueue &queue, unsigned int program, unsigned int lod, VecMat::mat4 transform,
+                const Frustum *frustum = nullptr, const OcclusionBuffer *occlusion = nullptr,
+                OcclusionQueries *queries = nullptr, unsigned int object = 0,
+                const uint32_t *pvs = nullptr, unsigned int pvsFirst = 0)
     {
+        glm::vec3 center, extent;
+        float radius;
+        // most objects are either entirely inside or entirely outside, try the whole model first
+        transformSphere(transform, boundsCenter, boundsRadius, center, radius);
+        if(frustum && !frustum->intersectsSphere(center, radius))
+        {
+            frameStats.meshesCulled += (unsigned int)meshes.size();
+            return;
+        }
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(pvs && !PotentiallyVisibleSet::test(pvs, pvsFirst + i))
+            {
+                frameStats.meshesPvsCulled++;
+                continue;
+            }
+            transformBox(transform, meshes[i].boundsMin, meshes[i].boundsMax, center, extent);
+            if(frustum && !frustum->intersectsBox(center, extent))
+            {
+                frameStats.meshesCulled++;
+                continue;
+            }
+            if(occlusion && occlusion->isOccluded(center, extent))
+            {
+                frameStats.meshesOccluded++;
+                continue;
+            }
+            frameStats.meshesVisible++;
+            GLuint condition = 0;
+            if(queries)
+                condition = queries->test((uint64_t(object) << 32) | i, center, extent);
+            queue.submit(PASS_OPAQUE, program, meshes[i], lod, transform, center, extent, condition);
+        }
+    }
+
+    // adds the coarsest level of every mesh to the software occlusion buffer
+    void SubmitOccluder(OcclusionBuffer &occlusion, VecMat::mat4 transform) const
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            if(mesh.vertices.empty())
+                continue;
+            const MeshLod &level = mesh.lods.back();
+            occlusion.addOccluder(&mesh.vertices[0].Position.x, sizeof(Vertex), &mesh.indices[level.indexOffset],
+                                  level.indexCount, transform);
+        }
+    }
+
+    // number of levels of detail of the most detailed mesh
+    unsigned int lodCount() const
+    {
+        size_t count = 1;
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            count = std::max(count, meshes[i].lods.size());
+        return (unsigned int)count;
     }
 		
+    // Static batching: moves every mesh into world space with the given (fixed) transform and
+    // merges the meshes that share a material into a single mesh, so the object costs one draw
+    // per distinct texture set. Afterwards the model must be drawn with an identity model matrix.
+    // With `lightmapped` each batch is also unwrapped for a lightmap (unwrapLightmap), which
+    // splits its vertices at the chart borders, so only when there are lightmaps to use.
+    void bakeStatic(VecMat::mat4 transform, bool lightmapped = false)
+    {
+        // normals go through the cofactor matrix (inverse transpose up to scale) of the upper 3x3
+        float m[3][3], n[3][3];
+        for(int c = 0; c < 3; c++)
+            for(int r = 0; r < 3; r++)
+                m[c][r] = transform[c][r];
+        for(int c = 0; c < 3; c++)
+            for(int r = 0; r < 3; r++)
+                n[c][r] = m[(c + 1) % 3][(r + 1) % 3] * m[(c + 2) % 3][(r + 2) % 3]
+                        - m[(c + 1) % 3][(r + 2) % 3] * m[(c + 2) % 3][(r + 1) % 3];
+
+        vector<Mesh> batches;
+        vector<bool> merged(meshes.size(), false);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(merged[i])
+                continue;
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            for(unsigned int j = i; j < meshes.size(); j++)
+            {
+                if(merged[j] || !meshes[i].sameMaterial(meshes[j]))
+                    continue;
+                merged[j] = true;
+                const Mesh &source = meshes[j];
+                unsigned int base = (unsigned int)vertices.size();
+                for(unsigned int k = 0; k < source.vertices.size(); k++)
+                {
+                    Vertex v = source.vertices[k];
+                    glm::vec3 p = v.Position, nrm = v.Normal;
+                    for(int r = 0; r < 3; r++)
+                    {
+                        v.Position[r] = m[0][r] * p.x + m[1][r] * p.y + m[2][r] * p.z + transform[3][r];
+                        v.Normal[r] = n[0][r] * nrm.x + n[1][r] * nrm.y + n[2][r] * nrm.z;
+                    }
+                    v.Normal = glm::normalize(v.Normal);
+                    vertices.push_back(v);
+                }
+                // only the full detail level, the batch builds its own LOD chain
+                for(unsigned int k = 0; k < source.lods[0].indexCount; k++)
+                    indices.push_back(base + source.indices[k]);
+            }
+            // static meshes get their lightmap coordinates here, where the renderer and the baker both pass
+            vector<glm::vec2> lightmapCoords;
+            unsigned int lightmapSize = lightmapped ? unwrapLightmap(vertices, indices, lightmapCoords) : 0;
+            batches.push_back(Mesh(vertices, indices, meshes[i].textures, uploadToGpu, meshes[i].material.shininess,
+                                   lightmapCoords));
+            batches.back().lightmapSize = lightmapSize;
+        }
+
+        cout << "Static batching: " << meshes.size() << " meshes merged into " << batches.size() << " batches" << endl;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].release();
+        meshes = batches;
+        computeBounds();
+    }
+
 private:
     /*  Functions   */
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
@@ -55,7 +200,8 @@ private:
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals);
+        // identical vertices have to be joined, the LOD simplifier works on shared topology
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -67,6 +213,60 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+        computeBounds();
+    }
+
+    // bounding sphere around the axis aligned box of every mesh, grown to hold every mesh sphere
+    void computeBounds()
+    {
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].vertices.empty())
+                continue;
+            const glm::vec3 &a = meshes[i].boundsMin, &b = meshes[i].boundsMax;
+            lo = glm::vec3(std::min(lo.x, a.x), std::min(lo.y, a.y), std::min(lo.z, a.z));
+            hi = glm::vec3(std::max(hi.x, b.x), std::max(hi.y, b.y), std::max(hi.z, b.z));
+        }
+        if(lo.x > hi.x)
+            return;
+        boundsCenter = (lo + hi) * 0.5f;
+        boundsRadius = 0.0f;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if(!meshes[i].vertices.empty())
+                boundsRadius = std::max(boundsRadius, glm::length(meshes[i].sphereCenter - boundsCenter) + meshes[i].sphereRadius);
+        boundsRadius = std::min(boundsRadius, glm::length(hi - boundsCenter));
+    }
+
+    // loads a Wavefront file with the native parser, one mesh per material
+    void loadObjModel(string const &path)
+    {
+        ObjScene scene;
+        string error;
+        if(!loadObj(path, scene, error))
+        {
+            cout << "ERROR::OBJLOADER:: " << error << endl;
+            return;
+        }
+        directory = path.substr(0, path.find_last_of('/'));
+
+        for(unsigned int i = 0; i < scene.meshes.size(); i++)
+        {
+            const ObjMesh &mesh = scene.meshes[i];
+            vector<Textures> textures;
+            float shininess = MATERIAL_DEFAULT_SHININESS;
+            if(mesh.material >= 0)
+            {
+                const ObjMaterial &material = scene.materials[mesh.material];
+                if(!material.diffuseMap.empty())
+                    textures.push_back(loadTexture(material.diffuseMap.c_str(), "texture_diffuse"));
+                if(!material.specularMap.empty())
+                    textures.push_back(loadTexture(material.specularMap.c_str(), "texture_specular"));
+                shininess = material.shininess;
+            }
+            meshes.push_back(Mesh(mesh.vertices, mesh.indices, textures, uploadToGpu, shininess));
+        }
+        computeBounds();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -134,12 +334,8 @@ private:
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
+        // the type names decide the texture unit when the Mesh resolves its material (see Material_Slot):
+        // the first diffuse map is sampled as material.diffuse, the first specular map as material.specular
 
         // 1. diffuse maps
         vector<Textures> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
@@ -147,8 +343,11 @@ private:
         // 2. specular maps
         vector<Textures> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        // 3. specular exponent (Ns for .mtl files)
+        float shininess = MATERIAL_DEFAULT_SHININESS;
+        material->Get(AI_MATKEY_SHININESS, shininess);
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, uploadToGpu, shininess);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -160,28 +359,33 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            textures.push_back(loadTexture(str.C_Str(), typeName));
+        }
+        return textures;
+    }
+
+    // loads a texture relative to the model directory, unless it was loaded for this model before
+    Textures loadTexture(const char *path, const string &typeName)
+    {
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(std::strcmp(textures_loaded[j].path.data(), path) == 0)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Textures texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                Textures texture = textures_loaded[j];   // same file, possibly used as a different map type
                 texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                return texture;
             }
         }
-        return textures;
+        Textures texture;
+        // without a GL context every file still gets an id of its own, so that meshes are told apart
+        // by material (static batching) exactly as they are in the renderer
+        texture.id = uploadToGpu ? TextureFromFile(path, this->directory) : (unsigned int)textures_loaded.size() + 1;
+        texture.type = typeName;
+        texture.path = path;
+        // header only, the pixels were already decoded (or aren't needed)
+        stbi_info((this->directory + '/' + path).c_str(), &texture.width, &texture.height, &texture.channels);
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
     }
 };
 
@@ -1,11 +1,18 @@
 #include <vector>
 #include <utility>
+#include <memory>
 #include<glm/glm.hpp>
 #include<string>
 #include <matrix.hpp>
 
 #pragma once
 
+// which importer turns the object's model file into meshes
+enum Model_Loader {
+	LOADER_ASSIMP,      // any format Assimp understands
+	LOADER_NATIVE_OBJ   // built-in multithreaded OBJ/MTL parser, .obj files only
+};
+
 class Object {
 private:
 	VecMat::vec3 position;
@@ -13,9 +20,13 @@ private:
 	VecMat::vec3 rotationangle;
 	double angle;
 	std::string ModelName;
+	Model_Loader Loader;
 	std::string text;
 	const char* Texture;
 	std::string Name;
+	bool Static;
+	bool Occluder;
+	std::vector<std::unique_ptr<Object>> instances;	// spawned copies, owned by this object
 
 
 public:
@@ -51,8 +62,27 @@ public:
 	void setModelName(std::string);
 	std::string getModelName();
 
+	//get set function for the importer used for the model file
+	void setModelLoader(Model_Loader loader);
+	Model_Loader getModelLoader();
+
+	//get set function for static objects (never move, baked into world space at load)
+	void setStatic(bool s);
+	bool isStatic();
+
+	//get set function for occluders (large closed shapes rasterised for software occlusion culling)
+	void setOccluder(bool o);
+	bool isOccluder();
+
+	//model matrix from position, angle around the y axis and scale, as the renderer places the object
+	VecMat::mat4 getModelMatrix();
+
 	void addObject(Object* a);
 	std::vector<Object*> getChildren();
 
+	//spawns a copy of this object (same model, loader and scale) at another place and adds it to parent.
+	//objects sharing a model file load it once and are drawn with one instanced draw per mesh
+	Object* spawnInstance(Object* parent, std::string name, double x, double y, double z, double angle = 0);
+
 };
 
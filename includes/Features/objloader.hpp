@@ -0,0 +1,43 @@
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include "vertex.hpp"
+
+#include <string>
+#include <vector>
+
+// Wavefront material, only the parts the renderer uses
+struct ObjMaterial {
+    std::string name;
+    std::string diffuseMap;     // map_Kd, as written in the .mtl
+    std::string specularMap;    // map_Ks
+    float shininess = 32.0f;    // Ns
+    glm::vec3 ambient = glm::vec3(1.0f);
+    glm::vec3 diffuse = glm::vec3(0.8f);
+    glm::vec3 specular = glm::vec3(0.5f);
+    float opacity = 1.0f;       // d
+};
+
+// one mesh per material, vertices deduplicated into the renderer's Vertex layout
+struct ObjMesh {
+    int material = -1;          // index into ObjScene::materials, -1 when none
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+struct ObjScene {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+};
+
+// Native OBJ/MTL loader. The file is memory mapped and cut into chunks at line boundaries
+// that are parsed in parallel; polygons are fanned into triangles and UVs flipped the same
+// way aiProcess_FlipUVs does, so the result matches what the Assimp path produces.
+// threads = 0 uses the hardware concurrency. Returns false (and fills error) on failure.
+bool loadObj(const std::string &path, ObjScene &scene, std::string &error, unsigned int threads = 0);
+
+// strtod replacement for the plain decimal/exponent numbers found in OBJ files,
+// advances `text` past the number
+float parseFloat(const char *&text, const char *end);
+
+#endif
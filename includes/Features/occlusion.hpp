@@ -0,0 +1,73 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Software occlusion culling. A few low-poly occluders (walls, door) are rasterised on the CPU
+// into a small depth buffer, then bounding boxes are tested against it before they are queued.
+// The buffer is cut into bands of rows that worker threads rasterise in parallel, four pixels
+// per SSE instruction. Everything is conservative: a box is only occluded when every pixel it
+// covers already holds a nearer occluder.
+class OcclusionBuffer
+{
+public:
+    static const int WIDTH = 256;       // a multiple of 4, same aspect as the window
+    static const int HEIGHT = 144;
+    static const int TILE_ROWS = 16;    // rows per band, the unit of work of one thread
+    static const int TILES = HEIGHT / TILE_ROWS;
+
+    // threads = 0 uses the hardware concurrency (the calling thread counts as one)
+    explicit OcclusionBuffer(unsigned int threads = 0);
+    ~OcclusionBuffer();
+    OcclusionBuffer(const OcclusionBuffer &) = delete;
+    OcclusionBuffer &operator=(const OcclusionBuffer &) = delete;
+
+    // starts a new frame, drops the previous occluders
+    void begin(const VecMat::mat4 &projection, const VecMat::mat4 &view);
+    // indexed triangles, positions are the first three floats of each `stride` byte vertex
+    void addOccluder(const float *positions, size_t stride, const unsigned int *indices, size_t indexCount,
+                     const VecMat::mat4 &transform);
+    // clears the buffer and rasterises everything added since begin()
+    void rasterize();
+
+    // world space box (center / half extent), true when it is certainly hidden
+    bool isOccluded(const glm::vec3 &center, const glm::vec3 &extent) const;
+    // true when occluders cover the whole screen, so nothing at the far plane (the sky) shows
+    bool farPlaneOccluded() const;
+
+private:
+    // a triangle after projection: pixel coordinates and NDC depth
+    struct ScreenTriangle
+    {
+        float x[3], y[3], z[3];
+        int minY, maxY;
+    };
+
+    float clip[4][4];   // projection * view, [column][row] like VecMat
+    std::vector<ScreenTriangle> triangles;
+    std::vector<float> depth;                   // WIDTH * HEIGHT NDC depths, row 0 at the bottom of the screen
+    float tileMaxDepth[TILES];                  // farthest depth in each band, 1 where anything is uncovered
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    unsigned int generation = 0;    // bumped for every rasterize(), workers wait for a new value
+    unsigned int busy = 0;
+    bool quit = false;
+    std::atomic<int> nextTile;
+
+    void addTriangle(const float (*v)[4]);
+    void runTiles();
+    void rasterizeTile(int tile);
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// GPU occlusion culling with hardware queries. Each tracked drawable's world box is drawn as a
+// proxy (the unit cube scaled into place) inside an any-samples-passed query, after the
+// unconditional opaque draws are in the depth buffer. A drawable that was visible in the newest
+// result read back is drawn as usual. Any other drawable is drawn under glBeginConditionalRender
+// on this frame's query, so the GPU skips it when its box was hidden and the CPU never waits.
+// Results are only read once they are available, a few frames later.
+class OcclusionQueries
+{
+public:
+    static const unsigned int LATENCY = 3;  // queries per drawable, one for each frame in flight
+
+    // depth-only program with a `model` uniform (and `instanced`), and a 36 vertex unit cube
+    void setProxy(const Shader *program, GLuint unitCube);
+
+    void beginFrame(const glm::vec3 &eye);
+    // `key` identifies the drawable across frames, the box is in world space (center / half extent).
+    // Returns the query the draw has to be conditioned on, 0 when it is drawn unconditionally.
+    GLuint test(uint64_t key, const glm::vec3 &center, const glm::vec3 &extent);
+    // draws this frame's proxy boxes, called by the render queue between its opaque passes
+    void issue();
+
+    size_t size() const { return drawables.size(); }
+
+private:
+    struct Drawable
+    {
+        GLuint queries[LATENCY];
+        unsigned int issued[LATENCY];   // frame each query was issued in, 0 when it has no result coming
+        unsigned int resultFrame;       // frame the newest result read back belongs to
+        bool visible;
+    };
+    struct Proxy
+    {
+        GLuint query;
+        glm::vec3 center, extent;
+    };
+
+    std::unordered_map<uint64_t, Drawable> drawables;
+    std::vector<Proxy> proxies;     // this frame's boxes, in test() order
+    const Shader *program = nullptr;
+    GLint modelLocation = -1;
+    GLuint cube = 0;
+    unsigned int frame = 0;
+    glm::vec3 eye = glm::vec3(0.0f);
+
+    void readResults(Drawable &drawable);
+};
+
+#endif
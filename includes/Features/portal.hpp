@@ -0,0 +1,72 @@
+#ifndef PORTAL_H
+#define PORTAL_H
+
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include "frustum.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Cells and portals. The scene is split into cells, boxes such as the room plus one
+// unbounded cell for everything outside, joined by portals: quads like the door opening or
+// a window. Each frame the cells are walked from the eye's cell through the open portals.
+// Every portal seen narrows the view to its screen rectangle, so a cell is only visible
+// through the part of the screen its portals cover. Whole cells behind shut doors are never
+// visited, so nothing in them needs a per-mesh test.
+class CellGraph
+{
+public:
+    static const unsigned int MAX_CELLS = 32;  // cell sets are bit masks
+
+    unsigned int addCell(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+    // the cell for everything no bounded cell contains
+    unsigned int addOutsideCell();
+    // corners in order around the quad
+    unsigned int addPortal(unsigned int cellA, unsigned int cellB, const glm::vec3 corners[4]);
+    // the quad through the middle of a box, across its thinnest axis (a door's bounds, say)
+    static void quadFromBox(const glm::vec3 &center, const glm::vec3 &extent, glm::vec3 corners[4]);
+    void setOpen(unsigned int portal, bool open) { portals[portal].open = open; }
+
+    unsigned int cellAt(const glm::vec3 &point) const;
+    // the cells a world box (center / half extent) can be seen in: every cell it reaches into,
+    // and both sides of any portal it sits in
+    uint32_t cellsOf(const glm::vec3 &center, const glm::vec3 &extent) const;
+
+    // the cells visible from `eye`, with frusta[cell] set to the view narrowed to the portals
+    // the cell is seen through (frusta is resized to the cell count)
+    uint32_t traverse(const glm::vec3 &eye, const VecMat::mat4 &projection, const VecMat::mat4 &view,
+                      std::vector<Frustum> &frusta) const;
+
+    unsigned int cellCount() const { return (unsigned int)cells.size(); }
+
+private:
+    struct Cell
+    {
+        glm::vec3 boundsMin, boundsMax;
+        bool bounded;
+        std::vector<unsigned int> portals;
+    };
+    struct Portal
+    {
+        glm::vec3 corners[4];
+        glm::vec3 boundsMin, boundsMax;     // the quad's box, grown by PORTAL_SLACK
+        unsigned int cells[2];
+        bool open = true;
+    };
+    // screen rectangle in normalised device coordinates
+    struct Rect
+    {
+        float left, right, bottom, top;
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Portal> portals;
+
+    bool portalRect(const Portal &portal, const float clip[4][4], const glm::vec3 &eye, Rect &rect) const;
+    void visit(unsigned int cell, const Rect &rect, uint32_t path, const float clip[4][4], const glm::vec3 &eye,
+               std::vector<Rect> &rects, uint32_t &visible) const;
+};
+
+#endif
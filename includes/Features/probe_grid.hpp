@@ -0,0 +1,78 @@
+#ifndef PROBE_GRID_H
+#define PROBE_GRID_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "buffer_texture.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// L2 spherical harmonics: 9 coefficients per colour channel
+const unsigned int SH_COEFFICIENTS = 9;
+
+// the real SH basis at a unit direction, in the order probeIrradiance in mainfragment.fs uses
+void shBasis(const glm::vec3 &dir, float out[SH_COEFFICIENTS]);
+
+// Light probes for what moves through the room (cards, door, candle) and so can't have a
+// lightmap. A grid of points over a box, each holding the baked lights as seen from there: the
+// irradiance a surface would get for every normal, as L2 spherical harmonics. Like a lightmap
+// texel it is light over pi, so the shader multiplies it with the diffuse texture. LightmapBake
+// writes the grid from the lightmaps, in the same signature as them.
+class ProbeGrid
+{
+public:
+    struct Probe
+    {
+        glm::vec3 sh[SH_COEFFICIENTS];
+    };
+
+    // dims probes along each axis (at least 2), the outer ones on the faces of the box, all black
+    void create(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const int dims[3], uint32_t signature);
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+    void clear() { probes.clear(); }
+    bool loaded() const { return !probes.empty(); }
+
+    Probe &probe(int x, int y, int z) { return probes[(size_t(z) * dims[1] + y) * dims[0] + x]; }
+    glm::vec3 position(int x, int y, int z) const;
+    int probeCount(int axis) const { return dims[axis]; }
+    uint32_t signature() const { return hash; }
+
+    // the eight probes around `point` blended trilinearly, points outside take the nearest face
+    void sample(const glm::vec3 &point, Probe &out) const;
+
+private:
+    glm::vec3 boundsMin = glm::vec3(0.0f), spacing = glm::vec3(1.0f);
+    int dims[3] = {0, 0, 0};
+    uint32_t hash = 0;
+    std::vector<Probe> probes;
+};
+
+// The probe lighting of this frame's draws: each draw given an entry gets the grid sampled at
+// its center, uploaded as SH_COEFFICIENTS texels of a buffer texture (probeCoefficients in
+// mainfragment.fs), which its instance attribute points the shader to. The shader then replaces
+// the baked lights with one SH evaluation for that draw.
+class ProbeLighting
+{
+public:
+    static const uint32_t NONE = 0xffffffffu;           // the attribute value of draws without an entry
+    static const unsigned int MAX_ENTRIES = 4096;       // keeps the buffer texture under GL 3.3's minimum size
+
+    // starts the frame's entries, sampled from `grid`
+    void begin(const ProbeGrid &grid);
+    // a new entry for a draw centered at `center`, its index for the instance attribute
+    // (NONE once MAX_ENTRIES are taken, the draw then shades the baked lights itself)
+    uint32_t add(const glm::vec3 &center);
+    // uploads the entries and binds the buffer texture to TEXTURE_PROBES
+    void upload();
+
+private:
+    const ProbeGrid *grid = nullptr;
+    std::vector<glm::vec4> texels;  // SH_COEFFICIENTS per entry
+    BufferTexture texture;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Baked potentially visible set. The box the camera is kept in is cut into a grid of cells and
+// for every cell the PvsBake tool stores one bit per static mesh, set when the mesh can be seen
+// from somewhere in the cell, plus a last bit for the sky. At runtime the eye's cell is found
+// with a few multiplies, and a mesh whose bit is clear is skipped before any other test.
+// Only static meshes are in the set; anything that moves is always potentially visible.
+class PotentiallyVisibleSet
+{
+public:
+    // an empty set over the grid, every bit clear
+    void create(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const int dims[3], unsigned int meshCount,
+                uint32_t signature);
+    bool load(const std::string &path);
+    bool save(const std::string &path) const;
+    void clear() { bits.clear(); }
+    bool loaded() const { return !bits.empty(); }
+
+    // the bits of the cell holding `point`, null outside the grid (free camera) or when nothing is loaded
+    const uint32_t *cellBits(const glm::vec3 &point) const;
+    uint32_t *cellBits(int x, int y, int z) { return &bits[((size_t(z) * dims[1] + y) * dims[0] + x) * words]; }
+    glm::vec3 cellMin(int x, int y, int z) const;
+    glm::vec3 cellSize() const { return size; }
+    int cellCount(int axis) const { return dims[axis]; }
+
+    unsigned int meshCount() const { return meshes; }
+    unsigned int skyBit() const { return meshes; }
+    unsigned int wordCount() const { return words; }
+    uint32_t signature() const { return hash; }
+
+    static bool test(const uint32_t *cell, unsigned int index) { return (cell[index >> 5] >> (index & 31)) & 1u; }
+    static void set(uint32_t *cell, unsigned int index) { cell[index >> 5] |= 1u << (index & 31); }
+
+    // fingerprint of the static geometry (index count of every mesh, in order), so a set baked
+    // for other models is not applied to these
+    static uint32_t signatureOf(const std::vector<unsigned int> &meshIndexCounts);
+
+private:
+    glm::vec3 boundsMin = glm::vec3(0.0f), size = glm::vec3(1.0f);
+    int dims[3] = {0, 0, 0};
+    unsigned int meshes = 0;
+    unsigned int words = 0;     // per cell, meshes + 1 bits rounded up
+    uint32_t hash = 0;
+    std::vector<uint32_t> bits;
+};
+
+#endif
@@ -8,10 +8,29 @@
 // #includes <glm/gtc/type_ptr.hpp>
 
 #include "camera.hpp"
+#include "frame_uniforms.hpp"
+#include "frustum.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "gpu_culling.hpp"
+#include "light_clusters.hpp"
 #include "model.hpp"
 #include "object.hpp"
-
+#include "occlusion.hpp"
+#include "occlusion_queries.hpp"
+#include "portal.hpp"
+#include "lightmap.hpp"
+#include "probe_grid.hpp"
+#include "pvs.hpp"
+#include "render_queue.hpp"
+#include "scene.hpp"
+#include "shadow_maps.hpp"
+#include "stats.hpp"
+#include "upload_ring.hpp"
+
+#include <filesystem>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 #include <ctime>
@@ -32,9 +51,23 @@ namespace visualisation
         std::vector<VecMat::vec3> modelScale;
         std::vector<std::string> modelname;
         std::vector<double> modelAngle;
-        std::vector<Model> models;
+        std::vector<Model> models;              // one per model file (static objects get their own baked copy)
+        std::vector<unsigned int> modelIndex;   // object -> models
+        std::map<std::string, unsigned int> modelCache;
+        std::vector<unsigned int> modelLod;
+        std::vector<bool> modelStatic;
+        std::vector<bool> modelOccluder;        // rasterised into the software occlusion buffer
         std::vector<VecMat::vec3> lampPosition;
         std::vector<VecMat::vec3> lightPosition;
+        CellGraph cells;                        // the room and the outside, joined by the door and window
+        unsigned int outsideCell = 0;
+        int doorPortal = -1;
+        uint32_t visibleCells = ~0u;            // this frame's traversal result...
+        std::vector<Frustum> cellFrusta;        // ...and the view narrowed to each cell's portals
+        PotentiallyVisibleSet pvs;              // baked by PvsBake for the camera box
+        std::vector<int> modelPvsFirst;         // object -> bit of its first mesh, -1 when it moves
+        LightmapSet lightmaps;                  // baked by LightmapBake for the day lights...
+        ProbeGrid probes;                       // ...and the probes for what moves
 
         double w;
         double l;
@@ -51,9 +84,18 @@ namespace visualisation
         void setLightPosition();
         void initializeGlfw();
         void getModels();
-        void setupPointLight(Shader& shader, int index, const VecMat::vec3& position, 
-                            const VecMat::vec3& ambient, const VecMat::vec3& diffuse, 
-                            const VecMat::vec3& specular, float constant, float linear, float quadratic);
+        void printGeometryStats();
+        void buildCells();
+        void loadPvs();
+        void loadBakedLighting();
+        const Frustum *portalFrustum(const glm::vec3 &center, const glm::vec3 &extent, const Frustum *fallback,
+                                     bool &hidden) const;
+        VecMat::mat4 objectMatrix(int index);
+        unsigned int selectLod(const Model &model, VecMat::mat4 transform, unsigned int current);
+        void addPointLight(LightClusters& lights, const VecMat::vec3& position, 
+                           const VecMat::vec3& ambient, const VecMat::vec3& diffuse, 
+                           const VecMat::vec3& specular, float constant, float linear, float quadratic,
+                           int shadow = -1);
     };
 } // namespace visualisation
 
@@ -76,7 +118,40 @@ const float CARD_DISPLAY_ANGLE = 90.0f;
 const float CANDLE_OFFSET_Y = -0.02f;
 const float CANDLE_SCALE = 0.01f;
 
+// every card glows in its own colour, a small light of its own (added to the clusters)
+const std::map<std::string, VecMat::vec3> CARD_LIGHT_COLOR = {
+    {"redCard", VecMat::vec3(1.0f, 0.1f, 0.1f)},
+    {"yellowCard", VecMat::vec3(1.0f, 0.85f, 0.2f)},
+    {"blueCard", VecMat::vec3(0.2f, 0.3f, 1.0f)},
+    {"greenCard", VecMat::vec3(0.2f, 1.0f, 0.3f)},
+};
+
+// LOD selection: projected bounding sphere diameter as a fraction of the screen height
+// below which the next coarser level is used, widened by the hysteresis band to avoid popping
+const float LOD_SCREEN_SIZE[LOD_MAX_LEVELS - 1] = {0.5f, 0.2f, 0.08f};
+const float LOD_HYSTERESIS = 0.15f;
+
+// Cells: the room box reaches a little past the area the camera is kept in (ROOM_MIN/MAX) so it
+// takes in the walls. The window portal is the opening of window.obj placed like the room
+// (scale 3) in the back wall; the door portal is derived from the shut door's bounds.
+const glm::vec3 ROOM_CELL_MIN(-4.6f, -0.5f, -5.3f);
+const glm::vec3 ROOM_CELL_MAX(4.8f, 7.8f, 5.6f);
+const glm::vec3 WINDOW_PORTAL_MIN(-1.64f, 2.69f, -5.07f);
+const glm::vec3 WINDOW_PORTAL_MAX(1.68f, 5.33f, -5.07f);
+
 bool opendoor = false;
+bool dumpStats = false;     // F1: print detailed statistics once
+bool frustumCulling = true; // F2: toggle view frustum culling
+bool multiDrawIndirect = true;  // F3: toggle multi-draw indirect (when the context has it)
+bool depthPrepass = false;      // F4: toggle the depth-only prepass
+bool occlusionCulling = true;   // F5: toggle software occlusion culling
+bool occlusionQueries = false;  // F6: toggle GPU occlusion queries with conditional rendering
+bool portalCulling = true;      // F7: toggle cell and portal visibility
+bool pvsCulling = true;         // F8: toggle the baked potentially visible set
+bool gpuDrivenCulling = false;  // F9: cull and draw the objects with a compute shader (GL 4.3)
+bool perDrawLights = false;     // F10: each mesh draw shades its 4 most relevant lights instead of its clusters'
+bool shadows = true;            // F11: toggle the point light shadow maps
+bool lightmapping = true;       // F12: the baked day lights come from the lightmaps and the probe grid
 
 // camera
 Camera camera(VecMat::vec3(4.0f, 6.0f, 4.0f));
@@ -100,6 +175,9 @@ visualisation::render::~render()
 
 void visualisation::render::getModels()
 {
+    // the static batches only get lightmap coordinates (and the vertex splits they take) when
+    // there are lightmaps to use them; loadBakedLighting checks that they fit
+    bool lightmapped = std::filesystem::exists(SCENE_LIGHTMAP_PATH);
     for (int i = 0; i < room->children.size(); ++i)
     {
         modelPosition.push_back(room->children[i]->getPosition());
@@ -107,11 +185,201 @@ void visualisation::render::getModels()
         modelAngle.push_back(room->children[i]->getAngle());
         modelRotationVector.push_back(room->children[i]->getRotationVector());
         modelname.push_back(room->children[i]->getName());
-        Model model(room->children[i]->getModelName());
+        modelStatic.push_back(room->children[i]->isStatic());
+        modelOccluder.push_back(room->children[i]->isOccluder());
+        modelLod.push_back(0);
+
+        // objects sharing a model file share the Model, the render queue draws them instanced
+        std::string path = room->children[i]->getModelName();
+        std::string cacheKey = path + (room->children[i]->getModelLoader() == LOADER_NATIVE_OBJ ? "#native" : "#assimp");
+        auto cached = modelCache.find(cacheKey);
+        if (!modelStatic[i] && cached != modelCache.end())
+        {
+            modelIndex.push_back(cached->second);
+            continue;
+        }
+        Model model(path, false, room->children[i]->getModelLoader());
+        // static objects are baked into world space once and drawn with an identity matrix
+        if (modelStatic[i])
+            model.bakeStatic(objectMatrix(i), lightmapped);
+        else
+            modelCache[cacheKey] = (unsigned int)models.size();
+        modelIndex.push_back((unsigned int)models.size());
         models.push_back(model);
     }
 }
 
+// model matrix from an object's position, angle around the y axis and scale
+VecMat::mat4 visualisation::render::objectMatrix(int index)
+{
+    VecMat::mat4 modelObject = VecMat::mat4(1.0f);
+    modelObject = VecMat::translate(modelObject, modelPosition[index]);
+    modelObject = VecMat::rotate(modelObject, to_radians(static_cast<float>(modelAngle[index])), VecMat::vec3(0.0f, 1.0f, 0.0f));
+    modelObject = VecMat::scale(modelObject, modelScale[index]);
+    return modelObject;
+}
+
+void visualisation::render::printGeometryStats()
+{
+    const char *names[] = {"Geometry arena", "Position arena", "Lightmapped arena"};
+    GeometryArena *arenas[] = {&meshArena(), &positionArena(), nullptr};
+    // the lightmapped arena is only created for the first unwrapped batch
+    for (const Model &model : models)
+        for (const Mesh &mesh : model.meshes)
+            if (!mesh.lightmapCoords.empty())
+                arenas[2] = &lightmappedArena();
+    for (int i = 0; i < 3 && arenas[i]; i++)
+    {
+        GeometryArena::Stats arena = arenas[i]->stats();
+        std::cout << names[i] << ": " << arena.vertexUsed << "/" << arena.vertexCapacity << " vertices, "
+                  << arena.indexUsed << "/" << arena.indexCapacity << " indices, "
+                  << arena.freeBlocks << " free blocks, "
+                  << arena.occupancy * 100.0f << "% occupied, "
+                  << arena.fragmentation * 100.0f << "% fragmented" << std::endl;
+    }
+}
+
+void visualisation::render::buildCells()
+{
+    unsigned int roomCell = cells.addCell(ROOM_CELL_MIN, ROOM_CELL_MAX);
+    outsideCell = cells.addOutsideCell();
+
+    glm::vec3 corners[4];
+    CellGraph::quadFromBox((WINDOW_PORTAL_MIN + WINDOW_PORTAL_MAX) * 0.5f, (WINDOW_PORTAL_MAX - WINDOW_PORTAL_MIN) * 0.5f,
+                           corners);
+    cells.addPortal(roomCell, outsideCell, corners);
+
+    for (int i = 0; i < modelIndex.size(); ++i)
+    {
+        if (modelname[i] != "door")
+            continue;
+        const Model &door = models[modelIndex[i]];
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (const Mesh &mesh : door.meshes)
+            for (int axis = 0; axis < 3; axis++)
+            {
+                boundsMin[axis] = std::min(boundsMin[axis], mesh.boundsMin[axis]);
+                boundsMax[axis] = std::max(boundsMax[axis], mesh.boundsMax[axis]);
+            }
+        glm::vec3 center, extent;
+        transformBox(objectMatrix(i), boundsMin, boundsMax, center, extent);
+        CellGraph::quadFromBox(center, extent, corners);
+        doorPortal = (int)cells.addPortal(roomCell, outsideCell, corners);
+    }
+    std::cout << "Cells: " << cells.cellCount() << ", door portal " << (doorPortal >= 0 ? "found" : "missing") << std::endl;
+}
+
+// the static meshes are numbered like PvsBake numbers them: objects in order, meshes after batching
+void visualisation::render::loadPvs()
+{
+    std::vector<unsigned int> indexCounts;
+    for (int i = 0; i < modelIndex.size(); ++i)
+    {
+        modelPvsFirst.push_back(modelStatic[i] ? (int)indexCounts.size() : -1);
+        if (modelStatic[i])
+            for (const Mesh &mesh : models[modelIndex[i]].meshes)
+                indexCounts.push_back(mesh.lods[0].indexCount);
+    }
+    if (!pvs.load(SCENE_PVS_PATH))
+    {
+        std::cout << "PVS: no visibility set at " << SCENE_PVS_PATH << ", run PvsBake to create one" << std::endl;
+        return;
+    }
+    if (pvs.meshCount() != indexCounts.size() || pvs.signature() != PotentiallyVisibleSet::signatureOf(indexCounts))
+    {
+        std::cout << "PVS: " << SCENE_PVS_PATH << " was baked for other models, ignored until PvsBake is run again" << std::endl;
+        pvs.clear();
+        return;
+    }
+    std::cout << "PVS: " << pvs.cellCount(0) << " x " << pvs.cellCount(1) << " x " << pvs.cellCount(2) << " cells, "
+              << pvs.meshCount() << " static meshes" << std::endl;
+}
+
+// the lightmaps follow the same mesh order, and only fit meshes unwrapped exactly as they were for the bake;
+// the probes saw those lightmaps, so they carry the same signature
+void visualisation::render::loadBakedLighting()
+{
+    std::vector<Mesh *> meshes;
+    std::vector<unsigned int> counts;
+    for (int i = 0; i < modelIndex.size(); ++i)
+        if (modelStatic[i])
+            for (Mesh &mesh : models[modelIndex[i]].meshes)
+            {
+                meshes.push_back(&mesh);
+                counts.push_back(mesh.lods[0].indexCount);
+                counts.push_back((unsigned int)mesh.vertices.size());
+                counts.push_back(mesh.lightmapSize);
+            }
+    if (!lightmaps.load(SCENE_LIGHTMAP_PATH))
+    {
+        std::cout << "LIGHTMAP: no lightmaps at " << SCENE_LIGHTMAP_PATH << ", run LightmapBake to create them" << std::endl;
+        return;
+    }
+    if (lightmaps.meshCount() != meshes.size() || lightmaps.signature() != LightmapSet::signatureOf(counts))
+    {
+        std::cout << "LIGHTMAP: " << SCENE_LIGHTMAP_PATH << " was baked for other models, ignored until LightmapBake is run again" << std::endl;
+        lightmaps.clear();
+        return;
+    }
+    size_t bytes = 0;
+    for (unsigned int m = 0; m < meshes.size(); m++)
+        if (lightmaps.size(m))
+        {
+            meshes[m]->setLightmap(lightmaps.upload(m));
+            bytes += size_t(lightmaps.size(m)) * lightmaps.size(m) * 6;
+        }
+    std::cout << "LIGHTMAP: " << meshes.size() << " static meshes, " << bytes / 1024 << " KiB of half float texels" << std::endl;
+
+    if (!probes.load(SCENE_PROBE_PATH))
+    {
+        std::cout << "PROBES: no probe grid at " << SCENE_PROBE_PATH << ", run LightmapBake to create one" << std::endl;
+        return;
+    }
+    if (probes.signature() != lightmaps.signature())
+    {
+        std::cout << "PROBES: " << SCENE_PROBE_PATH << " was baked for other models, ignored until LightmapBake is run again" << std::endl;
+        probes.clear();
+        return;
+    }
+    std::cout << "PROBES: " << probes.probeCount(0) << " x " << probes.probeCount(1) << " x " << probes.probeCount(2)
+              << " probes" << std::endl;
+}
+
+// the frustum to test an object with under portal culling: the view narrowed to its cell's portals
+// when it can only be seen in one visible cell, `fallback` when in several, none (hidden) when in no visible cell
+const Frustum *visualisation::render::portalFrustum(const glm::vec3 &center, const glm::vec3 &extent,
+                                                    const Frustum *fallback, bool &hidden) const
+{
+    uint32_t seenIn = cells.cellsOf(center, extent) & visibleCells;
+    hidden = seenIn == 0;
+    if (hidden || (seenIn & (seenIn - 1)) != 0)
+        return fallback;
+    unsigned int cell = 0;
+    while (!(seenIn & (1u << cell)))
+        cell++;
+    return &cellFrusta[cell];
+}
+
+// picks the level of detail for a model from its projected screen size
+unsigned int visualisation::render::selectLod(const Model &model, VecMat::mat4 transform, unsigned int current)
+{
+    glm::vec3 center;
+    float radius;
+    transformSphere(transform, model.boundsCenter, model.boundsRadius, center, radius);
+    float distance = (VecMat::vec3(center.x, center.y, center.z) - camera.Position).norm();
+
+    unsigned int lod = std::min(current, model.lodCount() - 1);
+    if (distance <= radius)
+        return 0;
+    float screenSize = radius / (distance * static_cast<float>(tan(to_radians(camera.Zoom / 2.0f))));
+
+    while (lod > 0 && screenSize > LOD_SCREEN_SIZE[lod - 1] * (1.0f + LOD_HYSTERESIS))
+        --lod;
+    while (lod + 1 < model.lodCount() && screenSize < LOD_SCREEN_SIZE[lod] * (1.0f - LOD_HYSTERESIS))
+        ++lod;
+    return lod;
+}
+
 //Vertices
 float vertices[] = {
     // positions          // normals           // texture coords
@@ -219,12 +487,21 @@ std::vector<std::string> faces{
 void visualisation::render::initializeGlfw()
 {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     //Create glfw window
-    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Escape Room Demonstration in OpenGL", NULL, NULL);
+    // newest context first, the renderer checks what it got (glCaps) and keeps a 3.3 path for the rest
+    const int contextVersions[][2] = {{4, 6}, {4, 5}, {3, 3}};
+    window = NULL;
+    for (const auto &version : contextVersions)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Escape Room Demonstration in OpenGL", NULL, NULL);
+        if (window != NULL)
+            break;
+        std::cout << "OpenGL " << version[0] << "." << version[1] << " context not available" << std::endl;
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -245,10 +522,12 @@ void visualisation::render::initializeGlfw()
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
     }
+    loadGlCapabilities((GLADloadproc)glfwGetProcAddress);
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-    glDepthFunc(GL_LEQUAL);
+    glState.invalidate();
+    glState.setEnabled(GL_DEPTH_TEST, true);
+    glState.depthMask(GL_TRUE);
+    glState.depthFunc(GL_LEQUAL);
     glDepthRange(0.0f, 1.0f);
 
     std::cout << "WINDOW CREATED!" << std::endl;
@@ -267,24 +546,48 @@ void visualisation::render::initializeVertex()
     //Core OpenGL requires that we use a VAO so it knows what to do
     //with our vertex inputs. If we fail to bind a VAO, OpenGL
     //will most likely refuse to draw anything.
+    if (glCaps.directStateAccess)
+    {
+        // the same setup without binding anything: immutable buffers, and the VAOs
+        // read attribute 0 from vertex buffer binding 0
+        glCreateBuffers(1, &cubeVBO);
+        glNamedBufferStorage(cubeVBO, sizeof(vertices), vertices, 0);
+        glCreateBuffers(1, &skyboxVBO);
+        glNamedBufferStorage(skyboxVBO, sizeof(skyboxVertices), &skyboxVertices, 0);
+
+        glCreateVertexArrays(1, &cubeVAO);
+        glCreateVertexArrays(1, &lightVAO);
+        glVertexArrayVertexBuffer(lightVAO, 0, cubeVBO, 0, 8 * sizeof(float));
+        glCreateVertexArrays(1, &skyboxVAO);
+        glVertexArrayVertexBuffer(skyboxVAO, 0, skyboxVBO, 0, 3 * sizeof(float));
+        for (GLuint vertexArray : {lightVAO, skyboxVAO})
+        {
+            glEnableVertexArrayAttrib(vertexArray, 0);
+            glVertexArrayAttribFormat(vertexArray, 0, 3, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribBinding(vertexArray, 0, 0);
+        }
+        std::cout << "Successfully initialized vertexes" << std::endl;
+        return;
+    }
+
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &cubeVBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glGenVertexArrays(1, &lightVAO);
-    glBindVertexArray(lightVAO);
+    glState.bindVertexArray(lightVAO);
     // we only need to bind to the cubeVBO, the container's cubeVBO's data already contains the correct data.
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     // set the vertex attributes (only position data for our lamp)
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
 
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    glState.bindVertexArray(skyboxVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
 
     // we can make a call to the glBufferData function that copies the
     //previously defined vertex data into the buffer's memory:
@@ -324,6 +627,7 @@ void visualisation::render::visualise()
     Shader ourShader("../resources/shaders/mainvertex.vs", "../resources/shaders/mainfragment.fs");    //Lightning Shader
     Shader lampShader("../resources/shaders/lightvertex.vs", "../resources/shaders/lightfragment.fs"); //Light Shader
     Shader skyboxShader("../resources/shaders/skybox.vs", "../resources/shaders/skybox.fs");           //CubeMap Shader
+    Shader depthShader("../resources/shaders/depth.vs", "../resources/shaders/depth.fs");              //Depth prepass Shader
 
     //initiliaze vertex
     initializeVertex();
@@ -333,18 +637,78 @@ void visualisation::render::visualise()
 
     //Get the models
     getModels();
+    buildCells();
+    loadPvs();
+    loadBakedLighting();
 
     // Load cubemap faces
     cubemapTexture = Texture::loadCubemap(faces);
 
     ourShader.Bind();
-    ourShader.setInt("material.diffuse", 0);
-    ourShader.setInt("material.specular", 1);
+    // samplers read fixed units, each mesh binds its textures there (MaterialBinding)
+    ourShader.setInt("material.diffuse", MATERIAL_DIFFUSE);
+    ourShader.setInt("material.specular", MATERIAL_SPECULAR);
+    ourShader.setInt("material.lightmap", MATERIAL_LIGHTMAP);
+    ourShader.bindUniformBlock("Frame", FRAME_UNIFORM_BINDING);
+    ourShader.setInt("clusterLights", TEXTURE_CLUSTER_LIGHTS);
+    ourShader.setInt("clusterGrid", TEXTURE_CLUSTER_GRID);
+    ourShader.setInt("clusterIndices", TEXTURE_CLUSTER_INDICES);
+    ourShader.setInt("shadowMaps", TEXTURE_SHADOW_MAPS);
+    ourShader.setInt("probeCoefficients", TEXTURE_PROBES);
+    lampShader.bindUniformBlock("Frame", FRAME_UNIFORM_BINDING);
+    depthShader.bindUniformBlock("Frame", FRAME_UNIFORM_BINDING);
     skyboxShader.Bind();
     skyboxShader.setInt("skybox", 0);
 
-    Model model("../resources/models/Room/candle.obj");
-
+    Model model("../resources/models/Room/candle.obj", false, LOADER_NATIVE_OBJ);
+    unsigned int candleLod = 0;
+
+    // every draw of the frame goes through the queue, sorted to minimise state changes
+    RenderQueue queue;
+    unsigned int mainProgram = queue.addProgram(&ourShader);
+    unsigned int lampProgram = queue.addProgram(&lampShader);
+    unsigned int skyboxProgram = queue.addProgram(&skyboxShader);
+    queue.setDepthProgram(&depthShader);
+    printGeometryStats();
+
+    // walls and door are rasterised on the CPU each frame, everything else is tested against them
+    OcclusionBuffer occlusion;
+    std::vector<VecMat::mat4> modelTransforms(modelIndex.size());
+    // the GPU alternative: bounding boxes as queries, drawn with the lamp cube
+    OcclusionQueries gpuQueries;
+    gpuQueries.setProxy(&depthShader, lightVAO);
+    // query keys: objects first, then the candle, then the lamps
+    const unsigned int candleObject = (unsigned int)modelIndex.size();
+    const unsigned int lampObject = candleObject + 1;
+
+    // GPU-driven alternative for the objects: every mesh of every object is a record the compute
+    // shader culls, slot i holds object i's transform (identity for the baked static ones)
+    GpuCulling gpuCulling;
+    if (gpuCulling.init("../resources/shaders/cull.comp"))
+    {
+        for (int i = 0; i < modelIndex.size(); ++i)
+        {
+            unsigned int slot = gpuCulling.addObject(VecMat::mat4(1.0f));
+            for (const Mesh &mesh : models[modelIndex[i]].meshes)
+                gpuCulling.addMesh(slot, mesh);
+        }
+        std::cout << "GPU culling: " << gpuCulling.recordCount() << " mesh draws" << std::endl;
+    }
+    else
+        std::cout << "GPU culling not available (needs compute shaders and multi-draw indirect)" << std::endl;
+
+    // the point lights, binned into view clusters every frame
+    LightClusters lights;
+    // shadows of the lights given a slot below; the room is cached, the cards and candle redrawn
+    ShadowMaps shadowMaps;
+    shadowMaps.init("../resources/shaders/shadow.vs", "../resources/shaders/shadow.fs");
+    // the baked day lights for the objects that move, sampled from the probes per draw
+    ProbeLighting probeLighting;
+
+    // frame statistics shown in the window title
+    float statsStart = glfwGetTime();
+    unsigned int statsFrames = 0;
+    float fps = 0.0f;
 
     // render loop
     // -----------
@@ -356,6 +720,7 @@ void visualisation::render::visualise()
         float currentFrame = glfwGetTime();
         deltaTime = 2 * (currentFrame - lastFrame);
         lastFrame = currentFrame;
+        frameStats.reset();
         
         // Cache time for lighting calculations (only update once per frame)
         float currentTime = static_cast<float>(time(nullptr));
@@ -369,77 +734,98 @@ void visualisation::render::visualise()
         // render
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        ourShader.Bind();
-        ourShader.setVec3("viewPos", camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
+        // everything the shaders read per frame goes into one uniform block in the upload ring
+        frameUploads.beginFrame();
+        FrameUniforms frameUniforms = {};
+        frameUniforms.viewPos = glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z);
         // light properties
-        ourShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        ourShader.setVec3("dirLight.ambient", 0.00001f, 0.00001f, 0.001f);
-        ourShader.setVec3("dirLight.diffuse", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+        frameUniforms.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+        frameUniforms.dirLight.ambient = glm::vec3(0.00001f, 0.00001f, 0.001f);
+        frameUniforms.dirLight.diffuse = glm::vec3(0.0f, 0.0f, 0.0f);
+        frameUniforms.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
 
+        lights.clear();
         if (nightmode) {
             // Night mode: dimmer, animated lights
             VecMat::vec3 candlePos = camera.Position + camera.Front * 0.1f;
             float cosTime = cos(currentTime);
             float sinTime = sin(currentTime);
             
-            setupPointLight(ourShader, 0, lightPosition[0], 
-                          VecMat::vec3(0.05f, 0.05f, 0.05f),
-                          VecMat::vec3(cosTime, 0.8f, sinTime),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.032f);
+            addPointLight(lights, lightPosition[0], 
+                        VecMat::vec3(0.05f, 0.05f, 0.05f),
+                        VecMat::vec3(cosTime, 0.8f, sinTime),
+                        VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.032f, shadows ? 0 : -1);
             
-            setupPointLight(ourShader, 1, VecMat::vec3(-2.30034f, 5.45702f, -4.67766f),
-                          VecMat::vec3(0.05f, 0.05f, 0.05f),
-                          VecMat::vec3(sinTime, 0.8f, cosTime),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 1.0f, 0.42f);
+            addPointLight(lights, VecMat::vec3(-2.30034f, 5.45702f, -4.67766f),
+                        VecMat::vec3(0.05f, 0.05f, 0.05f),
+                        VecMat::vec3(sinTime, 0.8f, cosTime),
+                        VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 1.0f, 0.42f, shadows ? 1 : -1);
             
-            setupPointLight(ourShader, 2, VecMat::vec3(candlePos.x, candlePos.y, candlePos.z),
-                          VecMat::vec3(0.00005f, 0.00005f, 0.00005f),
-                          VecMat::vec3(1.0f, 1.0f, 0.5f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.9f, 0.32f);
+            addPointLight(lights, VecMat::vec3(candlePos.x, candlePos.y, candlePos.z),
+                        VecMat::vec3(0.00005f, 0.00005f, 0.00005f),
+                        VecMat::vec3(1.0f, 1.0f, 0.5f),
+                        VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.9f, 0.32f);
             
-            setupPointLight(ourShader, 3, VecMat::vec3(0.0f, 40.0f, 0.0f),
-                          VecMat::vec3(0.15f, 0.15f, 0.15f),
-                          VecMat::vec3(0.8f, 0.8f, 0.8f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 0.1f, 0.04f, 0.0032f);
+            addPointLight(lights, VecMat::vec3(0.0f, 40.0f, 0.0f),
+                        VecMat::vec3(0.15f, 0.15f, 0.15f),
+                        VecMat::vec3(0.8f, 0.8f, 0.8f),
+                        VecMat::vec3(1.0f, 1.0f, 1.0f), 0.1f, 0.04f, 0.0032f);
         }
         else {
-            // Day mode: brighter, static lights
-            setupPointLight(ourShader, 0, VecMat::vec3(0.8f, 6.0f, -5.1f),
-                          VecMat::vec3(0.05f, 0.05f, 0.05f),
-                          VecMat::vec3(0.8f, 0.8f, 0.8f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.032f);
-            
-            setupPointLight(ourShader, 1, VecMat::vec3(-0.8f, 6.0f, -5.1f),
-                          VecMat::vec3(0.05f, 0.05f, 0.05f),
-                          VecMat::vec3(0.8f, 0.8f, 0.8f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.042f);
-            
-            setupPointLight(ourShader, 2, VecMat::vec3(3.55f, 2.1f, -4.6f),
-                          VecMat::vec3(0.05f, 0.05f, 0.05f),
-                          VecMat::vec3(1.0f, 1.0f, 0.5f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 1.0f, 0.09f, 0.0032f);
-            
-            setupPointLight(ourShader, 3, VecMat::vec3(0.0f, 40.0f, 0.0f),
-                          VecMat::vec3(0.15f, 0.15f, 0.15f),
-                          VecMat::vec3(0.8f, 0.8f, 0.8f),
-                          VecMat::vec3(1.0f, 1.0f, 1.0f), 0.01f, 0.0004f, 0.0013f);
+            // Day mode: brighter, static lights, baked into the static meshes' lightmaps
+            std::vector<PointLight> day = dayLights();
+            // the two tubes sit in the wall itself, only the lamp in front of it casts shadows
+            // (on the dynamic objects and on surfaces without a lightmap)
+            day[DAY_LAMP].shadow = shadows ? 0 : -1;
+            for (const PointLight &light : day)
+                lights.add(light);
         }
-
-        ourShader.Bind();
+        frameUniforms.lightmaps = !nightmode && lightmapping && lightmaps.loaded();
+        bool probing = !nightmode && lightmapping && probes.loaded();
+        probeLighting.begin(probes);
 
         // Transformation matrices
         VecMat::mat4 projection = VecMat::perspective(camera.Zoom, static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT));
         VecMat::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        frameUniforms.projection = projection;
+        frameUniforms.view = view;
+        Frustum frustum;
+        frustum.extract(projection, view);
+        const Frustum *cullFrustum = frustumCulling ? &frustum : nullptr;
+        queue.begin(glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z));
+        queue.setMultiDraw(multiDrawIndirect);
+        queue.setDepthPrepass(depthPrepass);
+        OcclusionQueries *cullQueries = occlusionQueries ? &gpuQueries : nullptr;
+        if (cullQueries)
+            gpuQueries.beginFrame(glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z));
+        queue.setOcclusionQueries(cullQueries);
+
+        // cells seen through the open portals, whole cells behind a shut door are skipped
+        if (doorPortal >= 0)
+            cells.setOpen(doorPortal, opendoor);
+        visibleCells = ~0u;
+        if (portalCulling)
+        {
+            visibleCells = cells.traverse(glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z),
+                                          projection, view, cellFrusta);
+            for (unsigned int c = 0; c < cells.cellCount(); c++)
+                frameStats.cellsVisible += (visibleCells >> c) & 1;
+        }
+        frameStats.cellsTotal = cells.cellCount();
+        // what the baked set allows from the eye's cell, nothing is ruled out outside the camera box
+        const uint32_t *pvsBits = pvsCulling ? pvs.cellBits(glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z)) : nullptr;
 
-        // Draw the models
-        for (int i = 0; i < models.size(); ++i)
+        // Place the models
+        shadowMaps.beginFrame();
+        for (int i = 0; i < modelIndex.size(); ++i)
         {
-            VecMat::mat4 modelObject = VecMat::mat4(1.0f);
-            if (modelname[i] == "door" && opendoor)
+            VecMat::mat4 &modelObject = modelTransforms[i];
+            modelObject = VecMat::mat4(1.0f);
+            if (modelStatic[i])
+            {
+                // already in world space
+            }
+            else if (modelname[i] == "door" && opendoor)
             {
                 modelObject = VecMat::translate(modelObject, VecMat::vec3(DOOR_OPEN_TRANSLATE_X, 0.0f, DOOR_OPEN_TRANSLATE_Z));
                 modelObject = VecMat::rotate(modelObject, to_radians(DOOR_OPEN_ANGLE), VecMat::vec3(0.0f, 1.0f, 0.0f));
@@ -480,16 +866,81 @@ void visualisation::render::visualise()
                     }
                 }
 
-                modelObject = VecMat::translate(modelObject, modelPosition[i]);
-                modelObject = VecMat::rotate(modelObject, to_radians(static_cast<float>(modelAngle[i])), VecMat::vec3(0.0f, 1.0f, 0.0f));
-                modelObject = VecMat::scale(modelObject, modelScale[i]);
+                modelObject = objectMatrix(i);
+            }
 
+            auto cardColor = CARD_LIGHT_COLOR.find(modelname[i]);
+            // the cards are picked up and carried, the rest only moves as the door does (which
+            // invalidates the cached shadows)
+            for (const Mesh &mesh : models[modelIndex[i]].meshes)
+                shadowMaps.addCaster(mesh, modelObject, cardColor != CARD_LIGHT_COLOR.end());
+            if (cardColor != CARD_LIGHT_COLOR.end())
+            {
+                glm::vec3 center;
+                float radius;
+                const Model &card = models[modelIndex[i]];
+                transformSphere(modelObject, card.boundsCenter, card.boundsRadius, center, radius);
+                addPointLight(lights, VecMat::vec3(center.x, center.y, center.z), VecMat::vec3(0.0f),
+                              cardColor->second * 0.6f, cardColor->second * 0.3f, 1.0f, 0.7f, 1.8f);
+            }
+        }
 
+        // bin the lights for this view, then the frame block is complete
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        lights.build(projection, view, std::max(framebufferWidth, 1), std::max(framebufferHeight, 1), frameUniforms);
+        lights.bind();
+        queue.setLightSelection(perDrawLights ? &lights : nullptr);
+        queue.setLightmaps(frameUniforms.lightmaps != 0);
+        GLintptr frameOffset = frameUploads.write(&frameUniforms, sizeof(frameUniforms), frameUploads.uniformAlignment());
+        frameUploads.bindRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameOffset, sizeof(frameUniforms));
+
+        // occluders first, at their coarsest level, so the models below can be tested against them
+        const OcclusionBuffer *cullOcclusion = nullptr;
+        if (occlusionCulling)
+        {
+            occlusion.begin(projection, view);
+            for (int i = 0; i < modelIndex.size(); ++i)
+                if (modelOccluder[i])
+                    models[modelIndex[i]].SubmitOccluder(occlusion, modelTransforms[i]);
+            occlusion.rasterize();
+            cullOcclusion = &occlusion;
+        }
 
+        // Queue the models, or leave them to the compute shader
+        bool gpuDriven = gpuDrivenCulling && gpuCulling.available();
+        if (gpuDriven)
+        {
+            for (int i = 0; i < modelIndex.size(); ++i)
+                if (!modelStatic[i])
+                    gpuCulling.setTransform(i, modelTransforms[i]);
+            gpuCulling.cull(frustumCulling ? frustum : Frustum(), glm::vec3(camera.Position.x, camera.Position.y, camera.Position.z),
+                            static_cast<float>(tan(to_radians(camera.Zoom / 2.0f))), LOD_SCREEN_SIZE);
+        }
+        for (int i = 0; i < modelIndex.size() && !gpuDriven; ++i)
+        {
+            Model &objectModel = models[modelIndex[i]];
+            const uint32_t *objectPvs = modelPvsFirst[i] >= 0 ? pvsBits : nullptr;
+            const Frustum *objectFrustum = cullFrustum;
+            if (portalCulling)
+            {
+                glm::vec3 center;
+                float radius;
+                bool hidden;
+                transformSphere(modelTransforms[i], objectModel.boundsCenter, objectModel.boundsRadius, center, radius);
+                objectFrustum = portalFrustum(center, glm::vec3(radius), cullFrustum, hidden);
+                if (hidden)
+                {
+                    frameStats.meshesCulled += (unsigned int)objectModel.meshes.size();
+                    continue;
+                }
             }
+            modelLod[i] = selectLod(objectModel, modelTransforms[i], modelLod[i]);
+            frameStats.lodHistogram[modelLod[i]]++;
 
-            ourShader.setMat4("model", modelObject);
-            models[i].Draw(ourShader);
+            queue.setProbeLighting(probing && !modelStatic[i] ? &probeLighting : nullptr);
+            objectModel.Submit(queue, mainProgram, modelLod[i], modelTransforms[i], objectFrustum, cullOcclusion,
+                               cullQueries, i, objectPvs, objectPvs ? modelPvsFirst[i] : 0);
         }
 
         VecMat::mat4 candle(1.0f);
@@ -497,51 +948,101 @@ void visualisation::render::visualise()
         candle = VecMat::translate(candle, VecMat::vec3(candlePos.x, candlePos.y + CANDLE_OFFSET_Y, candlePos.z));
         candle = VecMat::scale(candle, VecMat::vec3(CANDLE_SCALE, CANDLE_SCALE, CANDLE_SCALE));
 
-        ourShader.setMat4("model", candle);
         if(displaycard)
         {
-            model.Draw(ourShader);
+            for (const Mesh &mesh : model.meshes)
+                shadowMaps.addCaster(mesh, candle, true);
+            candleLod = selectLod(model, candle, candleLod);
+            frameStats.lodHistogram[candleLod]++;
+            queue.setProbeLighting(probing ? &probeLighting : nullptr);
+            model.Submit(queue, mainProgram, candleLod, candle, cullFrustum, cullOcclusion, cullQueries, candleObject);
         }
+        queue.setProbeLighting(nullptr);
 
 
         // Note: propPosition functionality removed - camera now uses GetHandPosition()
 
-        // Light objects (lamps)
-        lampShader.Bind();
-        for (unsigned int i = 0; i < 2; i++)
+        // Light objects (lamps), one instanced draw for all four cubes
+        for (unsigned int i = 0; i < 4; i++)
         {
             VecMat::mat4 lampModel(1.0f);
             lampModel = VecMat::translate(lampModel, lightPosition[i]);
-            lampModel = VecMat::rotate(lampModel, to_radians(90.0f), VecMat::vec3(0.0f, 1.0f, 0.0f));
-            lampModel = VecMat::scale(lampModel, VecMat::vec3(0.03f, 0.05f, 1.8f));
-            lampShader.setMat4("model", lampModel);
-            glBindVertexArray(lightVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            if (i < 2)
+            {
+                lampModel = VecMat::rotate(lampModel, to_radians(90.0f), VecMat::vec3(0.0f, 1.0f, 0.0f));
+                lampModel = VecMat::scale(lampModel, VecMat::vec3(0.03f, 0.05f, 1.8f));
+            }
+            else
+            {
+                lampModel = VecMat::rotate(lampModel, to_radians(90.0f), VecMat::vec3(1.0f, 0.0f, 0.0f));
+                lampModel = VecMat::scale(lampModel, VecMat::vec3(0.1f, 0.15f, 0.15f));
+            }
+            // the night mode lamps hang outside the room, behind the walls
+            glm::vec3 lampCenter, lampExtent;
+            transformBox(lampModel, glm::vec3(-0.5f), glm::vec3(0.5f), lampCenter, lampExtent);
+            if (portalCulling)
+            {
+                bool hidden;
+                const Frustum *lampFrustum = portalFrustum(lampCenter, lampExtent, nullptr, hidden);
+                if (hidden || (lampFrustum && !lampFrustum->intersectsBox(lampCenter, lampExtent)))
+                {
+                    frameStats.meshesCulled++;
+                    continue;
+                }
+            }
+            if (cullOcclusion && cullOcclusion->isOccluded(lampCenter, lampExtent))
+            {
+                frameStats.meshesOccluded++;
+                continue;
+            }
+            GLuint condition = cullQueries ? cullQueries->test(uint64_t(lampObject + i) << 32, lampCenter, lampExtent) : 0;
+            queue.submitArrays(PASS_OPAQUE, lampProgram, lightVAO, 36, &lampModel, lampCenter, GL_TEXTURE_2D, 0, condition);
         }
 
-        for (unsigned int i = 2; i < 4; i++)
+        // Draw skybox as last (its own pass, depth GL_LEQUAL), unless closed walls hide all of it
+        if (pvsBits && !PotentiallyVisibleSet::test(pvsBits, pvs.skyBit()))
+            frameStats.meshesPvsCulled++;
+        else if (!(visibleCells & (1u << outsideCell)))
+            frameStats.meshesCulled++;
+        else if (cullOcclusion && cullOcclusion->farPlaneOccluded())
+            frameStats.meshesOccluded++;
+        else
         {
-            VecMat::mat4 lampModel(1.0f);
-            lampModel = VecMat::translate(lampModel, lightPosition[i]);
-            lampModel = VecMat::rotate(lampModel, to_radians(90.0f), VecMat::vec3(1.0f, 0.0f, 0.0f));
-            lampModel = VecMat::scale(lampModel, VecMat::vec3(0.1f, 0.15f, 0.15f));
-            lampShader.setMat4("model", lampModel);
-            glBindVertexArray(lightVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            skyboxShader.Bind();
+            VecMat::mat4 skyboxView = VecMat::mat4(VecMat::mat3(camera.GetViewMatrix())); // Remove translation
+            skyboxShader.setMat4("view", skyboxView);
+            skyboxShader.setMat4("projection", projection);
+            queue.submitArrays(PASS_SKY, skyboxProgram, skyboxVAO, 36, nullptr, glm::vec3(0.0f),
+                               GL_TEXTURE_CUBE_MAP, cubemapTexture);
         }
 
-        // Draw skybox as last
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.Bind();
-        VecMat::mat4 skyboxView = VecMat::mat4(VecMat::mat3(camera.GetViewMatrix())); // Remove translation
-        skyboxShader.setMat4("view", skyboxView);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        // shadow maps of this frame's casters before the lights are shaded with them
+        shadowMaps.update(lights.all(), framebufferWidth, framebufferHeight);
+        shadowMaps.bind();
+        probeLighting.upload();
+
+        // the GPU-culled objects go first, so their depth is in place for the queue's draws
+        if (gpuDriven)
+            gpuCulling.draw(ourShader, queue);
+        queue.execute();
+        frameUploads.endFrame();
+
+        // refresh the title twice a second so it stays readable
+        statsFrames++;
+        if (currentFrame - statsStart >= 0.5f)
+        {
+            fps = statsFrames / (currentFrame - statsStart);
+            std::string title = "Escape Room Demonstration in OpenGL | " + frameStats.summary(fps);
+            glfwSetWindowTitle(window, title.c_str());
+            statsStart = currentFrame;
+            statsFrames = 0;
+        }
+        if (dumpStats)
+        {
+            std::cout << frameStats.summary(fps) << std::endl;
+            printGeometryStats();
+            dumpStats = false;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -559,19 +1060,22 @@ void visualisation::render::visualise()
     glfwTerminate();
 }
 
-// Helper function to setup point lights
-void visualisation::render::setupPointLight(Shader& shader, int index, const VecMat::vec3& position, 
-                                            const VecMat::vec3& ambient, const VecMat::vec3& diffuse, 
-                                            const VecMat::vec3& specular, float constant, float linear, float quadratic)
+// Helper function to add a point light to this frame's clusters
+void visualisation::render::addPointLight(LightClusters& lights, const VecMat::vec3& position, 
+                                          const VecMat::vec3& ambient, const VecMat::vec3& diffuse, 
+                                          const VecMat::vec3& specular, float constant, float linear, float quadratic,
+                                          int shadow)
 {
-    std::string baseName = "pointLights[" + std::to_string(index) + "].";
-    shader.setVec3(baseName + "position", position);
-    shader.setVec3(baseName + "ambient", ambient);
-    shader.setVec3(baseName + "diffuse", diffuse);
-    shader.setVec3(baseName + "specular", specular);
-    shader.setFloat(baseName + "constant", constant);
-    shader.setFloat(baseName + "linear", linear);
-    shader.setFloat(baseName + "quadratic", quadratic);
+    PointLight light;
+    light.position = glm::vec3(position.x, position.y, position.z);
+    light.ambient = glm::vec3(ambient.x, ambient.y, ambient.z);
+    light.diffuse = glm::vec3(diffuse.x, diffuse.y, diffuse.z);
+    light.specular = glm::vec3(specular.x, specular.y, specular.z);
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    light.shadow = shadow;
+    lights.add(light);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -605,6 +1109,113 @@ void processInput(GLFWwindow *window)
         opendoor=true;
     if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
         opendoor = false;
+
+    static bool f1WasDown = false;
+    bool f1Down = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
+    if (f1Down && !f1WasDown)
+        dumpStats = true;
+    f1WasDown = f1Down;
+
+    static bool f2WasDown = false;
+    bool f2Down = glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS;
+    if (f2Down && !f2WasDown)
+    {
+        frustumCulling = !frustumCulling;
+        std::cout << "Frustum culling " << (frustumCulling ? "on" : "off") << std::endl;
+    }
+    f2WasDown = f2Down;
+
+    static bool f3WasDown = false;
+    bool f3Down = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
+    if (f3Down && !f3WasDown)
+    {
+        multiDrawIndirect = !multiDrawIndirect;
+        std::cout << "Multi-draw indirect " << (multiDrawIndirect ? "on" : "off")
+                  << (glCaps.multiDrawIndirect ? "" : " (not supported by this context)") << std::endl;
+    }
+    f3WasDown = f3Down;
+
+    static bool f4WasDown = false;
+    bool f4Down = glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS;
+    if (f4Down && !f4WasDown)
+    {
+        depthPrepass = !depthPrepass;
+        std::cout << "Depth prepass " << (depthPrepass ? "on" : "off") << std::endl;
+    }
+    f4WasDown = f4Down;
+
+    static bool f5WasDown = false;
+    bool f5Down = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+    if (f5Down && !f5WasDown)
+    {
+        occlusionCulling = !occlusionCulling;
+        std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+    f5WasDown = f5Down;
+
+    static bool f6WasDown = false;
+    bool f6Down = glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS;
+    if (f6Down && !f6WasDown)
+    {
+        occlusionQueries = !occlusionQueries;
+        std::cout << "GPU occlusion queries " << (occlusionQueries ? "on" : "off") << std::endl;
+    }
+    f6WasDown = f6Down;
+
+    static bool f7WasDown = false;
+    bool f7Down = glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS;
+    if (f7Down && !f7WasDown)
+    {
+        portalCulling = !portalCulling;
+        std::cout << "Portal culling " << (portalCulling ? "on" : "off") << std::endl;
+    }
+    f7WasDown = f7Down;
+
+    static bool f8WasDown = false;
+    bool f8Down = glfwGetKey(window, GLFW_KEY_F8) == GLFW_PRESS;
+    if (f8Down && !f8WasDown)
+    {
+        pvsCulling = !pvsCulling;
+        std::cout << "PVS culling " << (pvsCulling ? "on" : "off") << std::endl;
+    }
+    f8WasDown = f8Down;
+
+    static bool f9WasDown = false;
+    bool f9Down = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+    if (f9Down && !f9WasDown)
+    {
+        gpuDrivenCulling = !gpuDrivenCulling;
+        std::cout << "GPU-driven culling " << (gpuDrivenCulling ? "on" : "off")
+                  << (glCaps.computeShaders ? "" : " (not supported by this context)") << std::endl;
+    }
+    f9WasDown = f9Down;
+
+    static bool f10WasDown = false;
+    bool f10Down = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+    if (f10Down && !f10WasDown)
+    {
+        perDrawLights = !perDrawLights;
+        std::cout << "Lights " << (perDrawLights ? "picked per draw" : "from the clusters") << std::endl;
+    }
+    f10WasDown = f10Down;
+
+    static bool f11WasDown = false;
+    bool f11Down = glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS;
+    if (f11Down && !f11WasDown)
+    {
+        shadows = !shadows;
+        std::cout << "Shadows " << (shadows ? "on" : "off") << std::endl;
+    }
+    f11WasDown = f11Down;
+
+    static bool f12WasDown = false;
+    bool f12Down = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (f12Down && !f12WasDown)
+    {
+        lightmapping = !lightmapping;
+        std::cout << "Lightmaps and probes " << (lightmapping ? "on" : "off") << std::endl;
+    }
+    f12WasDown = f12Down;
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
         camera.ProcessKeyboard(BACKWARD, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
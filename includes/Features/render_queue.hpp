@@ -0,0 +1,169 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include "glcaps.hpp"
+#include "gpu_timer.hpp"
+#include "light_clusters.hpp"
+#include "mesh.hpp"
+#include "occlusion_queries.hpp"
+#include "probe_grid.hpp"
+#include "shader.hpp"
+#include "upload_ring.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// passes run in this order, each one sets its own depth state
+enum Render_Pass {
+    PASS_OPAQUE,    // depth GL_LESS, sorted front to back inside a material (GL_LEQUAL
+                    // without depth writes for the draws the depth prepass already laid down)
+    PASS_CONDITIONAL,   // opaque draws behind an occlusion query, the queue moves them here;
+                        // the proxy boxes are drawn just before this pass
+    PASS_SKY        // depth GL_LEQUAL, drawn behind everything
+};
+
+// what gets sorted: the packed key and the command it stands for
+struct RenderItem {
+    uint64_t key;
+    unsigned int command;
+};
+
+// vertex attribute locations 3-6 hold the per instance model matrix, 7 its DrawLights, 9 its
+// ProbeLighting entry (8 is the mesh's lightmap coordinates)
+const GLuint INSTANCE_MATRIX_LOCATION = 3;
+const GLuint INSTANCE_LIGHTS_LOCATION = 7;
+const GLuint INSTANCE_PROBE_LOCATION = 9;
+
+// Collects the frame's draws, radix sorts them by key and issues them with as few program,
+// texture and vertex array changes as possible. Key layout, most significant first:
+//   pass (4 bits) | program (8) | material (20) | depth (32, float bits of the squared distance)
+// Draws of the same geometry, level, material and program are gathered into one instanced
+// draw; their model matrices are written to the frame upload ring (frameUploads) each frame.
+// With GL 4.3 every run of mesh draws sharing program and material becomes a single
+// glMultiDrawElementsIndirect, each command finding its matrices through its base instance.
+// The optional depth prepass draws the opaque meshes' position streams first, depth only, so
+// the shading pass runs each pixel's fragment shader once.
+// Draws given an occlusion query (`condition`) are never batched; each is wrapped in
+// glBeginConditionalRender after the queries' proxy boxes have been drawn.
+// With a light selection set, every mesh draw also gets its own short light list, picked for
+// its world box and uploaded next to its model matrix. Likewise with probe lighting set, every
+// mesh draw gets the probe grid sampled at its center.
+class RenderQueue
+{
+public:
+    // programs are referred to by the id returned here. The program is switched to per instance
+    // model matrices (its `instanced` uniform), so it should only be drawn through the queue.
+    unsigned int addProgram(const Shader *shader);
+
+    // sets what the light and probe attributes read where their arrays are disabled: no light
+    // list of its own and no probe entry. GL leaves these values undefined after any draw that
+    // took the attributes from an array, so draws without the arrays set them right before.
+    static void setInstanceDefaults();
+    // disables the queue's per instance arrays on `vertexArray` (binding it) for draws that feed
+    // the instance attributes themselves; the queue enables them again when it next draws from it
+    void releaseInstanceArrays(GLuint vertexArray);
+
+    // starts a new frame, depth is measured from `eye`
+    void begin(const glm::vec3 &eye);
+
+    // one level of a mesh with its model matrix, `center` / `extent` are its world space bounds
+    void submit(Render_Pass pass, unsigned int program, const Mesh &mesh, unsigned int lod,
+                const VecMat::mat4 &model, const glm::vec3 &center, const glm::vec3 &extent,
+                GLuint condition = 0);
+    // a plain glDrawArrays with an optional model matrix and a single texture
+    // (vertex arrays drawn with a model matrix get the instance attributes added to them)
+    void submitArrays(Render_Pass pass, unsigned int program, GLuint vertexArray, GLsizei vertexCount,
+                      const VecMat::mat4 *model, const glm::vec3 &center,
+                      GLenum textureTarget = GL_TEXTURE_2D, GLuint texture = 0, GLuint condition = 0);
+
+    // sorts and draws everything submitted since begin()
+    void execute();
+
+    size_t size() const { return items.size(); }
+
+    // multi-draw indirect is used when enabled here and supported by the context
+    void setMultiDraw(bool enabled) { multiDraw = enabled; }
+    bool multiDrawActive() const { return multiDraw && glCaps.multiDrawIndirect; }
+
+    // depth-only program for the prepass, it reads positions and per instance model matrices
+    void setDepthProgram(const Shader *shader);
+    void setDepthPrepass(bool enabled) { prepass = enabled; }
+    bool depthPrepassActive() const { return prepass && depthShader; }
+
+    // the queries whose proxies execute() draws before PASS_CONDITIONAL, null to not draw any
+    void setOcclusionQueries(OcclusionQueries *queries) { occlusionQueries = queries; }
+
+    // mesh draws submitted from now on pick their lights from these (built for this frame),
+    // null leaves them to the clusters
+    void setLightSelection(const LightClusters *lights) { lightSelection = lights; }
+    // whether meshes with a lightmap take the baked lights from it this frame
+    // (FrameUniforms::lightmaps), their light lists then leave those lights out
+    void setLightmaps(bool active) { lightmaps = active; }
+    // mesh draws submitted from now on take the baked lights from these probes (begun for this
+    // frame), null leaves them to the shader's lights
+    void setProbeLighting(ProbeLighting *probes) { probeLighting = probes; }
+
+private:
+    struct Command {
+        const Mesh *mesh;           // null for array draws
+        unsigned int lod;
+        GLuint vertexArray;
+        GLsizei vertexCount;
+        GLenum textureTarget;
+        GLuint texture;
+        bool instanced;             // drawn with model matrices from the upload ring
+        unsigned int firstInstance, instanceCount;
+        bool prepassed;             // depth already written by the prepass
+        GLuint condition;           // occlusion query the draw is conditioned on, 0 for none
+    };
+    // draws that can share one instanced call: pass, program, mesh or vertex array, lod, material, condition
+    typedef std::tuple<unsigned int, unsigned int, const void *, unsigned int, unsigned int, GLuint> BatchKey;
+
+    std::vector<const Shader *> programs;
+    std::vector<GLint> shininessLocations;          // per program, -1 when it has no material.shininess
+    std::vector<Command> commands;                  // commands[i] belongs to the unsorted items[i]
+    std::vector<RenderItem> items, scratch;
+    std::map<BatchKey, unsigned int> batches;       // -> command, this frame only
+    std::vector<unsigned int> instanceCommand;      // per submitted instance: its command...
+    std::vector<VecMat::mat4> instanceMatrix;       // ...model matrix...
+    std::vector<DrawLights> instanceLights;         // ...lights...
+    std::vector<uint32_t> instanceProbes;           // ...and probe entry
+    std::vector<VecMat::mat4> instanceUpload;       // the matrices grouped by command
+    std::vector<DrawLights> instanceLightsUpload;   // and the lights and probe entries in the same order
+    std::vector<uint32_t> instanceProbesUpload;
+    std::vector<GLuint> instancedArrays;            // vertex arrays that have the instance attributes enabled
+    GLintptr instanceOffset = 0;                    // where this frame's matrices are in frameUploads
+    GLintptr instanceLightsOffset = 0;
+    GLintptr instanceProbesOffset = 0;
+    const LightClusters *lightSelection = nullptr;
+    ProbeLighting *probeLighting = nullptr;
+    bool lightmaps = false;
+    std::vector<DrawElementsIndirectCommand> indirect;  // mesh commands in sorted order
+    GLintptr indirectOffset = 0;
+    bool multiDraw = true;
+    const Shader *depthShader = nullptr;
+    bool prepass = false;
+    std::vector<DrawElementsIndirectCommand> prepassIndirect;
+    GpuTimer prepassTimer, mainTimer;
+    OcclusionQueries *occlusionQueries = nullptr;
+    glm::vec3 eye;
+
+    uint64_t makeKey(Render_Pass pass, unsigned int program, unsigned int material, const glm::vec3 &center) const;
+    void push(Render_Pass pass, unsigned int program, unsigned int material, const glm::vec3 &center,
+              const Command &command, const VecMat::mat4 *model, const void *geometry,
+              const DrawLights &lights = DrawLights(), uint32_t probe = ProbeLighting::NONE);
+    void uploadInstances();
+    void uploadIndirect();
+    void bindInstances(GLuint vertexArray, unsigned int firstInstance);
+    void depthPrepass(bool useIndirect);
+    void sort();
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "light_clusters.hpp"
+#include "object.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// The escape room: every object handed to the renderer. Kept out of main() so the offline
+// bakers load exactly what the game draws, in the same order.
+struct Scene
+{
+    Object root;                                    // the objects are its children
+    std::vector<std::unique_ptr<Object>> objects;   // owned here, root only points at them
+
+    // a new object (scale 3 like every room model), added to root
+    Object *add(std::string name);
+};
+
+// the visibility set PvsBake writes for this scene and the renderer reads
+const char *const SCENE_PVS_PATH = "../resources/pvs/room.pvs";
+// the lightmaps LightmapBake writes for the static meshes, with the day lights in them
+const char *const SCENE_LIGHTMAP_PATH = "../resources/lightmaps/room.lightmap";
+// the probe grid LightmapBake writes next to them (the lightmap path with a .probes extension)
+const char *const SCENE_PROBE_PATH = "../resources/lightmaps/room.probes";
+
+void buildScene(Scene &scene);
+
+// the point lights of day mode: two tubes set into the back wall, the lamp in front of it and
+// the light from above. They never move, so they are baked (PointLight::baked)
+std::vector<PointLight> dayLights();
+const unsigned int DAY_LAMP = 2;    // the lamp, the only one that casts shadows
+
+#endif
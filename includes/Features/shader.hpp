@@ -21,6 +21,8 @@ public:
   
     // constructor reads and builds the shader
     Shader(const char* vertexPath, const char* fragmentPath);
+    // compute program from a single file, only with glCaps.computeShaders
+    explicit Shader(const char* computePath);
     // use/activate the shader
     void use();
     // utility uniform functions
@@ -51,6 +53,11 @@ public:
     void setVec3(const std::string &name, const VecMat::vec3 value) const;
     void setMat3(const std::string &name, const VecMat::mat3 mat) const;
 
+    // location to keep for uniforms set every draw, -1 when the program has no such uniform
+    int uniformLocation(const std::string &name) const;
+    // connects a uniform block to a buffer binding point (GLSL 330 has no layout(binding))
+    void bindUniformBlock(const std::string &name, unsigned int binding) const;
+
     private:
     // the program ID
     unsigned int ID;
@@ -0,0 +1,87 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <matrix.hpp>
+
+#include "frustum.hpp"
+#include "gpu_timer.hpp"
+#include "light_clusters.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Omnidirectional shadows for the few point lights that have a shadow slot (PointLight::shadow).
+// Each slot is a cube of six SIZE x SIZE depth faces holding the distance to the light over its
+// shadow range, stored as layers slot * 6 + face of a 2D array texture (cube map arrays need
+// GL 4.0, a 2D array with the face picked in the shader works on 3.3).
+// Rendering six faces per light per frame is what this avoids: the static casters go into a
+// cached array that is only redrawn when the light moves or a static caster changes (the door
+// opening, found by hashing the static casters' transforms). The array the shader reads is a
+// copy of the cached faces with the dynamic casters (cards, the candle) drawn over them, and
+// only the faces a dynamic caster reaches are copied and redrawn each frame.
+class ShadowMaps
+{
+public:
+    static const unsigned int SIZE = 512;
+    static const unsigned int SLOTS = 3;
+
+    ShadowMaps() = default;
+    ~ShadowMaps();
+    ShadowMaps(const ShadowMaps &) = delete;
+    ShadowMaps &operator=(const ShadowMaps &) = delete;
+
+    // loads the program that writes the distances, creates the textures
+    void init(const char *vertexPath, const char *fragmentPath);
+
+    // starts the frame's list of casters
+    void beginFrame();
+    // a mesh with its world transform this frame; dynamic ones are redrawn every frame
+    void addCaster(const Mesh &mesh, const VecMat::mat4 &transform, bool dynamic);
+    // brings every slot used by `lights` up to date, then restores the viewport
+    void update(const std::vector<PointLight> &lights, int viewportWidth, int viewportHeight);
+    // binds the array the shader reads to TEXTURE_SHADOW_MAPS
+    void bind() const;
+
+private:
+    struct Caster
+    {
+        const Mesh *mesh;
+        VecMat::mat4 transform;
+        glm::vec3 center, extent;   // world space bounds
+    };
+    struct Slot
+    {
+        glm::vec3 position;
+        float range = 0.0f;
+        uint64_t hash = 0;          // of the static casters drawn
+        bool cached = false;        // the static faces are valid for position / range / hash
+        uint8_t dynamicFaces = 0;   // faces with dynamic casters drawn over them last frame
+    };
+    // one face of a light's cube
+    struct Face
+    {
+        VecMat::mat4 view, projection;
+        Frustum frustum;
+        glm::vec3 light;
+        float range;
+    };
+
+    Shader *program = nullptr;
+    GLint viewLocation = -1, projectionLocation = -1, modelLocation = -1, lightLocation = -1, rangeLocation = -1;
+    GLuint staticFaces = 0, faces = 0;  // depth arrays: cached static casters, and what is sampled
+    GLuint drawFramebuffer = 0, readFramebuffer = 0;
+    std::vector<Caster> staticCasters, dynamicCasters;
+    uint64_t staticHash = 0;    // of this frame's static casters, changes when one moves
+    Slot slots[SLOTS];
+    GpuTimer timer;
+
+    GLuint createArray(bool compare);
+    static bool reaches(const Face &face, const Caster &caster);
+    void renderFace(GLuint array, unsigned int layer, const Face &face, const std::vector<Caster> &casters, bool clear);
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include <cstddef>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) by edge collapse.
+// Only the index buffer is rewritten: every collapse moves a vertex onto one of its
+// neighbours, so all LODs of a mesh can keep sharing the source vertex buffer.
+// UV/normal seams and non-manifold vertices are locked, open borders only collapse along themselves.
+//
+// positions   : first float of each vertex position, `stride` bytes apart
+// indices     : triangle list to simplify
+// targetIndexCount : stop once the triangle list is this small (or nothing can collapse any more)
+// resultError : optional, receives the largest collapse error as an object-space distance
+std::vector<unsigned int> simplifyMesh(const float *positions, size_t vertexCount, size_t stride,
+                                       const std::vector<unsigned int> &indices, size_t targetIndexCount,
+                                       float *resultError = nullptr);
+
+// Welds vertices that only differ by normal/uv: every distinct position is appended once to
+// `packed` (x, y, z tightly packed) and the returned table maps each source vertex to its slot.
+std::vector<unsigned int> weldPositions(const float *positions, size_t vertexCount, size_t stride,
+                                        std::vector<float> &packed);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdio>
+#include <string>
+
+// Per-frame counters filled in by the draw code and shown in the window title.
+struct FrameStats {
+    unsigned int drawCalls = 0;
+    unsigned int instances = 0;                     // objects drawn, instanced draws count several
+    unsigned int indirectDraws = 0;                 // draws folded into multi-draw indirect calls
+    unsigned long long triangles = 0;
+    unsigned int lodHistogram[4] = {0, 0, 0, 0};   // objects drawn at each LOD this frame
+    unsigned int meshesVisible = 0;                 // meshes that passed frustum culling
+    unsigned int meshesCulled = 0;
+    unsigned int meshesPvsCulled = 0;               // static meshes the baked visibility set rules out
+    unsigned int cellsVisible = 0;                  // cells reached through open portals
+    unsigned int cellsTotal = 0;
+    unsigned int meshesOccluded = 0;                // hidden behind the software rasterised occluders
+    unsigned int occluderTriangles = 0;
+    float occlusionMs = 0.0f;                       // CPU time spent rasterising and testing
+    unsigned int occlusionQueries = 0;              // GPU proxy box queries issued...
+    unsigned int conditionalDraws = 0;              // ...and draws left to their result
+    unsigned int gpuCullRecords = 0;                // mesh draws the compute shader tested...
+    float gpuCullMs = 0.0f;                         // ...and its GPU time, from a few frames ago
+    unsigned int lights = 0;                        // point lights binned into clusters...
+    unsigned int clusterLightRefs = 0;              // ...the entries of all cluster lists
+    unsigned int clusterLightsMax = 0;              // and the longest list
+    unsigned int lightsDropped = 0;                 // lights and cluster list entries left out because
+    unsigned int clusterLightRefsDropped = 0;       // their buffer texture was full
+    unsigned int drawLightLists = 0;                // draws given their own light list instead...
+    unsigned int drawLightRefs = 0;                 // ...and the lights on those lists
+    unsigned int probeDraws = 0;                    // draws lit by the probe grid instead of the baked lights
+    unsigned int shadowStaticFaces = 0;             // shadow map faces redrawn from the static casters,
+    unsigned int shadowDynamicFaces = 0;            // faces the dynamic casters were drawn over,
+    unsigned int shadowCasterDraws = 0;             // the draws for both
+    float shadowMs = 0.0f;                          // and their GPU time, from a few frames ago
+    unsigned int programChanges = 0;                // state changes issued by the render queue
+    unsigned int materialChanges = 0;
+    unsigned int vertexArrayChanges = 0;
+    unsigned int stateCallsIssued = 0;              // GL state calls made / skipped by the state cache
+    unsigned int stateCallsAvoided = 0;
+    unsigned int uploadBytes = 0;                   // written to the frame upload ring
+    unsigned int uploadStalls = 0;                  // times the ring had to wait for the GPU
+    float gpuPrepassMs = 0.0f;                      // GPU time of the depth prepass and the main pass,
+    float gpuMainMs = 0.0f;                         // from a few frames ago
+
+    void reset()
+    {
+        *this = FrameStats();
+    }
+
+    // one line summary, e.g. for the window title
+    std::string summary(float fps) const
+    {
+        char line[800];
+        std::snprintf(line, sizeof(line), "%.0f fps | %u draws (%u inst, %u indirect) | %llu tris | LOD %u/%u/%u/%u | culled %u/%u | pvs %u | cells %u/%u | "
+                      "occluded %u (%u tris, %.2f ms) | queries %u (%u conditional) | gpu cull %u (%.2f ms) | "
+                      "lights %u (%u in clusters, max %u, %.1f per draw, dropped %u / %u) | probes %u | "
+                      "shadow faces %u static %u dynamic (%u draws, %.2f ms) | "
+                      "changes prog %u mat %u vao %u | gl calls %u (%u skipped) | upload %.1f KB (%u stalls) | "
+                      "gpu prepass %.2f ms main %.2f ms",
+                      fps, drawCalls, instances, indirectDraws, triangles,
+                      lodHistogram[0], lodHistogram[1], lodHistogram[2], lodHistogram[3],
+                      meshesCulled, meshesVisible + meshesCulled + meshesOccluded + meshesPvsCulled, meshesPvsCulled,
+                      cellsVisible, cellsTotal,
+                      meshesOccluded, occluderTriangles, occlusionMs, occlusionQueries, conditionalDraws,
+                      gpuCullRecords, gpuCullMs, lights, clusterLightRefs, clusterLightsMax,
+                      drawLightLists ? float(drawLightRefs) / drawLightLists : 0.0f, lightsDropped,
+                      clusterLightRefsDropped, probeDraws,
+                      shadowStaticFaces, shadowDynamicFaces, shadowCasterDraws, shadowMs,
+                      programChanges, materialChanges, vertexArrayChanges,
+                      stateCallsIssued, stateCallsAvoided, uploadBytes / 1024.0f, uploadStalls,
+                      gpuPrepassMs, gpuMainMs);
+        return line;
+    }
+};
+
+inline FrameStats frameStats;
+
+#endif
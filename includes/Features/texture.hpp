@@ -1,4 +1,6 @@
 #include <glad/glad.h>
+#include "glcaps.hpp"
+#include "glstate.hpp"
 #include<string>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -23,28 +25,49 @@ public:
     inline int getHeight() const { return height; }
 
     static GLuint loadCubemap(vector<std::string> faces);
+
+private:
+    static GLuint loadCubemapStorage(const vector<std::string> &faces);
 };
 
 Texture::Texture(std::string path)
 {
-        //The glGenTextures function first takes as input how many textures we want to generate
-
-    glGenTextures(1, &ID);
-    glBindTexture(GL_TEXTURE_2D, ID) ; // Bind without slot selection
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 //    stbi_set_flip_vertically_on_load(1);
     int width, height, nrChannels;
     const char* ccpath = path.c_str();
     data = stbi_load(ccpath, &width, &height, &nrChannels, 4);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    Unbind();
+    if (glCaps.directStateAccess)
+    {
+        // immutable storage: size and mip chain are fixed up front, no binding needed to fill it
+        glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+        glTextureParameteri(ID, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTextureParameteri(ID, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+        glTextureParameteri(ID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(ID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (data)
+        {
+            glTextureStorage2D(ID, mipLevels(width, height), GL_RGBA8, width, height);
+            glTextureSubImage2D(ID, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            glGenerateTextureMipmap(ID);
+        }
+    }
+    else
+    {
+        //The glGenTextures function first takes as input how many textures we want to generate
+
+        glGenTextures(1, &ID);
+        glState.bindTexture(GL_TEXTURE_2D, ID) ; // Bind without slot selection
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        Unbind();
+    }
 
     if (data)
         stbi_image_free(data);
@@ -59,20 +82,22 @@ Texture::~Texture()
 void Texture::Bind(unsigned int slot) const
 {
 
-    glActiveTexture(GL_TEXTURE0 + slot);
-     glBindTexture(GL_TEXTURE_2D, ID);
+    glState.bindTexture(slot, GL_TEXTURE_2D, ID);
 }
 
 void Texture::Unbind() const
 {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
 }
 
 GLuint Texture::loadCubemap(vector<std::string> faces)
 	{
+        if (glCaps.directStateAccess)
+            return loadCubemapStorage(faces);
+
         unsigned int textureID;
         glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        glState.bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 //        stbi_set_flip_vertically_on_load(1);
         int width, height, nrChannels;
         for (unsigned int i = 0; i < faces.size(); i++)
@@ -99,3 +124,37 @@ GLuint Texture::loadCubemap(vector<std::string> faces)
 
         return textureID;
 	}
+
+// DSA version: one immutable allocation for all six faces (sized by the first one),
+// each face is layer i of the cube map
+GLuint Texture::loadCubemapStorage(const vector<std::string> &faces)
+{
+    GLuint textureID;
+    glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &textureID);
+    glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(textureID, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    int size = 0;
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        int width, height, nrChannels;
+        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 3);
+        if (!data || (size && (width != size || height != size)))
+        {
+            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
+            stbi_image_free(data);
+            continue;
+        }
+        if (!size)
+        {
+            size = width;
+            glTextureStorage2D(textureID, 1, GL_RGB8, size, size);
+        }
+        glTextureSubImage3D(textureID, 0, 0, 0, i, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
+        stbi_image_free(data);
+    }
+    return textureID;
+}
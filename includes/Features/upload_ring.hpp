@@ -0,0 +1,66 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// One buffer for everything the CPU writes per frame (uniform blocks, instance matrices,
+// indirect commands), split into FRAMES parts used round robin.
+//
+// With GL 4.4 the buffer is created with glBufferStorage and stays mapped (persistent and
+// coherent), a write is a plain memcpy. A fence placed after each frame's draws is waited on
+// before that part is written again, so the CPU never overwrites data the GPU is still reading.
+// Without buffer storage there is a single part that is orphaned every frame and written
+// with glBufferSubData.
+//
+// Offsets returned by write() are absolute and stay valid for the whole frame, even when a
+// write does not fit and the buffer has to grow (ranges bound through bindRange are rebound).
+class UploadRing
+{
+public:
+    static const unsigned int FRAMES = 3;
+
+    explicit UploadRing(size_t frameBytes = 256 * 1024);
+
+    // waits until the GPU is done with the part this frame writes into (creates the buffer on first use)
+    void beginFrame();
+    // copies `bytes` into this frame's part, `alignment` has to be a power of two
+    GLintptr write(const void *data, size_t bytes, size_t alignment = 16);
+    // glBindBufferRange for indexed targets (uniform blocks)
+    void bindRange(GLenum target, GLuint index, GLintptr offset, size_t bytes);
+    // fences the frame's draws, call after the last draw that reads this frame's data
+    void endFrame();
+
+    GLuint buffer() const { return name; }
+    size_t uniformAlignment() const { return uniformOffsetAlignment; }
+    bool persistent() const { return mapped != nullptr; }
+
+private:
+    struct BoundRange
+    {
+        GLenum target;
+        GLuint index;
+        GLintptr offset;
+        size_t bytes;
+    };
+
+    size_t frameBytes;                  // capacity of one part
+    GLuint name = 0;
+    unsigned char *mapped = nullptr;    // persistent mapping of the whole buffer
+    GLsync fences[FRAMES] = {};
+    unsigned int frame = 0;             // part written this frame
+    size_t base = 0, cursor = 0;        // start of this frame's part, bytes used in it
+    bool drainNext = false;             // the buffer grew: the next frame waits for every part
+    size_t uniformOffsetAlignment = 256;
+    std::vector<BoundRange> ranges;     // bound this frame
+
+    void create(size_t frameBytes);
+    void grow(size_t needed);
+    void wait(unsigned int part);
+};
+
+extern UploadRing frameUploads;
+
+#endif
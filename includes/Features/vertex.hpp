@@ -0,0 +1,23 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glm/glm.hpp>
+
+// interleaved vertex layout shared by every mesh (32 bytes)
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+};
+
+// a vertex with where it lies in its mesh's lightmap (unwrapLightmap), the layout of the static
+// batches that have one (40 bytes)
+struct LightmappedVertex {
+    Vertex vertex;
+    glm::vec2 LightmapCoords;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aModel;   // per instance, used when `instanced` is set
+
+// the camera part of the per frame block, the lights after it aren't needed here
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform mat4 model;
+uniform bool instanced;
+
+// the main pass tests against this depth with GL_LEQUAL, so both have to compute
+// gl_Position the same way, bit for bit
+invariant gl_Position;
+
+void main()
+{
+    mat4 world = instanced ? aModel : model;
+    vec3 fragPos = vec3(world * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(fragPos, 1.0);
+}
@@ -1,11 +1,17 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 aModel;   // per instance, used when `instanced` is set
+
+// the camera part of the per frame block, the lights after it aren't needed here
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
 
 void main()
 {
-	gl_Position = projection*view*model*vec4(aPos, 1.0);
+	gl_Position = projection*view*(instanced ? aModel : model)*vec4(aPos, 1.0);
 }
\ No newline at end of file
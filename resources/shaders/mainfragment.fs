@@ -4,11 +4,12 @@ out vec4 FragColor;
 struct Material {
     sampler2D diffuse;
     sampler2D specular;    
+    sampler2D lightmap;    // baked light, alpha 0 where the mesh has none (lightmap.hpp)
     float shininess;
 }; 
 
 struct DirLight {
-    vec3 direction;	
+    vec3 direction;
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -16,30 +17,103 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
- 
-    float constant;
-    float linear;
-    float quadratic;
-	
+    float radius;       // nothing past it is lit
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;
+    float quadratic;
+    int shadow;         // slot in shadowMaps, -1 for none
+    float shadowRange;  // the distance its shadow maps cover
+    bool baked;         // in the lightmaps
+};
+
+// written once per frame (FrameUniforms in frame_uniforms.hpp)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    uint lightmaps;         // non zero when the lightmaps hold the baked lights
+    DirLight dirLight;
+    vec4 clusterScale;      // xy: clusters per pixel, zw: slice = log(depth) * z + w
+    uvec4 clusterDims;      // clusters across, up and deep, and the light count
 };
 
-#define NR_POINT_LIGHTS 4
+// the point lights binned into clusters (LightClusters in light_clusters.hpp): five texels per
+// light, an (offset, count) pair per cluster and the light indices those point into
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+// six faces per shadow slot holding distance / shadowRange (ShadowMaps in shadow_maps.hpp)
+uniform sampler2DArrayShadow shadowMaps;
+const float SHADOW_MAP_SIZE = 512.0;
+// nine SH coefficients per entry, the baked lights around a dynamic draw (ProbeLighting in probe_grid.hpp)
+uniform samplerBuffer probeCoefficients;
+
+// look direction, right and up of each face, as ShadowMaps renders them (+x, -x, +y, -y, +z, -z)
+const vec3 FACE_DIR[6] = vec3[6](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_RIGHT[6] = vec3[6](vec3(0, 0, -1), vec3(0, 0, 1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(-1, 0, 0));
+const vec3 FACE_UP[6] = vec3[6](vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0));
 
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 TexCoords;
+in vec2 LightmapCoords;
+// the draw's own lights, 0xffff ends the list; 0xfffe first means it has none and uses its cluster
+flat in uvec4 DrawLights;
+// the draw's entry in probeCoefficients, 0xffffffff for none
+flat in uint Probe;
   
-uniform vec3 viewPos;
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+// the fragment's baked lights come from its lightmap or the probes, CalcPointLight skips them
+bool bakedLights = false;
 
 // function prototypes
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor);
+
+PointLight fetchLight(int index)
+{
+    vec4 a = texelFetch(clusterLights, 5 * index);
+    vec4 b = texelFetch(clusterLights, 5 * index + 1);
+    vec4 c = texelFetch(clusterLights, 5 * index + 2);
+    vec4 d = texelFetch(clusterLights, 5 * index + 3);
+    vec4 e = texelFetch(clusterLights, 5 * index + 4);
+    return PointLight(a.xyz, a.w, b.xyz, b.w, c.xyz, c.w, d.xyz, d.w, int(e.x), e.y, e.z != 0.0);
+}
+
+// the probes' irradiance for this normal, same basis as shBasis in probe_grid.cpp
+vec3 probeIrradiance(vec3 n)
+{
+    int base = 9 * int(Probe);
+    vec3 result = texelFetch(probeCoefficients, base).rgb * 0.282095
+                + texelFetch(probeCoefficients, base + 1).rgb * (0.488603 * n.y)
+                + texelFetch(probeCoefficients, base + 2).rgb * (0.488603 * n.z)
+                + texelFetch(probeCoefficients, base + 3).rgb * (0.488603 * n.x)
+                + texelFetch(probeCoefficients, base + 4).rgb * (1.092548 * n.x * n.y)
+                + texelFetch(probeCoefficients, base + 5).rgb * (1.092548 * n.y * n.z)
+                + texelFetch(probeCoefficients, base + 6).rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+                + texelFetch(probeCoefficients, base + 7).rgb * (1.092548 * n.x * n.z)
+                + texelFetch(probeCoefficients, base + 8).rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(result, vec3(0.0));
+}
+
+// 1 where the light reaches the fragment, 0 in its shadow (filtered in between)
+float shadowFactor(PointLight light, vec3 fragPos, vec3 normal)
+{
+    vec3 toFrag = fragPos - light.position;
+    float distance = length(toFrag);
+    if (light.shadow < 0 || distance >= light.shadowRange)
+        return 1.0;
+    // pushed off the surface by about a texel, so it doesn't shadow itself
+    toFrag += normal * (2.0 * distance / SHADOW_MAP_SIZE);
+    vec3 a = abs(toFrag);
+    int face = a.x >= a.y && a.x >= a.z ? (toFrag.x > 0.0 ? 0 : 1)
+             : a.y >= a.z ? (toFrag.y > 0.0 ? 2 : 3) : (toFrag.z > 0.0 ? 4 : 5);
+    vec2 uv = 0.5 + 0.5 * vec2(dot(toFrag, FACE_RIGHT[face]), dot(toFrag, FACE_UP[face])) / dot(toFrag, FACE_DIR[face]);
+    return texture(shadowMaps, vec4(uv, float(light.shadow * 6 + face), length(toFrag) / light.shadowRange - 0.002));
+}
 
 float near = 0.1f;
 float far = 100.0f;
@@ -59,19 +133,47 @@ void main()
 {
         vec3 norm = normalize(Normal);
         vec3 viewDir = normalize(viewPos - FragPos);
+        vec3 diffuseColor = vec3(texture(material.diffuse, TexCoords));
+        vec3 specularColor = vec3(texture(material.specular, TexCoords));
 
-// 		float depth = logisticDepth(gl_FragCoord.z);
+		//directional light
+		vec3 result = CalcDirLight(dirLight, norm, viewDir, diffuseColor, specularColor);
 
+		//baked point lights, from the lightmap of a static mesh...
+		vec4 baked = texture(material.lightmap, LightmapCoords);
+		if (lightmaps != 0u && baked.a > 0.5)
+		{
+			bakedLights = true;
+			result += baked.rgb * diffuseColor;
+		}
+		//...or the probes around a dynamic one
+		else if (Probe != 0xffffffffu)
+		{
+			bakedLights = true;
+			result += probeIrradiance(norm) * diffuseColor;
+		}
 
-		//directional light
-		vec3 result = CalcDirLight(dirLight, norm, viewDir);
-		//point lights 
-		for(int i = 0; i < NR_POINT_LIGHTS; i++)
-			result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+		//point lights, those picked for the draw...
+		if (DrawLights.x != 0xfffeu)
+		{
+			for(int i = 0; i < 4 && DrawLights[i] != 0xffffu; i++)
+				result += CalcPointLight(fetchLight(int(DrawLights[i])), norm, FragPos, viewDir, diffuseColor, specularColor);
+			FragColor = vec4(result, 1.0);
+			return;
+		}
+		//...or only those of the fragment's cluster
+		float depth = -(view * vec4(FragPos, 1.0)).z;
+		uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * clusterScale.xy),
+		                      uint(max(log(depth) * clusterScale.z + clusterScale.w, 0.0)));
+		cluster = min(cluster, clusterDims.xyz - 1u);
+		uvec2 range = texelFetch(clusterGrid, int(cluster.x + clusterDims.x * (cluster.y + clusterDims.y * cluster.z))).rg;
+		for(uint i = 0u; i < range.y; i++)
+			result += CalcPointLight(fetchLight(int(texelFetch(clusterIndices, int(range.x + i)).r)), norm, FragPos, viewDir,
+			                         diffuseColor, specularColor);
 		FragColor = vec4(result, 1.0);
 }
 // calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
 {
  		vec3 lightDir = normalize(-light.direction);
 		// diffuse shading
@@ -81,30 +183,36 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
         vec3 reflectDir = reflect(-lightDir, normal);  
         float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
         // combine results
-		vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-		vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-		vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+		vec3 ambient = light.ambient * diffuseColor;
+		vec3 diffuse = light.diffuse * diff * diffuseColor;
+		vec3 specular = light.specular * spec * specularColor;
 		return (ambient + diffuse + specular);    
 }
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
 {
+    if (bakedLights && light.baked)
+        return vec3(0.0);
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // attenuation
+    // attenuation, faded out towards the radius so cluster edges don't show
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    float fade = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+    attenuation *= fade * fade;
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    // the shadow takes the direct light, the ambient term stays
+    float lit = diff > 0.0 ? shadowFactor(light, fragPos, normal) : 1.0;
     ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    diffuse *= attenuation * lit;
+    specular *= attenuation * lit;
     return (ambient + diffuse + specular);
 }
 
@@ -2,19 +2,50 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in mat4 aModel;   // per instance, used when `instanced` is set
+layout (location = 7) in uvec4 aLights; // per instance DrawLights (light_clusters.hpp)
+layout (location = 8) in vec2 aLightmapCoords;
+layout (location = 9) in uint aProbe;   // per instance ProbeLighting entry (probe_grid.hpp)
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+out vec2 LightmapCoords;
+flat out uvec4 DrawLights;
+flat out uint Probe;
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// written once per frame (FrameUniforms in frame_uniforms.hpp), same block as in mainfragment.fs
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+    uint lightmaps;
+    DirLight dirLight;
+    vec4 clusterScale;
+    uvec4 clusterDims;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool instanced;
+
+// must match depth.vs, the depth prepass result is tested with GL_LEQUAL
+invariant gl_Position;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    mat4 world = instanced ? aModel : model;
+    FragPos = vec3(world * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(world))) * aNormal;  
     TexCoords = aTexCoords;   
+    LightmapCoords = aLightmapCoords;
+    DrawLights = aLights;
+    Probe = aProbe;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+in vec3 WorldPos;
+
+uniform vec3 lightPosition;
+uniform float range;
+
+// the distance to the light over the shadow range, the same on every face, so mainfragment.fs
+// compares distances instead of undoing each face's projection
+void main()
+{
+    gl_FragDepth = length(WorldPos - lightPosition) / range;
+}
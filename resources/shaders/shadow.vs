@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 WorldPos;
+
+// one face of the light's cube (ShadowMaps in shadow_maps.hpp)
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+void main()
+{
+    WorldPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,40 @@
+#include "buffer_texture.hpp"
+#include "glstate.hpp"
+
+#include <algorithm>
+
+BufferTexture::~BufferTexture()
+{
+    if (buffer)
+    {
+        glState.bufferDeleted(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void BufferTexture::create(GLenum format, unsigned int textureUnit)
+{
+    unit = textureUnit;
+    glGenBuffers(1, &buffer);
+    glGenTextures(1, &texture);
+    upload(nullptr, 0);
+    // a fresh name has no texture object yet, so this bind can't go through DSA
+    glState.activeTexture(unit);
+    glState.bindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void BufferTexture::upload(const void *data, size_t bytes)
+{
+    // an empty buffer texture is incomplete, keep at least one texel
+    glState.bindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, size_t(16)), nullptr, GL_STREAM_DRAW);
+    if (bytes)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+}
+
+void BufferTexture::bind() const
+{
+    glState.bindTexture(unit, GL_TEXTURE_BUFFER, texture);
+}
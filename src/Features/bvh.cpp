@@ -0,0 +1,183 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void TriangleBvh::build(const std::vector<Triangle> &input)
+{
+    triangles = input;
+    nodes.clear();
+    if (triangles.empty())
+        return;
+    std::vector<glm::vec3> centroids(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++)
+        centroids[i] = (triangles[i].v0 + triangles[i].v1 + triangles[i].v2) * (1.0f / 3.0f);
+    nodes.reserve(2 * triangles.size() / LEAF_SIZE + 1);
+    buildNode(centroids, 0, (unsigned int)triangles.size());
+}
+
+unsigned int TriangleBvh::buildNode(std::vector<glm::vec3> &centroids, unsigned int first, unsigned int count)
+{
+    unsigned int index = (unsigned int)nodes.size();
+    nodes.push_back(Node());
+
+    glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centerMin(FLT_MAX), centerMax(-FLT_MAX);
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        const Triangle &tri = triangles[i];
+        boundsMin = glm::min(boundsMin, glm::min(tri.v0, glm::min(tri.v1, tri.v2)));
+        boundsMax = glm::max(boundsMax, glm::max(tri.v0, glm::max(tri.v1, tri.v2)));
+        centerMin = glm::min(centerMin, centroids[i]);
+        centerMax = glm::max(centerMax, centroids[i]);
+    }
+    nodes[index].boundsMin = boundsMin;
+    nodes[index].boundsMax = boundsMax;
+
+    int axis = 0;
+    glm::vec3 spread = centerMax - centerMin;
+    if (spread.y > spread[axis])
+        axis = 1;
+    if (spread.z > spread[axis])
+        axis = 2;
+    // few triangles, or all centroids in one spot: nothing left to split
+    if (count <= LEAF_SIZE || spread[axis] <= 0.0f)
+    {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        return index;
+    }
+
+    // median split, triangles and centroids are reordered together
+    unsigned int half = count / 2;
+    std::vector<unsigned int> order(count);
+    for (unsigned int i = 0; i < count; i++)
+        order[i] = first + i;
+    std::nth_element(order.begin(), order.begin() + half, order.end(),
+                     [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+    std::vector<Triangle> sortedTriangles(count);
+    std::vector<glm::vec3> sortedCentroids(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        sortedTriangles[i] = triangles[order[i]];
+        sortedCentroids[i] = centroids[order[i]];
+    }
+    std::copy(sortedTriangles.begin(), sortedTriangles.end(), triangles.begin() + first);
+    std::copy(sortedCentroids.begin(), sortedCentroids.end(), centroids.begin() + first);
+
+    buildNode(centroids, first, half);
+    unsigned int right = buildNode(centroids, first + half, count - half);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+namespace
+{
+    // slab test, the entry distance when the ray meets the box before `maxT`
+    bool hitBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::vec3 &origin,
+                const glm::vec3 &invDir, float maxT, float &entry)
+    {
+        float tNear = 0.0f, tFar = maxT;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float t0 = (boundsMin[axis] - origin[axis]) * invDir[axis];
+            float t1 = (boundsMax[axis] - origin[axis]) * invDir[axis];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            tNear = std::max(tNear, t0);
+            tFar = std::min(tFar, t1);
+            if (tNear > tFar)
+                return false;
+        }
+        entry = tNear;
+        return true;
+    }
+
+    // Moller-Trumbore, both faces count
+    bool hitTriangle(const TriangleBvh::Triangle &tri, const glm::vec3 &origin, const glm::vec3 &dir, float maxT,
+                     float &t, float &u, float &v)
+    {
+        const float EPSILON = 1e-7f;
+        glm::vec3 edge1 = tri.v1 - tri.v0, edge2 = tri.v2 - tri.v0;
+        glm::vec3 p = glm::cross(dir, edge2);
+        float det = glm::dot(edge1, p);
+        if (std::fabs(det) < EPSILON)
+            return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - tri.v0;
+        u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        v = glm::dot(dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = glm::dot(edge2, q) * invDet;
+        return t > EPSILON && t < maxT;
+    }
+}
+
+template <bool AnyHit>
+bool TriangleBvh::trace(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, Hit &hit) const
+{
+    if (nodes.empty())
+        return false;
+    // a zero component gives an infinite slab, which the min/max above handle
+    glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    bool found = false;
+    hit.t = maxT;
+
+    unsigned int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes[stack[--top]];
+        float entry;
+        if (!hitBox(node.boundsMin, node.boundsMax, origin, invDir, hit.t, entry))
+            continue;
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+            {
+                float t, u, v;
+                if (!hitTriangle(triangles[i], origin, dir, hit.t, t, u, v))
+                    continue;
+                hit = {t, u, v, i};
+                found = true;
+                if (AnyHit)
+                    return true;
+            }
+            continue;
+        }
+        // nearer child on top of the stack
+        unsigned int left = (unsigned int)(&node - &nodes[0]) + 1, right = node.first;
+        float leftEntry = FLT_MAX, rightEntry = FLT_MAX;
+        bool hitLeft = hitBox(nodes[left].boundsMin, nodes[left].boundsMax, origin, invDir, hit.t, leftEntry);
+        bool hitRight = hitBox(nodes[right].boundsMin, nodes[right].boundsMax, origin, invDir, hit.t, rightEntry);
+        if (hitLeft && hitRight)
+        {
+            if (leftEntry < rightEntry)
+                std::swap(left, right);
+            stack[top++] = left;
+            stack[top++] = right;
+        }
+        else if (hitLeft)
+            stack[top++] = left;
+        else if (hitRight)
+            stack[top++] = right;
+    }
+    return found;
+}
+
+bool TriangleBvh::intersect(const glm::vec3 &origin, const glm::vec3 &dir, float maxT, Hit &hit) const
+{
+    return trace<false>(origin, dir, maxT, hit);
+}
+
+bool TriangleBvh::occluded(const glm::vec3 &origin, const glm::vec3 &dir, float maxT) const
+{
+    Hit hit;
+    return trace<true>(origin, dir, maxT, hit);
+}
@@ -0,0 +1,144 @@
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void clipMatrix(const VecMat::mat4 &projection, const VecMat::mat4 &view, float out[4][4])
+{
+    // spelled out because VecMat's operator* multiplies the other way round
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+        {
+            out[c][r] = 0.0f;
+            for (int k = 0; k < 4; k++)
+                out[c][r] += projection.mat[k][r] * view.mat[c][k];
+        }
+}
+
+Frustum::Frustum()
+{
+    // everything is inside until extract() is called
+    std::fill(nx, nx + 8, 0.0f);
+    std::fill(ny, ny + 8, 0.0f);
+    std::fill(nz, nz + 8, 0.0f);
+    std::fill(d, d + 8, 1.0f);
+}
+
+void Frustum::extract(const VecMat::mat4 &projection, const VecMat::mat4 &view,
+                      float left, float right, float bottom, float top)
+{
+    float clip[4][4];
+    clipMatrix(projection, view, clip);
+
+    // plane i keeps ndc[i / 2] on the inside of bound[i]: row (i / 2) -/+ bound * row 3,
+    // which is row 3 +/- row (i / 2) for the full [-1, 1] range
+    const float bound[6] = {left, right, bottom, top, -1.0f, 1.0f};
+    for (int i = 0; i < 6; i++)
+    {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        float a = sign * (clip[0][row] - bound[i] * clip[0][3]);
+        float b = sign * (clip[1][row] - bound[i] * clip[1][3]);
+        float c = sign * (clip[2][row] - bound[i] * clip[2][3]);
+        float w = sign * (clip[3][row] - bound[i] * clip[3][3]);
+        float length = std::sqrt(a * a + b * b + c * c);
+        if (length > 0.0f)
+        {
+            a /= length;
+            b /= length;
+            c /= length;
+            w /= length;
+        }
+        nx[i] = a;
+        ny[i] = b;
+        nz[i] = c;
+        d[i] = w;
+    }
+    for (int i = 6; i < 8; i++)
+    {
+        nx[i] = nx[4];
+        ny[i] = ny[4];
+        nz[i] = nz[4];
+        d[i] = d[4];
+    }
+}
+
+bool Frustum::intersectsBox(const glm::vec3 &center, const glm::vec3 &extent) const
+{
+    // the box is outside a plane when even its corner furthest along the normal is behind it:
+    // dot(n, center) + dot(|n|, extent) + d < 0
+#ifdef FRUSTUM_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    for (int i = 0; i < 8; i += 4)
+    {
+        __m128 px = _mm_load_ps(nx + i), py = _mm_load_ps(ny + i), pz = _mm_load_ps(nz + i);
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+                                     _mm_add_ps(_mm_mul_ps(pz, cz), _mm_load_ps(d + i)));
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())))
+            return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < 6; i++)
+    {
+        float distance = nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i];
+        float radius = std::fabs(nx[i]) * extent.x + std::fabs(ny[i]) * extent.y + std::fabs(nz[i]) * extent.z;
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+#endif
+}
+
+bool Frustum::intersectsSphere(const glm::vec3 &center, float radius) const
+{
+    for (int i = 0; i < 6; i++)
+        if (nx[i] * center.x + ny[i] * center.y + nz[i] * center.z + d[i] < -radius)
+            return false;
+    return true;
+}
+
+void transformBox(const VecMat::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                  glm::vec3 &center, glm::vec3 &extent)
+{
+    // Arvo: the new half extent is the absolute upper 3x3 applied to the old one
+    glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+    for (int r = 0; r < 3; r++)
+    {
+        center[r] = transform.mat[3][r];
+        extent[r] = 0.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            center[r] += transform.mat[c][r] * localCenter[c];
+            extent[r] += std::fabs(transform.mat[c][r]) * localExtent[c];
+        }
+    }
+}
+
+void transformSphere(const VecMat::mat4 &transform, const glm::vec3 &center, float radius,
+                     glm::vec3 &worldCenter, float &worldRadius)
+{
+    float axisScale = 0.0f;
+    for (int r = 0; r < 3; r++)
+    {
+        worldCenter[r] = transform.mat[3][r];
+        for (int c = 0; c < 3; c++)
+            worldCenter[r] += transform.mat[c][r] * center[c];
+    }
+    for (int c = 0; c < 3; c++)
+        axisScale = std::max(axisScale, std::sqrt(transform.mat[c][0] * transform.mat[c][0] +
+                                                  transform.mat[c][1] * transform.mat[c][1] +
+                                                  transform.mat[c][2] * transform.mat[c][2]));
+    worldRadius = radius * axisScale;
+}
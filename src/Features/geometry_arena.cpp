@@ -0,0 +1,261 @@
+#include "geometry_arena.hpp"
+#include "glcaps.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(unsigned int capacity) : total(0), freeCount(0)
+{
+    grow(capacity);
+}
+
+unsigned int RangeAllocator::allocate(unsigned int count)
+{
+    if (count == 0)
+        return 0;
+    for (auto it = blocks.begin(); it != blocks.end(); ++it)
+    {
+        if (it->second < count)
+            continue;
+        unsigned int offset = it->first;
+        unsigned int remaining = it->second - count;
+        blocks.erase(it);
+        if (remaining > 0)
+            blocks[offset + count] = remaining;
+        freeCount -= count;
+        return offset;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::free(unsigned int offset, unsigned int count)
+{
+    if (count == 0)
+        return;
+    freeCount += count;
+    auto next = blocks.lower_bound(offset);
+    // merge with the following block
+    if (next != blocks.end() && offset + count == next->first)
+    {
+        count += next->second;
+        next = blocks.erase(next);
+    }
+    // merge with the preceding block
+    if (next != blocks.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += count;
+            return;
+        }
+    }
+    blocks[offset] = count;
+}
+
+void RangeAllocator::grow(unsigned int newCapacity)
+{
+    if (newCapacity <= total)
+        return;
+    unsigned int added = newCapacity - total;
+    unsigned int offset = total;
+    total = newCapacity;
+    free(offset, added);
+}
+
+unsigned int RangeAllocator::largestFreeBlock() const
+{
+    unsigned int largest = 0;
+    for (const auto &block : blocks)
+        largest = std::max(largest, block.second);
+    return largest;
+}
+
+GeometryArena::GeometryArena(GLsizei vertexStride, const std::vector<VertexAttribute> &attributes,
+                             unsigned int vertexCapacity, unsigned int indexCapacity)
+    : stride(vertexStride), attributes(attributes), vertexSpace(vertexCapacity), indexSpace(indexCapacity),
+      VAO(0), VBO(0), EBO(0)
+{
+    createBuffers();
+}
+
+void GeometryArena::createBuffers()
+{
+    VBO = createBuffer(size_t(vertexSpace.capacity()) * stride);
+    EBO = createBuffer(size_t(indexSpace.capacity()) * sizeof(unsigned int));
+
+    if (glCaps.directStateAccess)
+    {
+        // every attribute reads from vertex buffer binding 0, which is all a resize has to repoint
+        glCreateVertexArrays(1, &VAO);
+        for (const VertexAttribute &attribute : attributes)
+        {
+            glEnableVertexArrayAttrib(VAO, attribute.location);
+            glVertexArrayAttribFormat(VAO, attribute.location, attribute.components, attribute.type, GL_FALSE,
+                                      (GLuint)attribute.offset);
+            glVertexArrayAttribBinding(VAO, attribute.location, 0);
+        }
+        attachVertexBuffer();
+        attachElementBuffer();
+        return;
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glState.bindVertexArray(VAO);
+    for (const VertexAttribute &attribute : attributes)
+        glEnableVertexAttribArray(attribute.location);
+    attachVertexBuffer();
+    attachElementBuffer();
+}
+
+// immutable storage when DSA is available, the sub data uploads still need GL_DYNAMIC_STORAGE_BIT
+GLuint GeometryArena::createBuffer(size_t bytes)
+{
+    GLuint buffer;
+    if (glCaps.directStateAccess)
+    {
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, bytes, NULL, GL_DYNAMIC_STORAGE_BIT);
+        return buffer;
+    }
+    glGenBuffers(1, &buffer);
+    glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+    return buffer;
+}
+
+// the attribute pointers capture the vertex buffer, so they are set again whenever it changes
+void GeometryArena::attachVertexBuffer()
+{
+    if (glCaps.directStateAccess)
+    {
+        glVertexArrayVertexBuffer(VAO, 0, VBO, 0, stride);
+        return;
+    }
+    glState.bindVertexArray(VAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    for (const VertexAttribute &attribute : attributes)
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, GL_FALSE, stride, (void *)attribute.offset);
+    glState.bindVertexArray(0);
+}
+
+void GeometryArena::attachElementBuffer()
+{
+    if (glCaps.directStateAccess)
+    {
+        glVertexArrayElementBuffer(VAO, EBO);
+        return;
+    }
+    glState.bindVertexArray(VAO);
+    glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glState.bindVertexArray(0);
+}
+
+// upload through the copy target so the element binding of whatever VAO is bound stays untouched
+void GeometryArena::upload(GLuint buffer, size_t offset, size_t bytes, const void *data)
+{
+    if (glCaps.directStateAccess)
+    {
+        glNamedBufferSubData(buffer, offset, bytes, data);
+        return;
+    }
+    glState.bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+}
+
+// copies a buffer into a bigger one on the GPU and returns the new name
+GLuint GeometryArena::resize(GLuint buffer, size_t oldBytes, size_t newBytes)
+{
+    GLuint bigger = createBuffer(newBytes);
+    if (glCaps.directStateAccess)
+        glCopyNamedBufferSubData(buffer, bigger, 0, 0, oldBytes);
+    else
+    {
+        glState.bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+    }
+    glDeleteBuffers(1, &buffer);
+    glState.bufferDeleted(buffer);
+    return bigger;
+}
+
+GeometryRange GeometryArena::allocate(const void *vertices, unsigned int vertexCount,
+                                      const unsigned int *indices, unsigned int indexCount)
+{
+    GeometryRange range;
+    range.vertexCount = vertexCount;
+    range.indexCount = indexCount;
+
+    range.baseVertex = vertexSpace.allocate(vertexCount);
+    if (range.baseVertex == RangeAllocator::INVALID)
+    {
+        unsigned int oldCapacity = vertexSpace.capacity();
+        vertexSpace.grow(std::max(oldCapacity * 2, oldCapacity + vertexCount));
+        VBO = resize(VBO, size_t(oldCapacity) * stride, size_t(vertexSpace.capacity()) * stride);
+        attachVertexBuffer();
+        range.baseVertex = vertexSpace.allocate(vertexCount);
+    }
+
+    range.firstIndex = indexSpace.allocate(indexCount);
+    if (range.firstIndex == RangeAllocator::INVALID)
+    {
+        unsigned int oldCapacity = indexSpace.capacity();
+        indexSpace.grow(std::max(oldCapacity * 2, oldCapacity + indexCount));
+        EBO = resize(EBO, size_t(oldCapacity) * sizeof(unsigned int), size_t(indexSpace.capacity()) * sizeof(unsigned int));
+        attachElementBuffer();
+        range.firstIndex = indexSpace.allocate(indexCount);
+    }
+
+    upload(VBO, size_t(range.baseVertex) * stride, size_t(vertexCount) * stride, vertices);
+    upload(EBO, size_t(range.firstIndex) * sizeof(unsigned int), size_t(indexCount) * sizeof(unsigned int), indices);
+    return range;
+}
+
+void GeometryArena::free(const GeometryRange &range)
+{
+    vertexSpace.free(range.baseVertex, range.vertexCount);
+    indexSpace.free(range.firstIndex, range.indexCount);
+}
+
+void GeometryArena::draw(const GeometryRange &range, unsigned int indexOffset, unsigned int count, unsigned int instances) const
+{
+    void *first = (void *)(size_t(range.firstIndex + indexOffset) * sizeof(unsigned int));
+    if (instances == 1)
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT, first, range.baseVertex);
+    else
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT, first, instances, range.baseVertex);
+}
+
+DrawElementsIndirectCommand GeometryArena::command(const GeometryRange &range, unsigned int indexOffset, unsigned int count,
+                                                   unsigned int instances, unsigned int baseInstance)
+{
+    DrawElementsIndirectCommand command;
+    command.count = count;
+    command.instanceCount = instances;
+    command.firstIndex = range.firstIndex + indexOffset;
+    command.baseVertex = GLint(range.baseVertex);
+    command.baseInstance = baseInstance;
+    return command;
+}
+
+GeometryArena::Stats GeometryArena::stats() const
+{
+    Stats s;
+    s.vertexCapacity = vertexSpace.capacity();
+    s.vertexUsed = vertexSpace.used();
+    s.indexCapacity = indexSpace.capacity();
+    s.indexUsed = indexSpace.used();
+    s.freeBlocks = vertexSpace.freeBlocks() + indexSpace.freeBlocks();
+
+    double capacityBytes = double(s.vertexCapacity) * stride + double(s.indexCapacity) * sizeof(unsigned int);
+    double usedBytes = double(s.vertexUsed) * stride + double(s.indexUsed) * sizeof(unsigned int);
+    s.occupancy = capacityBytes > 0 ? float(usedBytes / capacityBytes) : 0.0f;
+
+    auto fragmentation = [](const RangeAllocator &space) {
+        unsigned int freeSpace = space.capacity() - space.used();
+        return freeSpace > 0 ? 1.0f - float(space.largestFreeBlock()) / float(freeSpace) : 0.0f;
+    };
+    s.fragmentation = std::max(fragmentation(vertexSpace), fragmentation(indexSpace));
+    return s;
+}
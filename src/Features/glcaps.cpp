@@ -0,0 +1,134 @@
+#include "glcaps.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_VERSION_4_3
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glcaps_glMultiDrawElementsIndirect = nullptr;
+PFNGLDISPATCHCOMPUTEPROC glcaps_glDispatchCompute = nullptr;
+PFNGLMEMORYBARRIERPROC glcaps_glMemoryBarrier = nullptr;
+PFNGLCLEARBUFFERDATAPROC glcaps_glClearBufferData = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_6
+PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC glcaps_glMultiDrawElementsIndirectCount = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_4
+PFNGLBUFFERSTORAGEPROC glcaps_glBufferStorage = nullptr;
+#endif
+
+#ifndef GL_VERSION_4_5
+PFNGLCREATEBUFFERSPROC glcaps_glCreateBuffers = nullptr;
+PFNGLNAMEDBUFFERSTORAGEPROC glcaps_glNamedBufferStorage = nullptr;
+PFNGLNAMEDBUFFERSUBDATAPROC glcaps_glNamedBufferSubData = nullptr;
+PFNGLCOPYNAMEDBUFFERSUBDATAPROC glcaps_glCopyNamedBufferSubData = nullptr;
+PFNGLCREATEVERTEXARRAYSPROC glcaps_glCreateVertexArrays = nullptr;
+PFNGLVERTEXARRAYVERTEXBUFFERPROC glcaps_glVertexArrayVertexBuffer = nullptr;
+PFNGLVERTEXARRAYELEMENTBUFFERPROC glcaps_glVertexArrayElementBuffer = nullptr;
+PFNGLENABLEVERTEXARRAYATTRIBPROC glcaps_glEnableVertexArrayAttrib = nullptr;
+PFNGLVERTEXARRAYATTRIBFORMATPROC glcaps_glVertexArrayAttribFormat = nullptr;
+PFNGLVERTEXARRAYATTRIBBINDINGPROC glcaps_glVertexArrayAttribBinding = nullptr;
+PFNGLCREATETEXTURESPROC glcaps_glCreateTextures = nullptr;
+PFNGLTEXTURESTORAGE2DPROC glcaps_glTextureStorage2D = nullptr;
+PFNGLTEXTURESUBIMAGE2DPROC glcaps_glTextureSubImage2D = nullptr;
+PFNGLTEXTURESUBIMAGE3DPROC glcaps_glTextureSubImage3D = nullptr;
+PFNGLTEXTUREPARAMETERIPROC glcaps_glTextureParameteri = nullptr;
+PFNGLGENERATETEXTUREMIPMAPPROC glcaps_glGenerateTextureMipmap = nullptr;
+PFNGLBINDTEXTUREUNITPROC glcaps_glBindTextureUnit = nullptr;
+#endif
+
+GlCapabilities glCaps;
+
+static bool hasExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+        if (std::strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+            return true;
+    return false;
+}
+
+int mipLevels(int width, int height)
+{
+    int levels = 1;
+    for (int size = width > height ? width : height; size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+// loads `name` into the function pointer, false when the driver does not export it
+template <typename Function>
+static bool loadFunction(GLADloadproc load, Function &function, const char *name)
+{
+    function = (Function)load(name);
+    return function != nullptr;
+}
+
+void loadGlCapabilities(GLADloadproc load)
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &glCaps.major);
+    glGetIntegerv(GL_MINOR_VERSION, &glCaps.minor);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &glCaps.maxTextureBufferSize);
+    int version = glCaps.major * 10 + glCaps.minor;
+
+#ifndef GL_VERSION_4_3
+    glcaps_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+#endif
+    bool computeLoaded = true;
+#ifndef GL_VERSION_4_3
+    computeLoaded = loadFunction(load, glcaps_glDispatchCompute, "glDispatchCompute") &&
+                    loadFunction(load, glcaps_glMemoryBarrier, "glMemoryBarrier") &&
+                    loadFunction(load, glcaps_glClearBufferData, "glClearBufferData");
+#endif
+    bool countLoaded = true;
+#ifndef GL_VERSION_4_6
+    // the extension exports it with its suffix, 4.6 drivers under both names
+    countLoaded = loadFunction(load, glcaps_glMultiDrawElementsIndirectCount, "glMultiDrawElementsIndirectCount") ||
+                  loadFunction(load, glcaps_glMultiDrawElementsIndirectCount, "glMultiDrawElementsIndirectCountARB");
+#endif
+    bool storageLoaded = true;
+#ifndef GL_VERSION_4_4
+    storageLoaded = loadFunction(load, glcaps_glBufferStorage, "glBufferStorage");
+#endif
+    bool dsaLoaded = true;
+#ifndef GL_VERSION_4_5
+    dsaLoaded = loadFunction(load, glcaps_glCreateBuffers, "glCreateBuffers") &&
+                loadFunction(load, glcaps_glNamedBufferStorage, "glNamedBufferStorage") &&
+                loadFunction(load, glcaps_glNamedBufferSubData, "glNamedBufferSubData") &&
+                loadFunction(load, glcaps_glCopyNamedBufferSubData, "glCopyNamedBufferSubData") &&
+                loadFunction(load, glcaps_glCreateVertexArrays, "glCreateVertexArrays") &&
+                loadFunction(load, glcaps_glVertexArrayVertexBuffer, "glVertexArrayVertexBuffer") &&
+                loadFunction(load, glcaps_glVertexArrayElementBuffer, "glVertexArrayElementBuffer") &&
+                loadFunction(load, glcaps_glEnableVertexArrayAttrib, "glEnableVertexArrayAttrib") &&
+                loadFunction(load, glcaps_glVertexArrayAttribFormat, "glVertexArrayAttribFormat") &&
+                loadFunction(load, glcaps_glVertexArrayAttribBinding, "glVertexArrayAttribBinding") &&
+                loadFunction(load, glcaps_glCreateTextures, "glCreateTextures") &&
+                loadFunction(load, glcaps_glTextureStorage2D, "glTextureStorage2D") &&
+                loadFunction(load, glcaps_glTextureSubImage2D, "glTextureSubImage2D") &&
+                loadFunction(load, glcaps_glTextureSubImage3D, "glTextureSubImage3D") &&
+                loadFunction(load, glcaps_glTextureParameteri, "glTextureParameteri") &&
+                loadFunction(load, glcaps_glGenerateTextureMipmap, "glGenerateTextureMipmap") &&
+                loadFunction(load, glcaps_glBindTextureUnit, "glBindTextureUnit");
+#endif
+
+    glCaps.baseInstance = version >= 42 || hasExtension("GL_ARB_base_instance");
+    glCaps.multiDrawIndirect = (version >= 43 || hasExtension("GL_ARB_multi_draw_indirect")) &&
+                               glCaps.baseInstance && glMultiDrawElementsIndirect != nullptr;
+    glCaps.conservativeQueries = version >= 43 || hasExtension("GL_ARB_ES3_compatibility");
+    glCaps.computeShaders = (version >= 43 || (hasExtension("GL_ARB_compute_shader") &&
+                                               hasExtension("GL_ARB_shader_storage_buffer_object"))) && computeLoaded;
+    glCaps.indirectCount = (version >= 46 || hasExtension("GL_ARB_indirect_parameters")) && countLoaded &&
+                           glCaps.multiDrawIndirect;
+    glCaps.bufferStorage = (version >= 44 || hasExtension("GL_ARB_buffer_storage")) && storageLoaded;
+    glCaps.directStateAccess = (version >= 45 || hasExtension("GL_ARB_direct_state_access")) && dsaLoaded;
+
+    std::cout << "OpenGL " << glCaps.major << "." << glCaps.minor
+              << ", multi-draw indirect: " << (glCaps.multiDrawIndirect ? "yes" : "no")
+              << ", conservative queries: " << (glCaps.conservativeQueries ? "yes" : "no")
+              << ", compute shaders: " << (glCaps.computeShaders ? "yes" : "no")
+              << ", indirect count: " << (glCaps.indirectCount ? "yes" : "no")
+              << ", buffer storage: " << (glCaps.bufferStorage ? "yes" : "no")
+              << ", direct state access: " << (glCaps.directStateAccess ? "yes" : "no") << std::endl;
+}
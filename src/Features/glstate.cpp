@@ -0,0 +1,214 @@
+#include "glstate.hpp"
+#include "glcaps.hpp"
+#include "stats.hpp"
+
+GlState glState;
+
+namespace
+{
+    int bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_COPY_READ_BUFFER: return 2;
+        case GL_COPY_WRITE_BUFFER: return 3;
+        case GL_UNIFORM_BUFFER: return 4;
+        case 0x8F3F: return 5;          // GL_DRAW_INDIRECT_BUFFER, not in the 3.3 headers
+        case GL_TEXTURE_BUFFER: return 6;
+        case 0x80EE: return 7;          // GL_PARAMETER_BUFFER (4.6)
+        case 0x90D2: return 8;          // GL_SHADER_STORAGE_BUFFER (4.3)
+        default: return -1;
+        }
+    }
+
+    int textureSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    int capabilitySlot(GLenum capability)
+    {
+        switch (capability)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_BLEND: return 1;
+        case GL_CULL_FACE: return 2;
+        default: return -1;
+        }
+    }
+}
+
+bool GlState::update(GLuint &cached, GLuint value)
+{
+    if (cached == value)
+    {
+        frameStats.stateCallsAvoided++;
+        return false;
+    }
+    cached = value;
+    frameStats.stateCallsIssued++;
+    return true;
+}
+
+void GlState::invalidate()
+{
+    program = vertexArray = UNKNOWN;
+    for (GLuint &buffer : buffers)
+        buffer = UNKNOWN;
+    unit = UNKNOWN;
+    for (auto &targets : textures)
+        for (GLuint &texture : targets)
+            texture = UNKNOWN;
+    depth = depthWrite = colorWrite = blendSource = blendDestination = UNKNOWN;
+    for (GLuint &capability : capabilities)
+        capability = UNKNOWN;
+}
+
+void GlState::useProgram(GLuint program)
+{
+    if (update(this->program, program))
+        glUseProgram(program);
+}
+
+void GlState::bindVertexArray(GLuint vertexArray)
+{
+    if (update(this->vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        // the element buffer binding is part of the vertex array
+        buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+    }
+}
+
+void GlState::bindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = bufferSlot(target);
+    if (slot < 0)
+    {
+        frameStats.stateCallsIssued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (update(buffers[slot], buffer))
+        glBindBuffer(target, buffer);
+}
+
+void GlState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, size_t bytes)
+{
+    frameStats.stateCallsIssued++;
+    glBindBufferRange(target, index, buffer, offset, bytes);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GlState::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    frameStats.stateCallsIssued++;
+    glBindBufferBase(target, index, buffer);
+    int slot = bufferSlot(target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GlState::activeTexture(unsigned int unit)
+{
+    if (update(this->unit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GlState::bindTexture(GLenum target, GLuint texture)
+{
+    int slot = textureSlot(target);
+    if (slot < 0 || unit >= TEXTURE_UNITS)
+    {
+        frameStats.stateCallsIssued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (update(textures[unit][slot], texture))
+        glBindTexture(target, texture);
+}
+
+void GlState::bindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+    int slot = textureSlot(target);
+    // already bound there: no need to switch units either
+    if (slot >= 0 && unit < TEXTURE_UNITS && textures[unit][slot] == texture)
+    {
+        frameStats.stateCallsAvoided++;
+        return;
+    }
+    // DSA binds straight to the unit without switching the active one
+    // (binding 0 that way would clear every target of the unit, so that still goes the old way)
+    if (glCaps.directStateAccess && slot >= 0 && unit < TEXTURE_UNITS && texture != 0)
+    {
+        textures[unit][slot] = texture;
+        frameStats.stateCallsIssued++;
+        glBindTextureUnit(unit, texture);
+        return;
+    }
+    activeTexture(unit);
+    bindTexture(target, texture);
+}
+
+void GlState::depthFunc(GLenum func)
+{
+    if (update(depth, func))
+        glDepthFunc(func);
+}
+
+void GlState::depthMask(bool write)
+{
+    if (update(depthWrite, write ? GL_TRUE : GL_FALSE))
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GlState::colorMask(bool write)
+{
+    GLboolean value = write ? GL_TRUE : GL_FALSE;
+    if (update(colorWrite, value))
+        glColorMask(value, value, value, value);
+}
+
+void GlState::setEnabled(GLenum capability, bool enabled)
+{
+    int slot = capabilitySlot(capability);
+    if (slot >= 0 && !update(capabilities[slot], enabled ? 1 : 0))
+        return;
+    if (slot < 0)
+        frameStats.stateCallsIssued++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GlState::blendFunc(GLenum source, GLenum destination)
+{
+    if (blendSource == source && blendDestination == destination)
+    {
+        frameStats.stateCallsAvoided++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    frameStats.stateCallsIssued++;
+    glBlendFunc(source, destination);
+}
+
+void GlState::bufferDeleted(GLuint buffer)
+{
+    for (GLuint &bound : buffers)
+        if (bound == buffer)
+            bound = 0;
+}
@@ -0,0 +1,254 @@
+#include "gpu_culling.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+namespace
+{
+    // shader storage binding points, as declared in cull.comp
+    const GLuint RECORDS_BINDING = 0, TRANSFORMS_BINDING = 1, OFFSETS_BINDING = 2, COUNTS_BINDING = 3,
+                 COMMANDS_BINDING = 4;
+
+    GLuint createBuffer(GLenum target, size_t bytes, const void *data, GLenum usage)
+    {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glState.bindBuffer(target, buffer);
+        glBufferData(target, bytes, data, usage);
+        return buffer;
+    }
+
+    void deleteBuffer(GLuint &buffer)
+    {
+        if (!buffer)
+            return;
+        glState.bufferDeleted(buffer);
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+}
+
+GpuCulling::~GpuCulling()
+{
+    for (GLuint *buffer : {&recordsBuffer, &transformsBuffer, &offsetsBuffer, &countsBuffer, &commandsBuffer})
+        deleteBuffer(*buffer);
+    delete program;
+}
+
+bool GpuCulling::init(const char *computePath)
+{
+    if (!glCaps.computeShaders || !glCaps.multiDrawIndirect)
+        return false;
+    program = new Shader(computePath);
+    return true;
+}
+
+unsigned int GpuCulling::addObject(const VecMat::mat4 &transform)
+{
+    transforms.push_back(transform);
+    unsigned int object = (unsigned int)transforms.size() - 1;
+    dirtyBegin = std::min(dirtyBegin, object);
+    dirtyEnd = object + 1;
+    return object;
+}
+
+void GpuCulling::setTransform(unsigned int object, const VecMat::mat4 &transform)
+{
+    if (std::memcmp(&transforms[object], &transform, sizeof(VecMat::mat4)) == 0)
+        return;
+    transforms[object] = transform;
+    if (dirtyBegin >= dirtyEnd)
+        dirtyBegin = object;
+    dirtyBegin = std::min(dirtyBegin, object);
+    dirtyEnd = std::max(dirtyEnd, object + 1);
+}
+
+void GpuCulling::addMesh(unsigned int object, const Mesh &mesh)
+{
+    if (mesh.lods.empty() || mesh.geometry.indexCount == 0)
+        return;
+    GpuDrawRecord record = {};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        record.boundsMin[axis] = mesh.boundsMin[axis];
+        record.boundsMax[axis] = mesh.boundsMax[axis];
+        record.sphereCenter[axis] = mesh.sphereCenter[axis];
+    }
+    record.sphereRadius = mesh.sphereRadius;
+    record.object = object;
+    record.levels = (GLuint)std::min<size_t>(mesh.lods.size(), LOD_MAX_LEVELS);
+    for (unsigned int lod = 0; lod < LOD_MAX_LEVELS; lod++)
+    {
+        // missing levels repeat the coarsest one
+        DrawElementsIndirectCommand command = mesh.indirectCommand(std::min(lod, record.levels - 1), 1, object);
+        record.firstIndex[lod] = command.firstIndex;
+        record.indexCount[lod] = command.count;
+        record.baseVertex = command.baseVertex;
+    }
+    records.push_back(record);
+    recordMeshes.push_back(&mesh);
+    recordsDirty = true;
+}
+
+// records are ordered by arena and material, each material gets a range of the command buffer as
+// long as its record count, so the compute shader can never write past it
+void GpuCulling::uploadRecords()
+{
+    std::vector<unsigned int> order(records.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        GLuint arrayA = recordMeshes[a]->vertexArena().vertexArray(), arrayB = recordMeshes[b]->vertexArena().vertexArray();
+        return arrayA != arrayB ? arrayA < arrayB : recordMeshes[a]->material.id < recordMeshes[b]->material.id;
+    });
+
+    std::vector<GpuDrawRecord> sorted;
+    std::vector<const Mesh *> sortedMeshes;
+    groups.clear();
+    offsets.clear();
+    for (unsigned int i : order)
+    {
+        const Mesh *mesh = recordMeshes[i];
+        if (groups.empty() || groups.back().material != mesh->material.id ||
+            &groups.back().mesh->vertexArena() != &mesh->vertexArena())
+        {
+            groups.push_back({mesh->material.id, mesh});
+            offsets.push_back((GLuint)sorted.size());
+        }
+        sorted.push_back(records[i]);
+        sorted.back().group = (GLuint)groups.size() - 1;
+        sortedMeshes.push_back(mesh);
+    }
+    records.swap(sorted);
+    recordMeshes.swap(sortedMeshes);
+
+    for (GLuint *buffer : {&recordsBuffer, &offsetsBuffer, &countsBuffer, &commandsBuffer})
+        deleteBuffer(*buffer);
+    recordsBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(GpuDrawRecord), records.data(),
+                                 GL_STATIC_DRAW);
+    offsetsBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, offsets.size() * sizeof(GLuint), offsets.data(),
+                                 GL_STATIC_DRAW);
+    countsBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, groups.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+    commandsBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(DrawElementsIndirectCommand),
+                                  nullptr, GL_DYNAMIC_DRAW);
+    recordsDirty = false;
+}
+
+void GpuCulling::uploadTransforms()
+{
+    if (transforms.size() > transformCapacity)
+    {
+        // grown: everything goes up again
+        deleteBuffer(transformsBuffer);
+        transformCapacity = std::max<size_t>(transforms.size(), transformCapacity * 2);
+        transformsBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, transformCapacity * sizeof(VecMat::mat4), nullptr,
+                                        GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = (unsigned int)transforms.size();
+    }
+    if (dirtyBegin >= dirtyEnd)
+        return;
+    glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, transformsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(dirtyBegin) * sizeof(VecMat::mat4),
+                    GLsizeiptr(dirtyEnd - dirtyBegin) * sizeof(VecMat::mat4), &transforms[dirtyBegin]);
+    frameStats.uploadBytes += (dirtyEnd - dirtyBegin) * sizeof(VecMat::mat4);
+    dirtyBegin = dirtyEnd = 0;
+}
+
+void GpuCulling::cull(const Frustum &frustum, const glm::vec3 &eye, float tanHalfFov,
+                      const float lodScreenSize[LOD_MAX_LEVELS - 1])
+{
+    if (records.empty())
+        return;
+    if (recordsDirty)
+        uploadRecords();
+    uploadTransforms();
+
+    timer.begin();
+    // empty counts, and without the GPU reading them empty commands for the tails of the ranges
+    glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, countsBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    if (!glCaps.indirectCount)
+    {
+        glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, commandsBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    }
+
+    program->Bind();
+    float planes[6][4];
+    for (int i = 0; i < 6; i++)
+        frustum.plane(i, planes[i]);
+    glUniform4fv(program->uniformLocation("planes"), 6, &planes[0][0]);
+    glUniform1ui(program->uniformLocation("recordCount"), (GLuint)records.size());
+    program->setVec3("eye", eye);
+    program->setFloat("tanHalfFov", tanHalfFov);
+    glUniform1fv(program->uniformLocation("lodScreenSize"), LOD_MAX_LEVELS - 1, lodScreenSize);
+
+    glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, RECORDS_BINDING, recordsBuffer);
+    glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORMS_BINDING, transformsBuffer);
+    glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, OFFSETS_BINDING, offsetsBuffer);
+    glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTS_BINDING, countsBuffer);
+    glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandsBuffer);
+    glDispatchCompute((GLuint)(records.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+    // the commands and counts are read as indirect draw parameters
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    timer.end();
+
+    frameStats.gpuCullRecords = (unsigned int)records.size();
+    frameStats.gpuCullMs = timer.milliseconds();
+}
+
+void GpuCulling::draw(const Shader &shader, RenderQueue &queue)
+{
+    if (records.empty())
+        return;
+    shader.Bind();
+    GLint shininessLocation = shader.uniformLocation("material.shininess");
+    glState.depthFunc(GL_LESS);
+    glState.depthMask(true);
+    frameStats.programChanges++;
+    glState.bindBuffer(GL_ARRAY_BUFFER, transformsBuffer);
+    glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsBuffer);
+    if (glCaps.indirectCount)
+        glState.bindBuffer(GL_PARAMETER_BUFFER, countsBuffer);
+    // no per draw light lists or probes here: with their arrays disabled the attributes send the
+    // shader to the clusters and the baked lights
+    RenderQueue::setInstanceDefaults();
+
+    GLuint vertexArray = 0;
+    for (size_t g = 0; g < groups.size(); g++)
+    {
+        const GeometryArena &arena = groups[g].mesh->vertexArena();
+        if (vertexArray != arena.vertexArray())
+        {
+            vertexArray = arena.vertexArray();
+            queue.releaseInstanceArrays(vertexArray);
+            arena.bind();
+            frameStats.vertexArrayChanges++;
+            // the model matrices are the transforms buffer itself, a draw's base instance is its slot
+            for (GLuint column = 0; column < 4; column++)
+            {
+                GLuint location = INSTANCE_MATRIX_LOCATION + column;
+                glEnableVertexAttribArray(location);
+                glVertexAttribDivisor(location, 1);
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(VecMat::mat4),
+                                      (void *)(column * 4 * sizeof(float)));
+            }
+        }
+        GLsizei capacity = GLsizei((g + 1 < groups.size() ? offsets[g + 1] : records.size()) - offsets[g]);
+        const void *first = (const void *)(size_t(offsets[g]) * sizeof(DrawElementsIndirectCommand));
+        groups[g].mesh->bindMaterial(shininessLocation);
+        if (glCaps.indirectCount)
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, first, GLintptr(g * sizeof(GLuint)),
+                                             capacity, 0);
+        else
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, first, capacity, 0);
+        frameStats.drawCalls++;
+        frameStats.materialChanges++;
+    }
+}
@@ -0,0 +1,41 @@
+#include "gpu_timer.hpp"
+
+// reads every finished query, oldest first so `last` ends up with the newest result
+void GpuTimer::collect()
+{
+    for (unsigned int i = 1; i <= QUERIES; i++)
+    {
+        unsigned int slot = (next + i) % QUERIES;
+        if (!pending[slot])
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+        last = nanoseconds / 1000000.0f;
+        pending[slot] = false;
+    }
+}
+
+void GpuTimer::begin()
+{
+    if (queries[0] == 0)
+        glGenQueries(QUERIES, queries);
+    collect();
+    // every query still in flight: skip this measurement rather than wait
+    running = !pending[next];
+    if (running)
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void GpuTimer::end()
+{
+    if (!running)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % QUERIES;
+    running = false;
+}
@@ -0,0 +1,256 @@
+#include "light_clusters.hpp"
+#include "glcaps.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// fraction of a light's brightest colour below which it no longer counts, under one step of an 8 bit channel
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+namespace
+{
+    const GLenum FORMATS[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+    const unsigned int UNITS[3] = {TEXTURE_CLUSTER_LIGHTS, TEXTURE_CLUSTER_GRID, TEXTURE_CLUSTER_INDICES};
+
+    float brightestOf(const PointLight &light)
+    {
+        float brightest = 0.0f;
+        for (const glm::vec3 &colour : {light.ambient, light.diffuse, light.specular})
+            brightest = std::max(brightest, std::max(colour.x, std::max(colour.y, colour.z)));
+        return brightest;
+    }
+}
+
+float LightClusters::influenceRadius(const PointLight &light)
+{
+    float brightest = brightestOf(light);
+    // solve constant + linear d + quadratic d^2 = brightest / cutoff for d
+    float k = brightest / LIGHT_CUTOFF - light.constant;
+    if (k <= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear + 4.0f * light.quadratic * k)) / (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return k / light.linear;
+    return INFINITY;
+}
+
+unsigned int LightClusters::lightCapacity()
+{
+    unsigned int fit = (unsigned int)glCaps.maxTextureBufferSize / LIGHT_TEXELS;
+    return fit < MAX_LIGHTS ? fit : MAX_LIGHTS;
+}
+
+void LightClusters::add(PointLight light)
+{
+    if (light.radius <= 0.0f)
+        light.radius = influenceRadius(light);
+    if (light.radius <= 0.0f)
+        return;
+    if (lights.size() < lightCapacity())
+        lights.push_back(light);
+    else
+        droppedLights++;
+}
+
+void LightClusters::create()
+{
+    for (int i = 0; i < 3; i++)
+        textures[i].create(FORMATS[i], UNITS[i]);
+}
+
+void LightClusters::computeBoxes(float scaleX, float scaleY, float nearPlane, float farPlane)
+{
+    boxes.resize(CLUSTERS);
+    for (unsigned int z = 0; z < SLICES; z++)
+    {
+        float d0 = nearPlane * std::pow(farPlane / nearPlane, float(z) / SLICES);
+        float d1 = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / SLICES);
+        for (unsigned int y = 0; y < TILES_Y; y++)
+            for (unsigned int x = 0; x < TILES_X; x++)
+            {
+                // the tile's edges in NDC, pushed out to the slice's near and far depth
+                float x0 = -1.0f + 2.0f * x / TILES_X, x1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+                float y0 = -1.0f + 2.0f * y / TILES_Y, y1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+                Box &box = boxes[x + TILES_X * (y + TILES_Y * z)];
+                box.min = glm::vec3(std::min(x0 * d0, x0 * d1) / scaleX, std::min(y0 * d0, y0 * d1) / scaleY, -d1);
+                box.max = glm::vec3(std::max(x1 * d0, x1 * d1) / scaleX, std::max(y1 * d0, y1 * d1) / scaleY, -d0);
+            }
+    }
+    boxesFor[0] = scaleX;
+    boxesFor[1] = scaleY;
+    boxesFor[2] = nearPlane;
+    boxesFor[3] = farPlane;
+}
+
+void LightClusters::build(const VecMat::mat4 &projection, const VecMat::mat4 &view, int width, int height,
+                          FrameUniforms &frame)
+{
+    if (!textures[0].created())
+        create();
+
+    // near and far back out of the depth terms of the projection
+    float scaleX = projection.mat[0][0], scaleY = projection.mat[1][1];
+    float nearPlane = projection.mat[3][2] / (projection.mat[2][2] - 1.0f);
+    float farPlane = projection.mat[3][2] / (projection.mat[2][2] + 1.0f);
+    if (boxes.empty() || boxesFor[0] != scaleX || boxesFor[1] != scaleY || boxesFor[2] != nearPlane ||
+        boxesFor[3] != farPlane)
+        computeBoxes(scaleX, scaleY, nearPlane, farPlane);
+    float logDepth = std::log(farPlane / nearPlane);
+
+    auto sliceOf = [&](float depth) {
+        int slice = (int)std::floor(std::log(depth / nearPlane) / logDepth * SLICES);
+        return std::min(std::max(slice, 0), (int)SLICES - 1);
+    };
+    auto tileOf = [](float ndc, unsigned int tiles) {
+        ndc = std::min(std::max(ndc, -1.0f), 1.0f);
+        int tile = (int)std::floor((ndc + 1.0f) * 0.5f * tiles);
+        return std::min(std::max(tile, 0), (int)tiles - 1);
+    };
+
+    // the cluster lists are one buffer texture too, pairs past its size are left out
+    size_t maxRefs = (size_t)glCaps.maxTextureBufferSize;
+    unsigned int droppedRefs = 0;
+    hitCluster.clear();
+    hitLight.clear();
+    for (unsigned int l = 0; l < lights.size(); l++)
+    {
+        const PointLight &light = lights[l];
+        glm::vec3 center;
+        for (int r = 0; r < 3; r++)
+            center[r] = view.mat[0][r] * light.position.x + view.mat[1][r] * light.position.y +
+                        view.mat[2][r] * light.position.z + view.mat[3][r];
+        float depth = -center.z, radius = light.radius;
+        if (depth + radius < nearPlane || depth - radius > farPlane)
+            continue;
+        float depthMin = std::max(nearPlane, depth - radius), depthMax = std::min(farPlane, depth + radius);
+
+        // screen bounds of the sphere's box over that depth range, conservatively
+        float left = center.x - radius, right = center.x + radius;
+        float bottom = center.y - radius, top = center.y + radius;
+        float ndcLeft = scaleX * left / (left < 0.0f ? depthMin : depthMax);
+        float ndcRight = scaleX * right / (right > 0.0f ? depthMin : depthMax);
+        float ndcBottom = scaleY * bottom / (bottom < 0.0f ? depthMin : depthMax);
+        float ndcTop = scaleY * top / (top > 0.0f ? depthMin : depthMax);
+        if (ndcRight < -1.0f || ndcLeft > 1.0f || ndcTop < -1.0f || ndcBottom > 1.0f)
+            continue;
+
+        int x0 = tileOf(ndcLeft, TILES_X), x1 = tileOf(ndcRight, TILES_X);
+        int y0 = tileOf(ndcBottom, TILES_Y), y1 = tileOf(ndcTop, TILES_Y);
+        int z0 = sliceOf(depthMin), z1 = sliceOf(depthMax);
+        for (int z = z0; z <= z1; z++)
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                {
+                    unsigned int cluster = x + TILES_X * (y + TILES_Y * z);
+                    const Box &box = boxes[cluster];
+                    glm::vec3 nearest = glm::clamp(center, box.min, box.max);
+                    glm::vec3 offset = nearest - center;
+                    if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > radius * radius)
+                        continue;
+                    if (hitCluster.size() == maxRefs)
+                    {
+                        droppedRefs++;
+                        continue;
+                    }
+                    hitCluster.push_back(cluster);
+                    hitLight.push_back((uint16_t)l);
+                }
+    }
+
+    // counting sort of the pairs by cluster: (offset, count) per cluster, then the lists
+    grid.assign(2 * CLUSTERS, 0);
+    for (uint32_t cluster : hitCluster)
+        grid[2 * cluster + 1]++;
+    uint32_t offset = 0, most = 0;
+    for (unsigned int cluster = 0; cluster < CLUSTERS; cluster++)
+    {
+        grid[2 * cluster] = offset;
+        offset += grid[2 * cluster + 1];
+        most = std::max(most, grid[2 * cluster + 1]);
+        grid[2 * cluster + 1] = 0;
+    }
+    indices.resize(hitCluster.size());
+    for (size_t i = 0; i < hitCluster.size(); i++)
+    {
+        uint32_t cluster = hitCluster[i];
+        indices[grid[2 * cluster] + grid[2 * cluster + 1]++] = hitLight[i];
+    }
+
+    texels.resize(LIGHT_TEXELS * lights.size());
+    brightest.resize(lights.size());
+    for (size_t l = 0; l < lights.size(); l++)
+    {
+        const PointLight &light = lights[l];
+        brightest[l] = brightestOf(light);
+        glm::vec4 *texel = &texels[LIGHT_TEXELS * l];
+        texel[0] = glm::vec4(light.position, light.radius);
+        texel[1] = glm::vec4(light.ambient, light.constant);
+        texel[2] = glm::vec4(light.diffuse, light.linear);
+        texel[3] = glm::vec4(light.specular, light.quadratic);
+        texel[4] = glm::vec4(float(light.shadow), light.shadowRange(), light.baked ? 1.0f : 0.0f, 0.0f);
+    }
+    textures[0].upload(texels.data(), texels.size() * sizeof(glm::vec4));
+    textures[1].upload(grid.data(), grid.size() * sizeof(uint32_t));
+    textures[2].upload(indices.data(), indices.size() * sizeof(uint16_t));
+
+    frame.clusterScale = glm::vec4(float(TILES_X) / width, float(TILES_Y) / height, SLICES / logDepth,
+                                   -float(SLICES) * std::log(nearPlane) / logDepth);
+    frame.clusterDims[0] = TILES_X;
+    frame.clusterDims[1] = TILES_Y;
+    frame.clusterDims[2] = SLICES;
+    frame.clusterDims[3] = (unsigned int)lights.size();
+
+    frameStats.lights = (unsigned int)lights.size();
+    frameStats.clusterLightRefs = (unsigned int)indices.size();
+    frameStats.clusterLightsMax = most;
+    frameStats.lightsDropped = droppedLights;
+    frameStats.clusterLightRefsDropped = droppedRefs;
+}
+
+void LightClusters::bind() const
+{
+    for (const BufferTexture &texture : textures)
+        texture.bind();
+}
+
+void LightClusters::select(const glm::vec3 &center, const glm::vec3 &extent, DrawLights &out, bool skipBaked) const
+{
+    float score[DrawLights::COUNT];
+    unsigned int count = 0;
+    for (unsigned int l = 0; l < brightest.size(); l++)
+    {
+        const PointLight &light = lights[l];
+        if (skipBaked && light.baked)
+            continue;
+        glm::vec3 nearest = glm::clamp(light.position, center - extent, center + extent);
+        glm::vec3 offset = nearest - light.position;
+        float distanceSquared = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+        if (distanceSquared > light.radius * light.radius)
+            continue;
+        float distance = std::sqrt(distanceSquared);
+        float value = brightest[l] / (light.constant + light.linear * distance + light.quadratic * distanceSquared);
+
+        // insertion into the short list, brightest first
+        unsigned int slot = count < DrawLights::COUNT ? count++ : DrawLights::COUNT;
+        while (slot > 0 && score[slot - 1] < value)
+        {
+            if (slot < DrawLights::COUNT)
+            {
+                score[slot] = score[slot - 1];
+                out.index[slot] = out.index[slot - 1];
+            }
+            slot--;
+        }
+        if (slot < DrawLights::COUNT)
+        {
+            score[slot] = value;
+            out.index[slot] = (uint16_t)l;
+        }
+    }
+    for (unsigned int slot = count; slot < DrawLights::COUNT; slot++)
+        out.index[slot] = DrawLights::END;
+    frameStats.drawLightLists++;
+    frameStats.drawLightRefs += count;
+}
@@ -0,0 +1,292 @@
+#include "lightmap.hpp"
+#include "glstate.hpp"
+#include "material.hpp"
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+    const char LIGHTMAP_MAGIC[4] = {'L', 'M', 'P', '1'};
+
+    // the file is a fixed header, the size of every mesh's lightmap, then their texels in turn
+    struct LightmapHeader
+    {
+        char magic[4];
+        uint32_t meshes;
+        uint32_t signature;
+    };
+
+    // a group of triangles sharing one projection
+    struct Chart
+    {
+        int axis;                   // projected along this axis
+        glm::vec2 min, max;         // bounds of the projection, world units
+        unsigned int width, height; // texels, padding included
+        unsigned int x, y;          // corner in the lightmap
+    };
+
+    glm::vec2 project(const glm::vec3 &p, int axis)
+    {
+        return axis == 0 ? glm::vec2(p.z, p.y) : axis == 1 ? glm::vec2(p.x, p.z) : glm::vec2(p.x, p.y);
+    }
+
+    unsigned int findRoot(std::vector<unsigned int> &parent, unsigned int i)
+    {
+        while (parent[i] != i)
+            i = parent[i] = parent[parent[i]];
+        return i;
+    }
+
+    // shelf packing in the given order, false when the charts don't fit size x size
+    bool pack(std::vector<Chart> &charts, const std::vector<unsigned int> &order, unsigned int size)
+    {
+        unsigned int x = 0, y = 0, shelf = 0;
+        for (unsigned int index : order)
+        {
+            Chart &chart = charts[index];
+            if (chart.width > size)
+                return false;
+            if (x + chart.width > size)
+            {
+                y += shelf;
+                x = 0;
+                shelf = 0;
+            }
+            if (y + chart.height > size)
+                return false;
+            chart.x = x;
+            chart.y = y;
+            x += chart.width;
+            shelf = std::max(shelf, chart.height);
+        }
+        return true;
+    }
+}
+
+unsigned int unwrapLightmap(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices,
+                            std::vector<glm::vec2> &lightmapCoords)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return 0;
+
+    // triangles meeting at a normal or texture seam are still neighbours, so edges go by position
+    std::vector<float> packed;
+    std::vector<unsigned int> position = weldPositions(&vertices[0].Position.x, vertices.size(), sizeof(Vertex), packed);
+
+    // the side each triangle faces most: +x, -x, +y, -y, +z, -z
+    std::vector<int> facing(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3 &p0 = vertices[indices[3 * t]].Position;
+        glm::vec3 n = glm::cross(vertices[indices[3 * t + 1]].Position - p0, vertices[indices[3 * t + 2]].Position - p0);
+        glm::vec3 a = glm::abs(n);
+        int axis = a.x >= a.y && a.x >= a.z ? 0 : a.y >= a.z ? 1 : 2;
+        facing[t] = 2 * axis + (n[axis] < 0.0f ? 1 : 0);
+    }
+
+    // triangles facing the same side across an edge end up in one chart
+    std::vector<unsigned int> parent(triangleCount);
+    std::iota(parent.begin(), parent.end(), 0u);
+    std::unordered_map<uint64_t, unsigned int> edges;
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = position[indices[3 * t + e]], b = position[indices[3 * t + (e + 1) % 3]];
+            if (a == b)
+                continue;
+            uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+            auto found = edges.emplace(key, (unsigned int)t);
+            if (!found.second && facing[found.first->second] == facing[t])
+            {
+                unsigned int rootA = findRoot(parent, found.first->second), rootB = findRoot(parent, (unsigned int)t);
+                parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+            }
+        }
+
+    std::vector<Chart> charts;
+    std::vector<unsigned int> chartOf(triangleCount);
+    std::vector<int> chartOfRoot(triangleCount, -1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int root = findRoot(parent, (unsigned int)t);
+        if (chartOfRoot[root] < 0)
+        {
+            chartOfRoot[root] = (int)charts.size();
+            Chart chart;
+            chart.axis = facing[t] / 2;
+            chart.min = glm::vec2(FLT_MAX);
+            chart.max = glm::vec2(-FLT_MAX);
+            charts.push_back(chart);
+        }
+        Chart &chart = charts[chartOfRoot[root]];
+        chartOf[t] = chartOfRoot[root];
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec2 p = project(vertices[indices[3 * t + k]].Position, chart.axis);
+            chart.min = glm::min(chart.min, p);
+            chart.max = glm::max(chart.max, p);
+        }
+    }
+
+    // the smallest power of two square the charts fit in, at a lower density when none does
+    float density = LIGHTMAP_TEXELS_PER_UNIT;
+    unsigned int size = 0;
+    std::vector<unsigned int> order(charts.size());
+    for (;; density *= 0.5f)
+    {
+        if (density < LIGHTMAP_TEXELS_PER_UNIT / 64.0f)
+            return 0;
+        double area = 0.0;
+        for (Chart &chart : charts)
+        {
+            chart.width = (unsigned int)std::ceil((chart.max.x - chart.min.x) * density) + 1 + 2 * LIGHTMAP_PADDING;
+            chart.height = (unsigned int)std::ceil((chart.max.y - chart.min.y) * density) + 1 + 2 * LIGHTMAP_PADDING;
+            area += double(chart.width) * chart.height;
+        }
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](unsigned int a, unsigned int b) { return charts[a].height > charts[b].height; });
+        unsigned int tried = 16;
+        while (double(tried) * tried < area && tried < LIGHTMAP_MAX_SIZE)
+            tried *= 2;
+        for (; tried <= LIGHTMAP_MAX_SIZE && size == 0; tried *= 2)
+            if (pack(charts, order, tried))
+                size = tried;
+        if (size)
+            break;
+    }
+
+    // one vertex per (vertex, chart) pair
+    std::vector<Vertex> split;
+    split.reserve(vertices.size());
+    lightmapCoords.clear();
+    lightmapCoords.reserve(vertices.size());
+    std::unordered_map<uint64_t, unsigned int> copies;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const Chart &chart = charts[chartOf[t]];
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int &index = indices[3 * t + k];
+            auto found = copies.emplace((uint64_t(index) << 32) | chartOf[t], (unsigned int)split.size());
+            if (found.second)
+            {
+                const Vertex &vertex = vertices[index];
+                glm::vec2 texel = glm::vec2(float(chart.x + LIGHTMAP_PADDING), float(chart.y + LIGHTMAP_PADDING)) +
+                                  (project(vertex.Position, chart.axis) - chart.min) * density + glm::vec2(0.5f);
+                split.push_back(vertex);
+                lightmapCoords.push_back(texel / float(size));
+            }
+            index = found.first->second;
+        }
+    }
+    vertices.swap(split);
+    return size;
+}
+
+void LightmapSet::create(const std::vector<unsigned int> &meshSizes, uint32_t signature)
+{
+    sizes = meshSizes;
+    offsets.resize(sizes.size());
+    size_t total = 0;
+    for (size_t mesh = 0; mesh < sizes.size(); mesh++)
+    {
+        offsets[mesh] = total;
+        total += size_t(sizes[mesh]) * sizes[mesh];
+    }
+    values.assign(total, glm::vec3(0.0f));
+    hash = signature;
+}
+
+bool LightmapSet::load(const std::string &path)
+{
+    clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    LightmapHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, LIGHTMAP_MAGIC, sizeof(LIGHTMAP_MAGIC)) != 0)
+    {
+        std::cout << "ERROR::LIGHTMAP:: " << path << " is not a lightmap set" << std::endl;
+        return false;
+    }
+    // the counts come from the file, so they are checked against its length before anything is
+    // allocated for them
+    file.seekg(0, std::ios::end);
+    uint64_t left = uint64_t(file.tellg()) - sizeof(header);
+    file.seekg(sizeof(header));
+    std::vector<unsigned int> meshSizes;
+    if (uint64_t(header.meshes) * sizeof(uint32_t) <= left)
+    {
+        meshSizes.resize(header.meshes);
+        file.read(reinterpret_cast<char *>(meshSizes.data()), meshSizes.size() * sizeof(uint32_t));
+        left -= meshSizes.size() * sizeof(uint32_t);
+    }
+    uint64_t texels = 0;
+    for (unsigned int size : meshSizes)
+        texels += uint64_t(size) * size;
+    if (meshSizes.size() != header.meshes || !file || texels * sizeof(glm::vec3) > left ||
+        std::any_of(meshSizes.begin(), meshSizes.end(), [](unsigned int size) { return size > LIGHTMAP_MAX_SIZE; }))
+    {
+        std::cout << "ERROR::LIGHTMAP:: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    create(meshSizes, header.signature);
+    if (!file.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(glm::vec3)))
+    {
+        std::cout << "ERROR::LIGHTMAP:: " << path << " is truncated" << std::endl;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool LightmapSet::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    LightmapHeader header;
+    std::memcpy(header.magic, LIGHTMAP_MAGIC, sizeof(LIGHTMAP_MAGIC));
+    header.meshes = (uint32_t)sizes.size();
+    header.signature = hash;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(sizes.data()), sizes.size() * sizeof(uint32_t));
+    file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(glm::vec3));
+    return bool(file);
+}
+
+GLuint LightmapSet::upload(unsigned int mesh) const
+{
+    if (sizes[mesh] == 0)
+        return 0;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glState.activeTexture(MATERIAL_LIGHTMAP);
+    glState.bindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, sizes[mesh], sizes[mesh], 0, GL_RGB, GL_FLOAT, texels(mesh));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+uint32_t LightmapSet::signatureOf(const std::vector<unsigned int> &meshCounts)
+{
+    uint32_t h = 2166136261u;
+    for (unsigned int count : meshCounts)
+        for (int byte = 0; byte < 4; byte++)
+            h = (h ^ ((count >> (8 * byte)) & 0xffu)) * 16777619u;
+    return h;
+}
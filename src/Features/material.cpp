@@ -0,0 +1,65 @@
+#include "material.hpp"
+#include "glstate.hpp"
+
+#include <map>
+#include <tuple>
+
+namespace
+{
+    // what an empty lightmap slot reads: alpha 0 tells the shader there is no baked lighting
+    // (an unbound unit would read (0, 0, 0, 1), black but seemingly baked)
+    GLuint noLightmap()
+    {
+        static GLuint texture = 0;
+        if (!texture)
+        {
+            const unsigned char texel[4] = {0, 0, 0, 0};
+            glGenTextures(1, &texture);
+            glState.activeTexture(MATERIAL_LIGHTMAP);
+            glState.bindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        return texture;
+    }
+}
+
+void MaterialBinding::bind(GLint shininessLocation) const
+{
+    // unused units are cleared too, otherwise the previous material would show through
+    for (unsigned int slot = 0; slot < MATERIAL_SLOTS; slot++)
+        glState.bindTexture(slot, GL_TEXTURE_2D,
+                            slot == MATERIAL_LIGHTMAP && !textures[slot] ? noLightmap() : textures[slot]);
+    if (shininessLocation >= 0)
+        glUniform1f(shininessLocation, shininess);
+}
+
+int materialSlot(const std::string &type)
+{
+    if (type == "texture_diffuse")
+        return MATERIAL_DIFFUSE;
+    if (type == "texture_specular")
+        return MATERIAL_SPECULAR;
+    if (type == "texture_normal")
+        return MATERIAL_NORMAL;
+    if (type == "texture_height")
+        return MATERIAL_HEIGHT;
+    return -1;
+}
+
+unsigned int registerMaterial(const MaterialBinding &binding)
+{
+    typedef std::tuple<GLuint, GLuint, GLuint, GLuint, GLuint, float> MaterialKey;
+    static std::map<MaterialKey, unsigned int> materials;
+
+    MaterialKey key(binding.textures[MATERIAL_DIFFUSE], binding.textures[MATERIAL_SPECULAR],
+                    binding.textures[MATERIAL_NORMAL], binding.textures[MATERIAL_HEIGHT],
+                    binding.textures[MATERIAL_LIGHTMAP], binding.shininess);
+    auto found = materials.find(key);
+    if (found != materials.end())
+        return found->second;
+    unsigned int id = (unsigned int)materials.size() + 1;
+    materials[key] = id;
+    return id;
+}
@@ -8,7 +8,9 @@ using namespace std;
 
 Object::Object()
 {
-
+	Static = false;
+	Occluder = false;
+	Loader = LOADER_ASSIMP;
 }
 
 Object::Object(std::string name)
@@ -20,6 +22,9 @@ Object::Object(std::string name)
 	setModelName("");
 	setTexture("");
 	setRotationVector(0,1,0);
+	setStatic(false);
+	setOccluder(false);
+	setModelLoader(LOADER_ASSIMP);
 }
 
 //get set functions for center coordinates
@@ -112,6 +117,48 @@ std::string Object::getModelName()
 	return ModelName;
 }
 
+//get set function for the model importer
+void Object::setModelLoader(Model_Loader loader)
+{
+	Loader = loader;
+}
+
+Model_Loader Object::getModelLoader()
+{
+	return Loader;
+}
+
+//get set function for static objects
+void Object::setStatic(bool s)
+{
+	Static = s;
+}
+
+bool Object::isStatic()
+{
+	return Static;
+}
+
+//get set function for occluders
+void Object::setOccluder(bool o)
+{
+	Occluder = o;
+}
+
+bool Object::isOccluder()
+{
+	return Occluder;
+}
+
+VecMat::mat4 Object::getModelMatrix()
+{
+	VecMat::mat4 model = VecMat::mat4(1.0f);
+	model = VecMat::translate(model, position);
+	model = VecMat::rotate(model, to_radians(static_cast<float>(angle)), VecMat::vec3(0.0f, 1.0f, 0.0f));
+	model = VecMat::scale(model, scale);
+	return model;
+}
+
 void Object::addObject(Object* a)
 {
 	children.push_back(a);
@@ -120,6 +167,23 @@ std::vector<Object*> Object::getChildren()
 {
 	return children;
 }
+
+Object* Object::spawnInstance(Object* parent, std::string name, double x, double y, double z, double a)
+{
+	Object* copy = new Object(name);
+	copy->setPosition(x, y, z);
+	copy->setAngle(a);
+	copy->setScale(scale.x, scale.y, scale.z);
+	copy->setRotationVector(rotationangle.x, rotationangle.y, rotationangle.z);
+	copy->setModelName(ModelName);
+	copy->setTexture(Texture);
+	copy->setModelLoader(Loader);
+	copy->setStatic(Static);
+	copy->setOccluder(Occluder);
+	instances.emplace_back(copy);
+	parent->addObject(copy);
+	return copy;
+}
 Object::~Object()
 {
 
@@ -0,0 +1,549 @@
+#include "objloader.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // read-only memory mapping of a whole file
+    class MappedFile
+    {
+    public:
+        const char *data = nullptr;
+        size_t size = 0;
+
+        bool open(const std::string &path)
+        {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER length;
+            GetFileSizeEx(file, &length);
+            size = size_t(length.QuadPart);
+            if (size == 0)
+                return true;
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (!mapping)
+                return false;
+            data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+                return false;
+            size = size_t(info.st_size);
+            if (size == 0)
+                return true;
+            void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view == MAP_FAILED)
+                return false;
+            data = static_cast<const char *>(view);
+#endif
+            return data != nullptr;
+        }
+
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (data)
+                UnmapViewOfFile(data);
+            if (mapping)
+                CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE)
+                CloseHandle(file);
+#else
+            if (data)
+                munmap(const_cast<char *>(data), size);
+            if (fd >= 0)
+                close(fd);
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+#else
+        int fd = -1;
+#endif
+    };
+
+    const int NO_INDEX = INT_MIN;
+
+    // one face corner; indices are 0-based, either global or relative to the chunk start
+    struct Corner
+    {
+        int v, t, n;
+        unsigned char relative;     // bit 0: v, bit 1: t, bit 2: n are chunk-local
+    };
+
+    struct MaterialSwitch
+    {
+        size_t corner;              // first corner drawn with this material
+        std::string material;
+    };
+
+    // everything one thread pulled out of its slice of the file
+    struct Chunk
+    {
+        std::vector<float> positions, uvs, normals;
+        std::vector<Corner> corners;    // 3 per triangle
+        std::vector<MaterialSwitch> switches;
+        std::vector<std::string> libraries;
+    };
+
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline void skipSpace(const char *&p, const char *end)
+    {
+        while (p < end && isSpace(*p))
+            ++p;
+    }
+
+    inline int parseInt(const char *&p, const char *end)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        int value = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            value = value * 10 + (*p++ - '0');
+        return negative ? -value : value;
+    }
+
+    std::string restOfLine(const char *p, const char *end)
+    {
+        skipSpace(p, end);
+        while (end > p && isSpace(end[-1]))
+            --end;
+        return std::string(p, end);
+    }
+
+    // parses "v", "v/t", "v//n" or "v/t/n"
+    bool parseCorner(const char *&p, const char *end, const Chunk &chunk, Corner &corner)
+    {
+        skipSpace(p, end);
+        if (p >= end)
+            return false;
+        int counts[3] = {int(chunk.positions.size() / 3), int(chunk.uvs.size() / 2), int(chunk.normals.size() / 3)};
+        int values[3] = {NO_INDEX, NO_INDEX, NO_INDEX};
+        corner.relative = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            if (p < end && *p != '/' && !isSpace(*p))
+            {
+                int index = parseInt(p, end);
+                if (index < 0)
+                {
+                    values[k] = counts[k] + index;
+                    corner.relative |= 1 << k;
+                }
+                else if (index > 0)
+                {
+                    values[k] = index - 1;
+                }
+            }
+            if (p < end && *p == '/')
+                ++p;
+            else
+                break;
+        }
+        if (values[0] == NO_INDEX)
+            return false;
+        corner.v = values[0];
+        corner.t = values[1];
+        corner.n = values[2];
+        return true;
+    }
+
+    void parseChunk(const char *p, const char *end, Chunk &chunk)
+    {
+        std::vector<Corner> polygon;
+        while (p < end)
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!lineEnd)
+                lineEnd = end;
+            skipSpace(p, lineEnd);
+
+            if (p + 1 < lineEnd && p[0] == 'v')
+            {
+                const char *q = p + 2;
+                if (p[1] == ' ' || p[1] == '\t')
+                {
+                    q = p + 1;
+                    for (int k = 0; k < 3; k++)
+                        chunk.positions.push_back(parseFloat(q, lineEnd));
+                }
+                else if (p[1] == 't')
+                {
+                    for (int k = 0; k < 2; k++)
+                        chunk.uvs.push_back(parseFloat(q, lineEnd));
+                }
+                else if (p[1] == 'n')
+                {
+                    for (int k = 0; k < 3; k++)
+                        chunk.normals.push_back(parseFloat(q, lineEnd));
+                }
+            }
+            else if (p + 1 < lineEnd && p[0] == 'f' && isSpace(p[1]))
+            {
+                const char *q = p + 1;
+                polygon.clear();
+                Corner corner;
+                while (parseCorner(q, lineEnd, chunk, corner))
+                {
+                    polygon.push_back(corner);
+                    while (q < lineEnd && !isSpace(*q))
+                        ++q;
+                }
+                // fan triangulation, same as aiProcess_Triangulate for convex polygons
+                for (size_t k = 2; k < polygon.size(); k++)
+                {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[k - 1]);
+                    chunk.corners.push_back(polygon[k]);
+                }
+            }
+            else if (lineEnd - p > 7 && strncmp(p, "usemtl", 6) == 0 && isSpace(p[6]))
+            {
+                chunk.switches.push_back({chunk.corners.size(), restOfLine(p + 6, lineEnd)});
+            }
+            else if (lineEnd - p > 7 && strncmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+            {
+                chunk.libraries.push_back(restOfLine(p + 6, lineEnd));
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    // texture statements may carry options ("-bm 0.5 file.png"), the file name comes last
+    std::string textureName(const std::string &value)
+    {
+        if (value.empty() || value[0] != '-')
+            return value;
+        size_t split = value.find_last_of(" \t");
+        return split == std::string::npos ? value : value.substr(split + 1);
+    }
+
+    glm::vec3 parseColor(const char *p, const char *end)
+    {
+        glm::vec3 color;
+        color.x = parseFloat(p, end);
+        color.y = parseFloat(p, end);
+        color.z = parseFloat(p, end);
+        return color;
+    }
+
+    void loadMtl(const std::string &path, std::vector<ObjMaterial> &materials)
+    {
+        MappedFile file;
+        if (!file.open(path) || !file.data)
+            return;
+        const char *p = file.data, *end = file.data + file.size;
+        ObjMaterial *current = nullptr;
+        while (p < end)
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!lineEnd)
+                lineEnd = end;
+            skipSpace(p, lineEnd);
+            const char *word = p;
+            while (p < lineEnd && !isSpace(*p))
+                ++p;
+            std::string key(word, p);
+
+            if (key == "newmtl")
+            {
+                materials.push_back(ObjMaterial());
+                current = &materials.back();
+                current->name = restOfLine(p, lineEnd);
+            }
+            else if (current)
+            {
+                if (key == "Ns")
+                    current->shininess = parseFloat(p, lineEnd);
+                else if (key == "Ka")
+                    current->ambient = parseColor(p, lineEnd);
+                else if (key == "Kd")
+                    current->diffuse = parseColor(p, lineEnd);
+                else if (key == "Ks")
+                    current->specular = parseColor(p, lineEnd);
+                else if (key == "d")
+                    current->opacity = parseFloat(p, lineEnd);
+                else if (key == "map_Kd")
+                    current->diffuseMap = textureName(restOfLine(p, lineEnd));
+                else if (key == "map_Ks")
+                    current->specularMap = textureName(restOfLine(p, lineEnd));
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    struct CornerKey
+    {
+        int v, t, n;
+        bool operator==(const CornerKey &o) const { return v == o.v && t == o.t && n == o.n; }
+    };
+
+    struct CornerHash
+    {
+        size_t operator()(const CornerKey &k) const
+        {
+            return size_t(unsigned(k.v) * 73856093u) ^ size_t(unsigned(k.t) * 19349663u) ^ size_t(unsigned(k.n) * 83492791u);
+        }
+    };
+
+    // deduplicates the resolved corners of one material into an indexed mesh
+    void buildMesh(const std::vector<Corner> &corners, const std::vector<float> &positions,
+                   const std::vector<float> &uvs, const std::vector<float> &normals, ObjMesh &mesh)
+    {
+        std::unordered_map<CornerKey, unsigned int, CornerHash> lookup;
+        lookup.reserve(corners.size());
+        mesh.indices.reserve(corners.size());
+        int positionCount = int(positions.size() / 3), uvCount = int(uvs.size() / 2), normalCount = int(normals.size() / 3);
+
+        for (size_t c = 0; c < corners.size(); c += 3)
+        {
+            const Corner *tri = &corners[c];
+            bool valid = true;
+            for (int k = 0; k < 3; k++)
+                valid = valid && tri[k].v >= 0 && tri[k].v < positionCount;
+            if (!valid)
+                continue;
+
+            // missing normals become the flat face normal, like aiProcess_GenNormals
+            glm::vec3 faceNormal(0.0f);
+            bool needsFaceNormal = false;
+            for (int k = 0; k < 3; k++)
+                needsFaceNormal = needsFaceNormal || tri[k].n < 0 || tri[k].n >= normalCount;
+            if (needsFaceNormal)
+            {
+                const float *a = &positions[tri[0].v * 3], *b = &positions[tri[1].v * 3], *d = &positions[tri[2].v * 3];
+                glm::vec3 e1(b[0] - a[0], b[1] - a[1], b[2] - a[2]), e2(d[0] - a[0], d[1] - a[1], d[2] - a[2]);
+                faceNormal = glm::cross(e1, e2);
+                float len = std::sqrt(glm::dot(faceNormal, faceNormal));
+                if (len > 0)
+                    faceNormal = faceNormal / len;
+            }
+
+            for (int k = 0; k < 3; k++)
+            {
+                int t = tri[k].t >= 0 && tri[k].t < uvCount ? tri[k].t : -1;
+                int n = tri[k].n >= 0 && tri[k].n < normalCount ? tri[k].n : -1 - int(c / 3);
+                CornerKey key = {tri[k].v, t, n};
+                auto found = lookup.find(key);
+                if (found != lookup.end())
+                {
+                    mesh.indices.push_back(found->second);
+                    continue;
+                }
+                Vertex vertex;
+                vertex.Position = glm::vec3(positions[key.v * 3], positions[key.v * 3 + 1], positions[key.v * 3 + 2]);
+                vertex.Normal = n >= 0 ? glm::vec3(normals[n * 3], normals[n * 3 + 1], normals[n * 3 + 2]) : faceNormal;
+                vertex.TexCoords = t >= 0 ? glm::vec2(uvs[t * 2], 1.0f - uvs[t * 2 + 1]) : glm::vec2(0.0f, 0.0f);
+                unsigned int index = (unsigned int)mesh.vertices.size();
+                mesh.vertices.push_back(vertex);
+                lookup.emplace(key, index);
+                mesh.indices.push_back(index);
+            }
+        }
+    }
+
+    template <class Task>
+    void parallelFor(size_t count, unsigned int threads, Task task)
+    {
+        if (threads <= 1 || count <= 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                task(i);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < threads && w < count; w++)
+            workers.emplace_back([&, w]() {
+                for (size_t i = w; i < count; i += threads)
+                    task(i);
+            });
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+}
+
+float parseFloat(const char *&p, const char *end)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    skipSpace(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // up to 18 significant digits go into an integer mantissa, the rest only shift the exponent
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        if (digits < 18)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa)
+                digits++;
+        }
+        else
+        {
+            exponent++;
+        }
+        ++p;
+    }
+    if (p < end && *p == '.')
+    {
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (digits < 18)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa)
+                    digits++;
+                exponent--;
+            }
+            ++p;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        exponent += parseInt(p, end);
+    }
+
+    double value = double(mantissa);
+    if (exponent < 0)
+        value = -exponent <= 22 ? value / powers[-exponent] : value * std::pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * powers[exponent] : value * std::pow(10.0, exponent);
+    return float(negative ? -value : value);
+}
+
+bool loadObj(const std::string &path, ObjScene &scene, std::string &error, unsigned int threads)
+{
+    scene = ObjScene();
+    MappedFile file;
+    if (!file.open(path))
+    {
+        error = "could not open " + path;
+        return false;
+    }
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // not worth spinning up threads for small files
+    const size_t minChunkBytes = 64 * 1024;
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, file.size / minChunkBytes));
+
+    // cut at line boundaries
+    std::vector<const char *> cuts(1, file.data);
+    const char *end = file.data + file.size;
+    for (size_t c = 1; c < chunkCount; c++)
+    {
+        const char *cut = std::max(cuts.back(), file.data + file.size * c / chunkCount);
+        const char *newline = cut < end ? static_cast<const char *>(memchr(cut, '\n', end - cut)) : nullptr;
+        cuts.push_back(newline ? newline + 1 : end);
+    }
+    cuts.push_back(end);
+
+    std::vector<Chunk> chunks(chunkCount);
+    parallelFor(chunkCount, threads, [&](size_t c) { parseChunk(cuts[c], cuts[c + 1], chunks[c]); });
+
+    // materials from every referenced library, relative to the obj file
+    std::string directory;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos)
+        directory = path.substr(0, slash + 1);
+    for (const Chunk &chunk : chunks)
+        for (const std::string &library : chunk.libraries)
+            loadMtl(directory + library, scene.materials);
+
+    // global attribute arrays and chunk bases for relative indices
+    std::vector<float> positions, uvs, normals;
+    std::vector<int> base[3];
+    for (const Chunk &chunk : chunks)
+    {
+        base[0].push_back(int(positions.size() / 3));
+        base[1].push_back(int(uvs.size() / 2));
+        base[2].push_back(int(normals.size() / 3));
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // sort triangles into per-material groups, in order of first use
+    std::unordered_map<std::string, size_t> groupOf;
+    std::vector<int> groupMaterial;
+    std::vector<std::vector<Corner>> groups;
+    auto findGroup = [&](const std::string &name) {
+        auto found = groupOf.find(name);
+        if (found != groupOf.end())
+            return found->second;
+        int material = -1;
+        for (size_t m = 0; m < scene.materials.size(); m++)
+            if (scene.materials[m].name == name)
+                material = int(m);
+        groupOf[name] = groups.size();
+        groupMaterial.push_back(material);
+        groups.emplace_back();
+        return groups.size() - 1;
+    };
+
+    size_t group = findGroup("");
+    for (size_t c = 0; c < chunks.size(); c++)
+    {
+        const Chunk &chunk = chunks[c];
+        size_t next = 0;
+        for (size_t i = 0; i < chunk.corners.size(); i++)
+        {
+            while (next < chunk.switches.size() && chunk.switches[next].corner <= i)
+                group = findGroup(chunk.switches[next++].material);
+            Corner corner = chunk.corners[i];
+            if (corner.relative & 1) corner.v += base[0][c];
+            if (corner.relative & 2) corner.t += base[1][c];
+            if (corner.relative & 4) corner.n += base[2][c];
+            groups[group].push_back(corner);
+        }
+        while (next < chunk.switches.size())
+            group = findGroup(chunk.switches[next++].material);
+    }
+
+    std::vector<ObjMesh> meshes(groups.size());
+    parallelFor(groups.size(), threads, [&](size_t g) {
+        meshes[g].material = groupMaterial[g];
+        buildMesh(groups[g], positions, uvs, normals, meshes[g]);
+    });
+    for (ObjMesh &mesh : meshes)
+        if (!mesh.indices.empty())
+            scene.meshes.push_back(std::move(mesh));
+
+    if (scene.meshes.empty())
+    {
+        error = "no faces in " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,359 @@
+#include "occlusion.hpp"
+#include "frustum.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    float elapsedMs(Clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer(unsigned int threads)
+    : depth(WIDTH * HEIGHT, 1.0f), nextTile(0)
+{
+    std::fill(tileMaxDepth, tileMaxDepth + TILES, 1.0f);
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            clip[c][r] = c == r ? 1.0f : 0.0f;
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int helpers = std::min<unsigned int>(threads, TILES) - 1;
+    for (unsigned int i = 0; i < helpers; i++)
+        workers.emplace_back(&OcclusionBuffer::workerLoop, this);
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void OcclusionBuffer::begin(const VecMat::mat4 &projection, const VecMat::mat4 &view)
+{
+    clipMatrix(projection, view, clip);
+    triangles.clear();
+}
+
+void OcclusionBuffer::addOccluder(const float *positions, size_t stride, const unsigned int *indices, size_t indexCount,
+                                  const VecMat::mat4 &transform)
+{
+    Clock::time_point start = Clock::now();
+
+    // model to clip space in one matrix
+    float m[4][4];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+        {
+            m[c][r] = 0.0f;
+            for (int k = 0; k < 4; k++)
+                m[c][r] += clip[k][r] * transform.mat[c][k];
+        }
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        float v[3][4];
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const float *p = (const float *)((const char *)positions + indices[i + corner] * stride);
+            for (int r = 0; r < 4; r++)
+                v[corner][r] = m[0][r] * p[0] + m[1][r] * p[1] + m[2][r] * p[2] + m[3][r];
+        }
+        addTriangle(v);
+    }
+    frameStats.occlusionMs += elapsedMs(start);
+}
+
+// clips a clip space triangle against the near plane and sets it up for rasterisation
+void OcclusionBuffer::addTriangle(const float (*v)[4])
+{
+    // entirely outside the left/right, bottom/top or far plane (the near plane is clipped below)
+    for (int axis = 0; axis < 3; axis++)
+    {
+        bool allAbove = true, allBelow = axis < 2;
+        for (int i = 0; i < 3; i++)
+        {
+            allAbove = allAbove && v[i][axis] > v[i][3];
+            allBelow = allBelow && v[i][axis] < -v[i][3];
+        }
+        if (allAbove || allBelow)
+            return;
+    }
+
+    // Sutherland-Hodgman against z >= -w, a triangle becomes at most a quad
+    float polygon[4][4];
+    int count = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const float *a = v[i], *b = v[(i + 1) % 3];
+        float da = a[2] + a[3], db = b[2] + b[3];
+        if (da >= 0.0f)
+            std::copy(a, a + 4, polygon[count++]);
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            float t = da / (da - db);
+            for (int r = 0; r < 4; r++)
+                polygon[count][r] = a[r] + (b[r] - a[r]) * t;
+            count++;
+        }
+    }
+
+    float sx[4], sy[4], sz[4];
+    for (int i = 0; i < count; i++)
+    {
+        float w = polygon[i][3];
+        if (w <= 1e-6f)
+            return;
+        sx[i] = (polygon[i][0] / w * 0.5f + 0.5f) * WIDTH;
+        sy[i] = (polygon[i][1] / w * 0.5f + 0.5f) * HEIGHT;
+        sz[i] = polygon[i][2] / w;
+    }
+
+    for (int fan = 1; fan + 1 < count; fan++)
+    {
+        int corners[3] = {0, fan, fan + 1};
+        ScreenTriangle triangle;
+        for (int i = 0; i < 3; i++)
+        {
+            triangle.x[i] = sx[corners[i]];
+            triangle.y[i] = sy[corners[i]];
+            triangle.z[i] = sz[corners[i]];
+        }
+        // counter-clockwise so the inside is where all edge functions are positive
+        float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+                     (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+        if (std::fabs(area) < 1e-8f)
+            continue;
+        if (area < 0.0f)
+        {
+            std::swap(triangle.x[1], triangle.x[2]);
+            std::swap(triangle.y[1], triangle.y[2]);
+            std::swap(triangle.z[1], triangle.z[2]);
+        }
+        float minX = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+        float maxX = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+        float minY = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+        float maxY = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+        if (maxX < 0.0f || minX > WIDTH || maxY < 0.0f || minY > HEIGHT)
+            continue;
+        triangle.minY = std::max(0, (int)std::floor(minY));
+        triangle.maxY = std::min(HEIGHT - 1, (int)std::ceil(maxY));
+        triangles.push_back(triangle);
+    }
+}
+
+void OcclusionBuffer::rasterize()
+{
+    Clock::time_point start = Clock::now();
+    nextTile = 0;
+    if (!workers.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            generation++;
+            busy = (unsigned int)workers.size();
+        }
+        wake.notify_all();
+    }
+    runTiles();
+    if (!workers.empty())
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return busy == 0; });
+    }
+    frameStats.occluderTriangles += (unsigned int)triangles.size();
+    frameStats.occlusionMs += elapsedMs(start);
+}
+
+// bands are handed out one at a time so the threads stay busy when the occluders are uneven
+void OcclusionBuffer::runTiles()
+{
+    for (int tile = nextTile++; tile < TILES; tile = nextTile++)
+        rasterizeTile(tile);
+}
+
+void OcclusionBuffer::workerLoop()
+{
+    unsigned int seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return quit || generation != seen; });
+            if (quit)
+                return;
+            seen = generation;
+        }
+        runTiles();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+void OcclusionBuffer::rasterizeTile(int tile)
+{
+    int firstRow = tile * TILE_ROWS, lastRow = firstRow + TILE_ROWS - 1;
+    std::fill(depth.begin() + firstRow * WIDTH, depth.begin() + (lastRow + 1) * WIDTH, 1.0f);
+
+    for (const ScreenTriangle &t : triangles)
+    {
+        int rowStart = std::max(t.minY, firstRow), rowEnd = std::min(t.maxY, lastRow);
+        if (rowStart > rowEnd)
+            continue;
+
+        // edge i runs from corner i to corner i + 1: e = a * x + b * y + c, inside when >= 0
+        float a[3], b[3], c[3];
+        for (int i = 0; i < 3; i++)
+        {
+            int j = (i + 1) % 3;
+            a[i] = t.y[i] - t.y[j];
+            b[i] = t.x[j] - t.x[i];
+            c[i] = -(a[i] * t.x[i] + b[i] * t.y[i]);
+        }
+        // depth is affine in screen space: z = z0 + dzdx * (x - x0) + dzdy * (y - y0)
+        float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+        float dzdx = ((t.z[1] - t.z[0]) * (t.y[2] - t.y[0]) - (t.z[2] - t.z[0]) * (t.y[1] - t.y[0])) / area;
+        float dzdy = ((t.z[2] - t.z[0]) * (t.x[1] - t.x[0]) - (t.z[1] - t.z[0]) * (t.x[2] - t.x[0])) / area;
+
+        float minX = std::min({t.x[0], t.x[1], t.x[2]}), maxX = std::max({t.x[0], t.x[1], t.x[2]});
+        int columnStart = std::max(0, (int)std::floor(minX)) & ~3;
+        int columnEnd = std::min(WIDTH - 1, (int)std::ceil(maxX));
+
+        for (int y = rowStart; y <= rowEnd; y++)
+        {
+            float py = y + 0.5f;
+            float rowZ = t.z[0] + dzdx * -t.x[0] + dzdy * (py - t.y[0]);
+            float *row = depth.data() + y * WIDTH;
+#ifdef OCCLUSION_SSE
+            __m128 rowEdge0 = _mm_set1_ps(b[0] * py + c[0]);
+            __m128 rowEdge1 = _mm_set1_ps(b[1] * py + c[1]);
+            __m128 rowEdge2 = _mm_set1_ps(b[2] * py + c[2]);
+            __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+            __m128 slope = _mm_set1_ps(dzdx), base = _mm_set1_ps(rowZ), zero = _mm_setzero_ps();
+            for (int x = columnStart; x <= columnEnd; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), rowEdge0), zero),
+                                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), rowEdge1), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), rowEdge2), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(base, _mm_mul_ps(slope, px));
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = columnStart; x <= columnEnd; x++)
+            {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f ||
+                    a[2] * px + b[2] * py + c[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], rowZ + dzdx * px);
+            }
+#endif
+        }
+    }
+
+    float farthest = 0.0f;
+    for (int i = firstRow * WIDTH; i < (lastRow + 1) * WIDTH; i++)
+        farthest = std::max(farthest, depth[i]);
+    tileMaxDepth[tile] = farthest;
+}
+
+bool OcclusionBuffer::isOccluded(const glm::vec3 &center, const glm::vec3 &extent) const
+{
+    Clock::time_point start = Clock::now();
+    bool occluded = false;
+
+    // screen rectangle and nearest depth of the eight corners
+    float minX = WIDTH, maxX = 0.0f, minY = HEIGHT, maxY = 0.0f, nearest = 1.0f;
+    bool crossesNear = false;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec3 p = center + glm::vec3(corner & 1 ? extent.x : -extent.x, corner & 2 ? extent.y : -extent.y,
+                                         corner & 4 ? extent.z : -extent.z);
+        float v[4];
+        for (int r = 0; r < 4; r++)
+            v[r] = clip[0][r] * p.x + clip[1][r] * p.y + clip[2][r] * p.z + clip[3][r];
+        // boxes reaching the near plane are always visible
+        if (v[3] <= 1e-6f || v[2] < -v[3])
+        {
+            crossesNear = true;
+            break;
+        }
+        float x = (v[0] / v[3] * 0.5f + 0.5f) * WIDTH, y = (v[1] / v[3] * 0.5f + 0.5f) * HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, v[2] / v[3]);
+    }
+
+    int columnStart = std::max(0, (int)std::floor(minX)), columnEnd = std::min(WIDTH - 1, (int)std::floor(maxX));
+    int rowStart = std::max(0, (int)std::floor(minY)), rowEnd = std::min(HEIGHT - 1, (int)std::floor(maxY));
+    // off screen boxes are left to frustum culling
+    if (!crossesNear && columnStart <= columnEnd && rowStart <= rowEnd)
+    {
+        // whole bands nearer than the box decide it without looking at pixels
+        occluded = true;
+        for (int tile = rowStart / TILE_ROWS; tile <= rowEnd / TILE_ROWS && occluded; tile++)
+            occluded = tileMaxDepth[tile] < nearest;
+
+        if (!occluded)
+        {
+            occluded = true;
+            columnStart &= ~3;
+            for (int y = rowStart; y <= rowEnd && occluded; y++)
+            {
+                const float *row = depth.data() + y * WIDTH;
+#ifdef OCCLUSION_SSE
+                __m128 boxDepth = _mm_set1_ps(nearest);
+                for (int x = columnStart; x <= columnEnd; x += 4)
+                    if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)))
+                    {
+                        occluded = false;
+                        break;
+                    }
+#else
+                for (int x = columnStart; x <= columnEnd; x++)
+                    if (row[x] >= nearest)
+                    {
+                        occluded = false;
+                        break;
+                    }
+#endif
+            }
+        }
+    }
+    frameStats.occlusionMs += elapsedMs(start);
+    return occluded;
+}
+
+bool OcclusionBuffer::farPlaneOccluded() const
+{
+    for (int tile = 0; tile < TILES; tile++)
+        if (tileMaxDepth[tile] >= 1.0f)
+            return false;
+    return true;
+}
@@ -0,0 +1,115 @@
+#include "occlusion_queries.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+
+#include <cmath>
+
+// proxies are grown a little so a box face lying on the surface it bounds still passes GL_LEQUAL
+const float PROXY_SCALE = 1.02f;
+const float PROXY_MARGIN = 0.01f;
+
+void OcclusionQueries::setProxy(const Shader *program, GLuint unitCube)
+{
+    this->program = program;
+    modelLocation = program->uniformLocation("model");
+    cube = unitCube;
+}
+
+void OcclusionQueries::beginFrame(const glm::vec3 &eye)
+{
+    this->eye = eye;
+    frame++;
+    proxies.clear();
+}
+
+// takes every result that has come back, the newest one decides
+void OcclusionQueries::readResults(Drawable &drawable)
+{
+    for (unsigned int i = 0; i < LATENCY; i++)
+    {
+        if (drawable.issued[i] == 0)
+            continue;
+        GLint available = 0;
+        glGetQueryObjectiv(drawable.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint samples = 0;
+        glGetQueryObjectuiv(drawable.queries[i], GL_QUERY_RESULT, &samples);
+        if (drawable.issued[i] > drawable.resultFrame)
+        {
+            drawable.resultFrame = drawable.issued[i];
+            drawable.visible = samples != 0;
+        }
+        drawable.issued[i] = 0;
+    }
+}
+
+GLuint OcclusionQueries::test(uint64_t key, const glm::vec3 &center, const glm::vec3 &extent)
+{
+    auto found = drawables.find(key);
+    if (found == drawables.end())
+    {
+        // new drawables are drawn unconditionally until their first result is in
+        Drawable drawable = {};
+        glGenQueries(LATENCY, drawable.queries);
+        drawable.visible = true;
+        found = drawables.emplace(key, drawable).first;
+    }
+    Drawable &drawable = found->second;
+    readResults(drawable);
+
+    // the proxy would be clipped by the near plane with the camera inside it
+    glm::vec3 grown = extent * PROXY_SCALE + glm::vec3(PROXY_MARGIN);
+    glm::vec3 offset = eye - center;
+    if (std::fabs(offset.x) <= grown.x && std::fabs(offset.y) <= grown.y && std::fabs(offset.z) <= grown.z)
+    {
+        drawable.visible = true;
+        drawable.resultFrame = frame;
+        return 0;
+    }
+
+    // a query still in flight after LATENCY frames is given up, its slot is reused
+    unsigned int slot = frame % LATENCY;
+    drawable.issued[slot] = frame;
+    proxies.push_back({drawable.queries[slot], center, grown});
+    frameStats.occlusionQueries++;
+    if (drawable.visible)
+        return 0;
+    frameStats.conditionalDraws++;
+    return drawable.queries[slot];
+}
+
+void OcclusionQueries::issue()
+{
+    if (proxies.empty() || !program)
+        return;
+
+    // boxes only test against the depth buffer, they leave no trace in it
+    glState.colorMask(false);
+    glState.depthMask(false);
+    glState.depthFunc(GL_LEQUAL);
+    program->Bind();
+    program->setBool("instanced", false);
+    glState.bindVertexArray(cube);
+
+    GLenum target = glCaps.conservativeQueries ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+    for (const Proxy &proxy : proxies)
+    {
+        glm::mat4 model(1.0f);
+        model[0][0] = 2.0f * proxy.extent.x;
+        model[1][1] = 2.0f * proxy.extent.y;
+        model[2][2] = 2.0f * proxy.extent.z;
+        model[3][0] = proxy.center.x;
+        model[3][1] = proxy.center.y;
+        model[3][2] = proxy.center.z;
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+        glBeginQuery(target, proxy.query);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glEndQuery(target);
+    }
+
+    program->setBool("instanced", true);
+    glState.depthMask(true);
+    glState.colorMask(true);
+}
@@ -0,0 +1,219 @@
+#include "portal.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// how far a box may stick out of a portal's quad and still count as sitting in it,
+// and how close the eye may come to a portal before it is treated as standing in it
+const float PORTAL_SLACK = 0.25f;
+
+unsigned int CellGraph::addCell(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+    Cell cell;
+    cell.boundsMin = boundsMin;
+    cell.boundsMax = boundsMax;
+    cell.bounded = true;
+    cells.push_back(cell);
+    return (unsigned int)cells.size() - 1;
+}
+
+unsigned int CellGraph::addOutsideCell()
+{
+    Cell cell;
+    cell.boundsMin = cell.boundsMax = glm::vec3(0.0f);
+    cell.bounded = false;
+    cells.push_back(cell);
+    return (unsigned int)cells.size() - 1;
+}
+
+unsigned int CellGraph::addPortal(unsigned int cellA, unsigned int cellB, const glm::vec3 corners[4])
+{
+    Portal portal;
+    portal.boundsMin = portal.boundsMax = corners[0];
+    for (int i = 0; i < 4; i++)
+    {
+        portal.corners[i] = corners[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            portal.boundsMin[axis] = std::min(portal.boundsMin[axis], corners[i][axis]);
+            portal.boundsMax[axis] = std::max(portal.boundsMax[axis], corners[i][axis]);
+        }
+    }
+    portal.boundsMin = portal.boundsMin - glm::vec3(PORTAL_SLACK);
+    portal.boundsMax = portal.boundsMax + glm::vec3(PORTAL_SLACK);
+    portal.cells[0] = cellA;
+    portal.cells[1] = cellB;
+    portals.push_back(portal);
+    unsigned int index = (unsigned int)portals.size() - 1;
+    cells[cellA].portals.push_back(index);
+    cells[cellB].portals.push_back(index);
+    return index;
+}
+
+void CellGraph::quadFromBox(const glm::vec3 &center, const glm::vec3 &extent, glm::vec3 corners[4])
+{
+    int thin = 0;
+    for (int axis = 1; axis < 3; axis++)
+        if (extent[axis] < extent[thin])
+            thin = axis;
+    int u = (thin + 1) % 3, v = (thin + 2) % 3;
+    const float signs[4][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+    for (int i = 0; i < 4; i++)
+    {
+        corners[i] = center;
+        corners[i][u] += signs[i][0] * extent[u];
+        corners[i][v] += signs[i][1] * extent[v];
+    }
+}
+
+unsigned int CellGraph::cellAt(const glm::vec3 &point) const
+{
+    unsigned int outside = 0;
+    for (unsigned int i = 0; i < cells.size(); i++)
+    {
+        const Cell &cell = cells[i];
+        if (!cell.bounded)
+            outside = i;
+        else if (point.x >= cell.boundsMin.x && point.x <= cell.boundsMax.x && point.y >= cell.boundsMin.y &&
+                 point.y <= cell.boundsMax.y && point.z >= cell.boundsMin.z && point.z <= cell.boundsMax.z)
+            return i;
+    }
+    return outside;
+}
+
+uint32_t CellGraph::cellsOf(const glm::vec3 &center, const glm::vec3 &extent) const
+{
+    glm::vec3 boxMin = center - extent, boxMax = center + extent;
+    uint32_t mask = 0;
+    bool contained = false;
+    for (unsigned int i = 0; i < cells.size(); i++)
+    {
+        const Cell &cell = cells[i];
+        if (!cell.bounded)
+            continue;
+        bool overlaps = true, inside = true;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            overlaps = overlaps && boxMax[axis] >= cell.boundsMin[axis] && boxMin[axis] <= cell.boundsMax[axis];
+            inside = inside && boxMin[axis] >= cell.boundsMin[axis] && boxMax[axis] <= cell.boundsMax[axis];
+        }
+        if (overlaps)
+            mask |= 1u << i;
+        contained = contained || inside;
+    }
+    // whatever pokes out of every bounded cell can be seen from outside
+    if (!contained)
+        for (unsigned int i = 0; i < cells.size(); i++)
+            if (!cells[i].bounded)
+                mask |= 1u << i;
+
+    for (const Portal &portal : portals)
+    {
+        bool overlaps = true;
+        for (int axis = 0; axis < 3; axis++)
+            overlaps = overlaps && boxMax[axis] >= portal.boundsMin[axis] && boxMin[axis] <= portal.boundsMax[axis];
+        if (overlaps)
+            mask |= (1u << portal.cells[0]) | (1u << portal.cells[1]);
+    }
+    return mask;
+}
+
+// screen rectangle of a portal, false when it is off screen or behind the eye
+bool CellGraph::portalRect(const Portal &portal, const float clip[4][4], const glm::vec3 &eye, Rect &rect) const
+{
+    // standing in the opening, the whole view goes through it
+    if (eye.x >= portal.boundsMin.x && eye.x <= portal.boundsMax.x && eye.y >= portal.boundsMin.y &&
+        eye.y <= portal.boundsMax.y && eye.z >= portal.boundsMin.z && eye.z <= portal.boundsMax.z)
+    {
+        rect = {-1.0f, 1.0f, -1.0f, 1.0f};
+        return true;
+    }
+
+    float corners[4][4];
+    for (int i = 0; i < 4; i++)
+        for (int r = 0; r < 4; r++)
+            corners[i][r] = clip[0][r] * portal.corners[i].x + clip[1][r] * portal.corners[i].y +
+                            clip[2][r] * portal.corners[i].z + clip[3][r];
+
+    // clipped against the near plane (z >= -w) the quad keeps at most five corners
+    rect = {1.0f, -1.0f, 1.0f, -1.0f};
+    bool any = false;
+    for (int i = 0; i < 4; i++)
+    {
+        const float *a = corners[i], *b = corners[(i + 1) % 4];
+        float da = a[2] + a[3], db = b[2] + b[3];
+        float point[2][4];
+        int count = 0;
+        if (da >= 0.0f)
+            std::copy(a, a + 4, point[count++]);
+        if ((da >= 0.0f) != (db >= 0.0f))
+        {
+            float t = da / (da - db);
+            for (int r = 0; r < 4; r++)
+                point[count][r] = a[r] + (b[r] - a[r]) * t;
+            count++;
+        }
+        for (int p = 0; p < count; p++)
+        {
+            float w = std::max(point[p][3], 1e-6f);
+            float x = point[p][0] / w, y = point[p][1] / w;
+            rect.left = std::min(rect.left, x);
+            rect.right = std::max(rect.right, x);
+            rect.bottom = std::min(rect.bottom, y);
+            rect.top = std::max(rect.top, y);
+            any = true;
+        }
+    }
+    return any;
+}
+
+void CellGraph::visit(unsigned int cell, const Rect &rect, uint32_t path, const float clip[4][4], const glm::vec3 &eye,
+                      std::vector<Rect> &rects, uint32_t &visible) const
+{
+    uint32_t bit = 1u << cell;
+    if (visible & bit)
+    {
+        Rect &seen = rects[cell];
+        seen = {std::min(seen.left, rect.left), std::max(seen.right, rect.right),
+                std::min(seen.bottom, rect.bottom), std::max(seen.top, rect.top)};
+    }
+    else
+        rects[cell] = rect;
+    visible |= bit;
+    path |= bit;
+
+    for (unsigned int index : cells[cell].portals)
+    {
+        const Portal &portal = portals[index];
+        unsigned int next = portal.cells[0] == cell ? portal.cells[1] : portal.cells[0];
+        if (!portal.open || (path & (1u << next)))
+            continue;
+        Rect through;
+        if (!portalRect(portal, clip, eye, through))
+            continue;
+        through = {std::max(through.left, rect.left), std::min(through.right, rect.right),
+                   std::max(through.bottom, rect.bottom), std::min(through.top, rect.top)};
+        if (through.left < through.right && through.bottom < through.top)
+            visit(next, through, path, clip, eye, rects, visible);
+    }
+}
+
+uint32_t CellGraph::traverse(const glm::vec3 &eye, const VecMat::mat4 &projection, const VecMat::mat4 &view,
+                             std::vector<Frustum> &frusta) const
+{
+    frusta.resize(cells.size());
+    if (cells.empty())
+        return 0;
+
+    float clip[4][4];
+    clipMatrix(projection, view, clip);
+
+    std::vector<Rect> rects(cells.size());
+    uint32_t visible = 0;
+    visit(cellAt(eye), {-1.0f, 1.0f, -1.0f, 1.0f}, 0, clip, eye, rects, visible);
+
+    for (unsigned int i = 0; i < cells.size(); i++)
+        if (visible & (1u << i))
+            frusta[i].extract(projection, view, rects[i].left, rects[i].right, rects[i].bottom, rects[i].top);
+    return visible;
+}
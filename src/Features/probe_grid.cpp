@@ -0,0 +1,165 @@
+#include "probe_grid.hpp"
+#include "material.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const char PROBE_MAGIC[4] = {'S', 'H', 'P', '1'};
+
+    // the file is a fixed header followed by every probe, x fastest
+    struct ProbeHeader
+    {
+        char magic[4];
+        int32_t dims[3];
+        float boundsMin[3], boundsMax[3];
+        uint32_t signature;
+    };
+}
+
+void shBasis(const glm::vec3 &dir, float out[SH_COEFFICIENTS])
+{
+    out[0] = 0.282095f;
+    out[1] = 0.488603f * dir.y;
+    out[2] = 0.488603f * dir.z;
+    out[3] = 0.488603f * dir.x;
+    out[4] = 1.092548f * dir.x * dir.y;
+    out[5] = 1.092548f * dir.y * dir.z;
+    out[6] = 0.315392f * (3.0f * dir.z * dir.z - 1.0f);
+    out[7] = 1.092548f * dir.x * dir.z;
+    out[8] = 0.546274f * (dir.x * dir.x - dir.y * dir.y);
+}
+
+void ProbeGrid::create(const glm::vec3 &lo, const glm::vec3 &hi, const int counts[3], uint32_t signature)
+{
+    boundsMin = lo;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        dims[axis] = std::max(counts[axis], 2);
+        spacing[axis] = (hi[axis] - lo[axis]) / (dims[axis] - 1);
+    }
+    hash = signature;
+    Probe black;
+    std::fill(black.sh, black.sh + SH_COEFFICIENTS, glm::vec3(0.0f));
+    probes.assign(size_t(dims[0]) * dims[1] * dims[2], black);
+}
+
+bool ProbeGrid::load(const std::string &path)
+{
+    probes.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    ProbeHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PROBE_MAGIC, sizeof(PROBE_MAGIC)) != 0 ||
+        header.dims[0] < 2 || header.dims[1] < 2 || header.dims[2] < 2)
+    {
+        std::cout << "ERROR::PROBES:: " << path << " is not a probe grid" << std::endl;
+        return false;
+    }
+    // like the lightmaps, the grid size from the file has to fit the file before it is allocated
+    file.seekg(0, std::ios::end);
+    uint64_t fit = (uint64_t(file.tellg()) - sizeof(header)) / sizeof(Probe);
+    file.seekg(sizeof(header));
+    uint64_t layer = uint64_t(header.dims[0]) * uint64_t(header.dims[1]);
+    if (layer > fit || uint64_t(header.dims[2]) > fit / layer)
+    {
+        std::cout << "ERROR::PROBES:: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    int counts[3] = {header.dims[0], header.dims[1], header.dims[2]};
+    create(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+           glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]), counts, header.signature);
+    if (!file.read(reinterpret_cast<char *>(probes.data()), probes.size() * sizeof(Probe)))
+    {
+        std::cout << "ERROR::PROBES:: " << path << " is truncated" << std::endl;
+        probes.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ProbeGrid::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    ProbeHeader header;
+    std::memcpy(header.magic, PROBE_MAGIC, sizeof(PROBE_MAGIC));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.dims[axis] = dims[axis];
+        header.boundsMin[axis] = boundsMin[axis];
+        header.boundsMax[axis] = boundsMin[axis] + spacing[axis] * (dims[axis] - 1);
+    }
+    header.signature = hash;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(probes.data()), probes.size() * sizeof(Probe));
+    return bool(file);
+}
+
+glm::vec3 ProbeGrid::position(int x, int y, int z) const
+{
+    return boundsMin + spacing * glm::vec3(float(x), float(y), float(z));
+}
+
+void ProbeGrid::sample(const glm::vec3 &point, Probe &out) const
+{
+    int base[3];
+    float weight[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float cell = glm::clamp((point[axis] - boundsMin[axis]) / spacing[axis], 0.0f, float(dims[axis] - 1));
+        base[axis] = std::min((int)cell, dims[axis] - 2);
+        weight[axis] = cell - base[axis];
+    }
+    std::fill(out.sh, out.sh + SH_COEFFICIENTS, glm::vec3(0.0f));
+    for (int corner = 0; corner < 8; corner++)
+    {
+        float w = 1.0f;
+        size_t index = 0, stride = 1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int step = (corner >> axis) & 1;
+            w *= step ? weight[axis] : 1.0f - weight[axis];
+            index += (base[axis] + step) * stride;
+            stride *= dims[axis];
+        }
+        const Probe &probe = probes[index];
+        for (unsigned int k = 0; k < SH_COEFFICIENTS; k++)
+            out.sh[k] += probe.sh[k] * w;
+    }
+}
+
+void ProbeLighting::begin(const ProbeGrid &probes)
+{
+    grid = &probes;
+    texels.clear();
+}
+
+uint32_t ProbeLighting::add(const glm::vec3 &center)
+{
+    uint32_t entry = (uint32_t)(texels.size() / SH_COEFFICIENTS);
+    if (!grid || entry >= MAX_ENTRIES)
+        return NONE;
+    ProbeGrid::Probe probe;
+    grid->sample(center, probe);
+    for (const glm::vec3 &coefficient : probe.sh)
+        texels.push_back(glm::vec4(coefficient, 0.0f));
+    frameStats.probeDraws++;
+    return entry;
+}
+
+void ProbeLighting::upload()
+{
+    if (!texture.created())
+        texture.create(GL_RGBA32F, TEXTURE_PROBES);
+    texture.upload(texels.data(), texels.size() * sizeof(glm::vec4));
+    texture.bind();
+}
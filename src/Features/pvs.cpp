@@ -0,0 +1,114 @@
+#include "pvs.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    const char PVS_MAGIC[4] = {'P', 'V', 'S', '1'};
+
+    // the file is a fixed header followed by the bits of every cell, x fastest
+    struct PvsHeader
+    {
+        char magic[4];
+        int32_t dims[3];
+        float boundsMin[3], boundsMax[3];
+        uint32_t meshes;
+        uint32_t signature;
+    };
+}
+
+void PotentiallyVisibleSet::create(const glm::vec3 &lo, const glm::vec3 &hi, const int cells[3],
+                                   unsigned int meshCount, uint32_t signature)
+{
+    boundsMin = lo;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        dims[axis] = cells[axis];
+        size[axis] = (hi[axis] - lo[axis]) / cells[axis];
+    }
+    meshes = meshCount;
+    words = (meshCount + 1 + 31) / 32;
+    hash = signature;
+    bits.assign(size_t(dims[0]) * dims[1] * dims[2] * words, 0u);
+}
+
+bool PotentiallyVisibleSet::load(const std::string &path)
+{
+    bits.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    PvsHeader header;
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, PVS_MAGIC, sizeof(PVS_MAGIC)) != 0 ||
+        header.dims[0] <= 0 || header.dims[1] <= 0 || header.dims[2] <= 0)
+    {
+        std::cout << "ERROR::PVS:: " << path << " is not a visibility set" << std::endl;
+        return false;
+    }
+    int cells[3] = {header.dims[0], header.dims[1], header.dims[2]};
+    create(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+           glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]), cells, header.meshes,
+           header.signature);
+    if (!file.read(reinterpret_cast<char *>(bits.data()), bits.size() * sizeof(uint32_t)))
+    {
+        std::cout << "ERROR::PVS:: " << path << " is truncated" << std::endl;
+        bits.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PotentiallyVisibleSet::save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    PvsHeader header;
+    std::memcpy(header.magic, PVS_MAGIC, sizeof(PVS_MAGIC));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        header.dims[axis] = dims[axis];
+        header.boundsMin[axis] = boundsMin[axis];
+        header.boundsMax[axis] = boundsMin[axis] + size[axis] * dims[axis];
+    }
+    header.meshes = meshes;
+    header.signature = hash;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(bits.data()), bits.size() * sizeof(uint32_t));
+    return bool(file);
+}
+
+const uint32_t *PotentiallyVisibleSet::cellBits(const glm::vec3 &point) const
+{
+    if (bits.empty())
+        return nullptr;
+    int cell[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float local = (point[axis] - boundsMin[axis]) / size[axis];
+        if (!(local >= 0.0f && local <= float(dims[axis])))
+            return nullptr;
+        // the far face belongs to the last cell
+        cell[axis] = std::min(int(local), dims[axis] - 1);
+    }
+    return &bits[((size_t(cell[2]) * dims[1] + cell[1]) * dims[0] + cell[0]) * words];
+}
+
+glm::vec3 PotentiallyVisibleSet::cellMin(int x, int y, int z) const
+{
+    return glm::vec3(boundsMin.x + x * size.x, boundsMin.y + y * size.y, boundsMin.z + z * size.z);
+}
+
+uint32_t PotentiallyVisibleSet::signatureOf(const std::vector<unsigned int> &meshIndexCounts)
+{
+    uint32_t h = 2166136261u;
+    for (unsigned int count : meshIndexCounts)
+        for (int byte = 0; byte < 4; byte++)
+            h = (h ^ ((count >> (8 * byte)) & 0xffu)) * 16777619u;
+    return h;
+}
@@ -0,0 +1,432 @@
+#include "render_queue.hpp"
+#include "glstate.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+unsigned int RenderQueue::addProgram(const Shader *shader)
+{
+    shader->Bind();
+    shader->setBool("instanced", true);
+    programs.push_back(shader);
+    shininessLocations.push_back(shader->uniformLocation("material.shininess"));
+    return (unsigned int)programs.size() - 1;
+}
+
+void RenderQueue::setInstanceDefaults()
+{
+    // light from the clusters, and the baked lights shaded like the others
+    glVertexAttribI4ui(INSTANCE_LIGHTS_LOCATION, DrawLights::CLUSTERED, DrawLights::END, DrawLights::END, DrawLights::END);
+    glVertexAttribI4ui(INSTANCE_PROBE_LOCATION, ProbeLighting::NONE, 0, 0, 0);
+}
+
+void RenderQueue::releaseInstanceArrays(GLuint vertexArray)
+{
+    auto found = std::find(instancedArrays.begin(), instancedArrays.end(), vertexArray);
+    if (found == instancedArrays.end())
+        return;
+    glState.bindVertexArray(vertexArray);
+    for (GLuint column = 0; column < 4; column++)
+        glDisableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+    glDisableVertexAttribArray(INSTANCE_LIGHTS_LOCATION);
+    glDisableVertexAttribArray(INSTANCE_PROBE_LOCATION);
+    instancedArrays.erase(found);
+}
+
+void RenderQueue::setDepthProgram(const Shader *shader)
+{
+    shader->Bind();
+    shader->setBool("instanced", true);
+    depthShader = shader;
+}
+
+void RenderQueue::begin(const glm::vec3 &eye)
+{
+    this->eye = eye;
+    commands.clear();
+    items.clear();
+    batches.clear();
+    instanceCommand.clear();
+    instanceMatrix.clear();
+    instanceLights.clear();
+    instanceProbes.clear();
+}
+
+uint64_t RenderQueue::makeKey(Render_Pass pass, unsigned int program, unsigned int material, const glm::vec3 &center) const
+{
+    // a positive float's bit pattern sorts like the float itself
+    glm::vec3 offset = center - eye;
+    float distance = glm::dot(offset, offset);
+    uint32_t depth;
+    std::memcpy(&depth, &distance, sizeof(depth));
+
+    return (uint64_t(pass & 0xf) << 60) | (uint64_t(program & 0xff) << 52) |
+           (uint64_t(material & 0xfffff) << 32) | depth;
+}
+
+void RenderQueue::push(Render_Pass pass, unsigned int program, unsigned int material, const glm::vec3 &center,
+                       const Command &command, const VecMat::mat4 *model, const void *geometry,
+                       const DrawLights &lights, uint32_t probe)
+{
+    if (command.condition)
+        pass = PASS_CONDITIONAL;
+    uint64_t key = makeKey(pass, program, material, center);
+    if (!model)
+    {
+        items.push_back({key, (unsigned int)commands.size()});
+        commands.push_back(command);
+        return;
+    }
+
+    // same geometry and state as an earlier draw: becomes one more instance of it,
+    // sorted by its nearest instance
+    BatchKey batch(pass, program, geometry, command.lod, material, command.condition);
+    auto found = batches.find(batch);
+    unsigned int index;
+    if (found != batches.end())
+    {
+        index = found->second;
+        items[index].key = std::min(items[index].key, key);
+    }
+    else
+    {
+        index = (unsigned int)commands.size();
+        batches[batch] = index;
+        items.push_back({key, index});
+        commands.push_back(command);
+        commands.back().instanced = true;
+    }
+    commands[index].instanceCount++;
+    instanceCommand.push_back(index);
+    instanceMatrix.push_back(*model);
+    instanceLights.push_back(lights);
+    instanceProbes.push_back(probe);
+}
+
+void RenderQueue::submit(Render_Pass pass, unsigned int program, const Mesh &mesh, unsigned int lod,
+                         const VecMat::mat4 &model, const glm::vec3 &center, const glm::vec3 &extent,
+                         GLuint condition)
+{
+    Command command = {&mesh, lod, 0, 0, GL_TEXTURE_2D, 0, false, 0, 0, false, condition};
+    uint32_t probe = probeLighting ? probeLighting->add(center) : ProbeLighting::NONE;
+    // the slots go to lights that shade the draw, not to baked ones the shader skips
+    DrawLights lights;
+    if (lightSelection)
+        lightSelection->select(center, extent, lights, (lightmaps && mesh.hasLightmap()) || probe != ProbeLighting::NONE);
+    push(pass, program, mesh.material.id, center, command, &model, &mesh, lights, probe);
+}
+
+void RenderQueue::submitArrays(Render_Pass pass, unsigned int program, GLuint vertexArray, GLsizei vertexCount,
+                               const VecMat::mat4 *model, const glm::vec3 &center,
+                               GLenum textureTarget, GLuint texture, GLuint condition)
+{
+    // a lone texture on unit 0 is a material of its own, 0 for untextured draws
+    unsigned int material = 0;
+    if (texture)
+    {
+        MaterialBinding binding;
+        binding.textures[0] = texture;
+        binding.shininess = 0.0f;   // never equal to a mesh material, those are at least 1
+        material = registerMaterial(binding);
+    }
+
+    Command command = {nullptr, 0, vertexArray, vertexCount, textureTarget, texture, false, 0, 0, false, condition};
+    push(pass, program, material, center, command, model, (const void *)(size_t)vertexArray);
+}
+
+// LSD radix sort on the key bytes, skipping the bytes every key has in common
+void RenderQueue::sort()
+{
+    size_t count = items.size();
+    if (count < 2)
+        return;
+    scratch.resize(count);
+
+    unsigned int histogram[8][256] = {};
+    for (const RenderItem &item : items)
+        for (int byte = 0; byte < 8; byte++)
+            histogram[byte][(item.key >> (byte * 8)) & 0xff]++;
+
+    RenderItem *from = items.data(), *to = scratch.data();
+    for (int byte = 0; byte < 8; byte++)
+    {
+        unsigned int *bucket = histogram[byte];
+        if (bucket[(from[0].key >> (byte * 8)) & 0xff] == count)
+            continue;
+
+        unsigned int offset = 0;
+        for (int i = 0; i < 256; i++)
+        {
+            unsigned int size = bucket[i];
+            bucket[i] = offset;
+            offset += size;
+        }
+        for (size_t i = 0; i < count; i++)
+            to[bucket[(from[i].key >> (byte * 8)) & 0xff]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != items.data())
+        items.swap(scratch);
+}
+
+// groups the matrices by command (counting sort) and writes them to the upload ring
+void RenderQueue::uploadInstances()
+{
+    unsigned int offset = 0;
+    for (Command &command : commands)
+    {
+        command.firstInstance = offset;
+        offset += command.instanceCount;
+        command.instanceCount = 0;
+    }
+    instanceUpload.resize(instanceMatrix.size());
+    instanceLightsUpload.resize(instanceLights.size());
+    instanceProbesUpload.resize(instanceProbes.size());
+    for (size_t i = 0; i < instanceMatrix.size(); i++)
+    {
+        Command &command = commands[instanceCommand[i]];
+        unsigned int instance = command.firstInstance + command.instanceCount++;
+        instanceUpload[instance] = instanceMatrix[i];
+        instanceLightsUpload[instance] = instanceLights[i];
+        instanceProbesUpload[instance] = instanceProbes[i];
+    }
+    if (instanceUpload.empty())
+        return;
+
+    instanceOffset = frameUploads.write(instanceUpload.data(), instanceUpload.size() * sizeof(VecMat::mat4));
+    instanceLightsOffset = frameUploads.write(instanceLightsUpload.data(), instanceLightsUpload.size() * sizeof(DrawLights));
+    instanceProbesOffset = frameUploads.write(instanceProbesUpload.data(), instanceProbesUpload.size() * sizeof(uint32_t));
+}
+
+// points the instance attributes of the bound vertex array at a command's matrices, lights and probe entries
+void RenderQueue::bindInstances(GLuint vertexArray, unsigned int firstInstance)
+{
+    bool enabled = std::find(instancedArrays.begin(), instancedArrays.end(), vertexArray) != instancedArrays.end();
+    glState.bindBuffer(GL_ARRAY_BUFFER, frameUploads.buffer());
+    for (GLuint column = 0; column < 4; column++)
+    {
+        GLuint location = INSTANCE_MATRIX_LOCATION + column;
+        if (!enabled)
+        {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        size_t offset = instanceOffset + (size_t(firstInstance) * 4 + column) * 4 * sizeof(float);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(VecMat::mat4), (void *)offset);
+    }
+    if (!enabled)
+    {
+        glEnableVertexAttribArray(INSTANCE_LIGHTS_LOCATION);
+        glVertexAttribDivisor(INSTANCE_LIGHTS_LOCATION, 1);
+        glEnableVertexAttribArray(INSTANCE_PROBE_LOCATION);
+        glVertexAttribDivisor(INSTANCE_PROBE_LOCATION, 1);
+        instancedArrays.push_back(vertexArray);
+    }
+    size_t offset = instanceLightsOffset + size_t(firstInstance) * sizeof(DrawLights);
+    glVertexAttribIPointer(INSTANCE_LIGHTS_LOCATION, DrawLights::COUNT, GL_UNSIGNED_SHORT, sizeof(DrawLights), (void *)offset);
+    offset = instanceProbesOffset + size_t(firstInstance) * sizeof(uint32_t);
+    glVertexAttribIPointer(INSTANCE_PROBE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void *)offset);
+}
+
+// one indirect command per unconditional mesh command, in the order execute() walks them
+void RenderQueue::uploadIndirect()
+{
+    indirect.clear();
+    for (const RenderItem &item : items)
+    {
+        const Command &command = commands[item.command];
+        if (command.mesh && !command.condition)
+            indirect.push_back(command.mesh->indirectCommand(command.lod, command.instanceCount, command.firstInstance));
+    }
+    if (indirect.empty())
+        return;
+
+    indirectOffset = frameUploads.write(indirect.data(), indirect.size() * sizeof(DrawElementsIndirectCommand));
+}
+
+// lays down the depth of every opaque mesh from its position stream, front to back and
+// without material changes, so the shading pass only runs for the visible fragments
+void RenderQueue::depthPrepass(bool useIndirect)
+{
+    prepassIndirect.clear();
+    for (const RenderItem &item : items)
+    {
+        Command &command = commands[item.command];
+        if (unsigned(item.key >> 60) != PASS_OPAQUE || !command.mesh || !command.mesh->hasPositionStream())
+            continue;
+        command.prepassed = true;
+        prepassIndirect.push_back(command.mesh->positionIndirectCommand(command.lod, command.instanceCount, command.firstInstance));
+    }
+    if (prepassIndirect.empty())
+        return;
+
+    glState.colorMask(false);
+    glState.depthFunc(GL_LESS);
+    glState.depthMask(true);
+    depthShader->Bind();
+    positionArena().bind();
+    frameStats.programChanges++;
+    frameStats.vertexArrayChanges++;
+
+    if (useIndirect)
+    {
+        GLintptr offset = frameUploads.write(prepassIndirect.data(), prepassIndirect.size() * sizeof(DrawElementsIndirectCommand));
+        bindInstances(positionArena().vertexArray(), 0);
+        glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, frameUploads.buffer());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)offset, GLsizei(prepassIndirect.size()), 0);
+        for (const DrawElementsIndirectCommand &draw : prepassIndirect)
+        {
+            frameStats.instances += draw.instanceCount;
+            frameStats.triangles += (unsigned long long)(draw.count / 3) * draw.instanceCount;
+        }
+        frameStats.drawCalls++;
+        frameStats.indirectDraws += (unsigned int)prepassIndirect.size();
+    }
+    else
+    {
+        for (const RenderItem &item : items)
+        {
+            const Command &command = commands[item.command];
+            if (!command.prepassed)
+                continue;
+            bindInstances(positionArena().vertexArray(), command.firstInstance);
+            command.mesh->drawPositions(command.lod, command.instanceCount);
+        }
+    }
+    glState.colorMask(true);
+}
+
+void RenderQueue::execute()
+{
+    sort();
+    uploadInstances();
+    bool useIndirect = multiDrawActive();
+
+    // the prepass writes to the upload ring too, before the main pass's indirect commands
+    if (depthPrepassActive())
+    {
+        prepassTimer.begin();
+        depthPrepass(useIndirect);
+        prepassTimer.end();
+    }
+    if (useIndirect)
+        uploadIndirect();
+    mainTimer.begin();
+
+    const unsigned int NONE = 0xffffffffu;
+    unsigned int program = NONE, material = NONE;
+    GLuint vertexArray = NONE;
+    unsigned int nextIndirect = 0;
+    bool proxiesDrawn = false;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        const RenderItem &item = items[i];
+        const Command &command = commands[item.command];
+        unsigned int itemPass = unsigned(item.key >> 60);
+        unsigned int itemProgram = unsigned(item.key >> 52) & 0xff;
+        unsigned int itemMaterial = unsigned(item.key >> 32) & 0xfffff;
+        const Shader &shader = *programs[itemProgram];
+
+        // every unconditional opaque draw is in the depth buffer now, the queries test against it
+        if (!proxiesDrawn && itemPass != PASS_OPAQUE)
+        {
+            proxiesDrawn = true;
+            if (occlusionQueries)
+                occlusionQueries->issue();
+            program = material = vertexArray = NONE;
+        }
+
+        // depth the prepass wrote is only tested, equal passes since both programs are invariant
+        glState.depthFunc(itemPass == PASS_SKY || command.prepassed ? GL_LEQUAL : GL_LESS);
+        glState.depthMask(!command.prepassed);
+        if (itemProgram != program)
+        {
+            program = itemProgram;
+            shader.Bind();
+            // the shininess uniform belongs to the program, so the material has to be set again
+            material = NONE;
+            frameStats.programChanges++;
+        }
+        if (itemMaterial != material)
+        {
+            material = itemMaterial;
+            if (command.mesh)
+                command.mesh->bindMaterial(shininessLocations[itemProgram]);
+            else if (command.texture)
+            {
+                glState.bindTexture(0, command.textureTarget, command.texture);
+            }
+            frameStats.materialChanges++;
+        }
+
+        GLuint itemArray = command.mesh ? command.mesh->vertexArena().vertexArray() : command.vertexArray;
+        if (itemArray != vertexArray)
+        {
+            vertexArray = itemArray;
+            glState.bindVertexArray(vertexArray);
+            frameStats.vertexArrayChanges++;
+        }
+
+        if (useIndirect && command.mesh && !command.condition)
+        {
+            // every following mesh item with the same pass, program, material, depth state and arena joins the call
+            size_t end = i + 1;
+            while (end < items.size() && (items[end].key >> 32) == (item.key >> 32) && commands[items[end].command].mesh &&
+                   commands[items[end].command].prepassed == command.prepassed && !commands[items[end].command].condition &&
+                   commands[items[end].command].mesh->vertexArena().vertexArray() == vertexArray)
+                end++;
+            GLsizei count = GLsizei(end - i);
+
+            bindInstances(vertexArray, 0);
+            glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, frameUploads.buffer());
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        (void *)(indirectOffset + size_t(nextIndirect) * sizeof(DrawElementsIndirectCommand)),
+                                        count, 0);
+            for (GLsizei k = 0; k < count; k++)
+            {
+                const DrawElementsIndirectCommand &draw = indirect[nextIndirect + k];
+                frameStats.instances += draw.instanceCount;
+                frameStats.triangles += (unsigned long long)(draw.count / 3) * draw.instanceCount;
+            }
+            frameStats.drawCalls++;
+            frameStats.indirectDraws += count;
+            nextIndirect += count;
+            i = end - 1;
+            continue;
+        }
+
+        if (command.condition)
+            glBeginConditionalRender(command.condition, GL_QUERY_WAIT);
+        unsigned int instances = 1;
+        if (command.instanced)
+        {
+            bindInstances(vertexArray, command.firstInstance);
+            instances = command.instanceCount;
+        }
+        else
+            setInstanceDefaults();
+        if (command.mesh)
+            command.mesh->drawGeometry(command.lod, instances);
+        else
+        {
+            if (instances == 1)
+                glDrawArrays(GL_TRIANGLES, 0, command.vertexCount);
+            else
+                glDrawArraysInstanced(GL_TRIANGLES, 0, command.vertexCount, instances);
+            frameStats.drawCalls++;
+            frameStats.instances += instances;
+            frameStats.triangles += (unsigned long long)(command.vertexCount / 3) * instances;
+        }
+        if (command.condition)
+            glEndConditionalRender();
+    }
+    if (!proxiesDrawn && occlusionQueries)
+        occlusionQueries->issue();
+
+    mainTimer.end();
+    frameStats.gpuPrepassMs = depthPrepassActive() ? prepassTimer.milliseconds() : 0.0f;
+    frameStats.gpuMainMs = mainTimer.milliseconds();
+
+    // the state cache tracks what is bound, so only the depth mask glClear needs is restored
+    glState.depthMask(true);
+}
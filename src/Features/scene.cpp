@@ -0,0 +1,80 @@
+#include "scene.hpp"
+
+Object *Scene::add(std::string name)
+{
+    objects.push_back(std::make_unique<Object>(name));
+    Object *object = objects.back().get();
+    object->setScale(3.0f, 3.0f, 3.0f);
+    object->setRotationVector(0, 1, 0);
+    root.addObject(object);
+    return object;
+}
+
+void buildScene(Scene &scene)
+{
+    Object *roomObjects = scene.add("roomObj");
+    roomObjects->setPosition(0.0f, 0.0f, 0.0f);
+    roomObjects->setAngle(0);
+    roomObjects->setModelName("../resources/models/Room/room4walls.obj");
+    roomObjects->setStatic(true);
+    roomObjects->setOccluder(true);
+
+    Object *door = scene.add("door");
+    door->setPosition(0.0f, 0.0f, -0.05f);
+    door->setAngle(0);
+    door->setModelName("../resources/models/Door/door.obj");
+    door->setModelLoader(LOADER_NATIVE_OBJ);
+    door->setOccluder(true);
+
+    Object *blueCard = scene.add("blueCard");
+    blueCard->setPosition(-3.58f, 0.02f, -3.28f);
+    blueCard->setAngle(35);
+    blueCard->setModelName("../resources/models/Room/blueC.obj");
+    blueCard->setModelLoader(LOADER_NATIVE_OBJ);
+
+    Object *redCard = scene.add("redCard");
+    redCard->setPosition(3.69f, 1.10f, -4.17f);
+    redCard->setAngle(0);
+    redCard->setModelName("../resources/models/Room/redC.obj");
+    redCard->setModelLoader(LOADER_NATIVE_OBJ);
+
+    Object *greenCard = scene.add("greenCard");
+    greenCard->setPosition(-3.36f, 4.79f, -4.86f);
+    greenCard->setAngle(0);
+    greenCard->setModelName("../resources/models/Room/greenC.obj");
+    greenCard->setModelLoader(LOADER_NATIVE_OBJ);
+
+    Object *yellowCard = scene.add("yellowCard");
+    yellowCard->setPosition(2.30f, 0.93f, 2.87f);
+    yellowCard->setAngle(0);
+    yellowCard->setModelName("../resources/models/Room/yellowC.obj");
+    yellowCard->setModelLoader(LOADER_NATIVE_OBJ);
+}
+
+namespace
+{
+    PointLight dayLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse,
+                        float constant, float linear, float quadratic)
+    {
+        PointLight light;
+        light.position = position;
+        light.ambient = ambient;
+        light.diffuse = diffuse;
+        light.specular = glm::vec3(1.0f);
+        light.constant = constant;
+        light.linear = linear;
+        light.quadratic = quadratic;
+        light.baked = true;
+        return light;
+    }
+}
+
+std::vector<PointLight> dayLights()
+{
+    return {
+        dayLight(glm::vec3(0.8f, 6.0f, -5.1f), glm::vec3(0.05f), glm::vec3(0.8f), 1.0f, 0.09f, 0.032f),
+        dayLight(glm::vec3(-0.8f, 6.0f, -5.1f), glm::vec3(0.05f), glm::vec3(0.8f), 1.0f, 0.09f, 0.042f),
+        dayLight(glm::vec3(3.55f, 2.1f, -4.6f), glm::vec3(0.05f), glm::vec3(1.0f, 1.0f, 0.5f), 1.0f, 0.09f, 0.0032f),
+        dayLight(glm::vec3(0.0f, 40.0f, 0.0f), glm::vec3(0.15f), glm::vec3(0.8f), 0.01f, 0.0004f, 0.0013f),
+    };
+}
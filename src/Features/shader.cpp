@@ -1,4 +1,6 @@
 #include "shader.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
 Shader::Shader(const char *vertexPath, const char *fragmentPath)
 {
     // 1. retrieve the vertex/fragment src code from filePath
@@ -58,16 +60,59 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath)
     glDeleteShader(fragment);
 }
 
+Shader::Shader(const char *computePath)
+{
+    std::string computeCode;
+    std::ifstream cShaderFile;
+    cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try
+    {
+        cShaderFile.open(computePath);
+        std::stringstream cShaderStream;
+        cShaderStream << cShaderFile.rdbuf();
+        cShaderFile.close();
+        computeCode = cShaderStream.str();
+    }
+    catch (std::ifstream::failure &e)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+    }
+    const char *cShaderCode = computeCode.c_str();
+
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    checkCompileErrors(ID, "PROGRAM");
+    glDeleteShader(compute);
+}
+
 // activate the shader
 // ------------------------------------------------------------------------
 void Shader::Bind() const
 {
-    glUseProgram(ID);
+    glState.useProgram(ID);
 }
 
 void Shader::Unbind() const
 {
-    glUseProgram(0);
+    glState.useProgram(0);
+}
+
+int Shader::uniformLocation(const std::string &name) const
+{
+    return glGetUniformLocation(ID, name.c_str());
+}
+
+void Shader::bindUniformBlock(const std::string &name, unsigned int binding) const
+{
+    GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
 }
 
 int Shader::GetUniformLocation(const std::string &name)
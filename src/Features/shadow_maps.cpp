@@ -0,0 +1,226 @@
+#include "shadow_maps.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+// the faces' near plane, casters closer to the light than this are clipped
+const float SHADOW_NEAR = 0.05f;
+
+namespace
+{
+    // look direction and up vector of each face, the cube map convention (+x, -x, +y, -y, +z, -z);
+    // mainfragment.fs picks the face and its texel with the same table
+    const glm::vec3 FACE_DIR[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const glm::vec3 FACE_UP[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+
+    // FNV-1a
+    uint64_t hashBytes(uint64_t hash, const void *data, size_t bytes)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < bytes; i++)
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        return hash;
+    }
+}
+
+ShadowMaps::~ShadowMaps()
+{
+    delete program;
+    glDeleteTextures(1, &staticFaces);
+    glDeleteTextures(1, &faces);
+    glDeleteFramebuffers(1, &drawFramebuffer);
+    glDeleteFramebuffers(1, &readFramebuffer);
+}
+
+GLuint ShadowMaps::createArray(bool compare)
+{
+    GLuint array;
+    glGenTextures(1, &array);
+    glState.activeTexture(TEXTURE_SHADOW_MAPS);
+    glState.bindTexture(GL_TEXTURE_2D_ARRAY, array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SIZE, SIZE, SLOTS * 6, 0, GL_DEPTH_COMPONENT,
+                 GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // the sampled array compares in the texture unit, LINEAR filters the four results (2x2 PCF)
+    GLint filter = compare ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    if (compare)
+    {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    return array;
+}
+
+void ShadowMaps::init(const char *vertexPath, const char *fragmentPath)
+{
+    program = new Shader(vertexPath, fragmentPath);
+    viewLocation = program->uniformLocation("view");
+    projectionLocation = program->uniformLocation("projection");
+    modelLocation = program->uniformLocation("model");
+    lightLocation = program->uniformLocation("lightPosition");
+    rangeLocation = program->uniformLocation("range");
+
+    staticFaces = createArray(false);
+    faces = createArray(true);
+    glGenFramebuffers(1, &drawFramebuffer);
+    glGenFramebuffers(1, &readFramebuffer);
+    // depth only, a framebuffer without colour is only complete with its draw and read buffer off;
+    // both act on the framebuffer bound to their own target, so each one is bound to both
+    for (GLuint framebuffer : {drawFramebuffer, readFramebuffer})
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticFaces, 0, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SHADOW_MAPS:: depth framebuffer is incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMaps::beginFrame()
+{
+    staticCasters.clear();
+    dynamicCasters.clear();
+    staticHash = 14695981039346656037ull;
+}
+
+void ShadowMaps::addCaster(const Mesh &mesh, const VecMat::mat4 &transform, bool dynamic)
+{
+    Caster caster;
+    caster.mesh = &mesh;
+    caster.transform = transform;
+    transformBox(transform, mesh.boundsMin, mesh.boundsMax, caster.center, caster.extent);
+    if (dynamic)
+        dynamicCasters.push_back(caster);
+    else
+    {
+        const Mesh *pointer = &mesh;
+        staticHash = hashBytes(staticHash, &pointer, sizeof(pointer));
+        staticHash = hashBytes(staticHash, transform.mat, sizeof(transform.mat));
+        staticCasters.push_back(caster);
+    }
+}
+
+bool ShadowMaps::reaches(const Face &face, const Caster &caster)
+{
+    glm::vec3 nearest = glm::clamp(face.light, caster.center - caster.extent, caster.center + caster.extent);
+    glm::vec3 offset = nearest - face.light;
+    return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z <= face.range * face.range &&
+           face.frustum.intersectsBox(caster.center, caster.extent);
+}
+
+void ShadowMaps::renderFace(GLuint array, unsigned int layer, const Face &face, const std::vector<Caster> &casters,
+                            bool clear)
+{
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, array, 0, layer);
+    if (clear)
+        glClear(GL_DEPTH_BUFFER_BIT);
+    glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &face.view.mat[0][0]);
+    glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, &face.projection.mat[0][0]);
+    positionArena().bind();
+    for (const Caster &caster : casters)
+    {
+        if (!reaches(face, caster))
+            continue;
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &caster.transform.mat[0][0]);
+        caster.mesh->drawPositions(0);
+        frameStats.shadowCasterDraws++;
+    }
+}
+
+void ShadowMaps::update(const std::vector<PointLight> &lights, int viewportWidth, int viewportHeight)
+{
+    if (!program)
+        return;
+    timer.begin();
+    bool bound = false;
+    for (const PointLight &light : lights)
+    {
+        if (light.shadow < 0 || light.shadow >= (int)SLOTS)
+            continue;
+        Slot &slot = slots[light.shadow];
+        float range = light.shadowRange();
+        bool redraw = !slot.cached || slot.position != light.position || slot.range != range || slot.hash != staticHash;
+
+        Face face[6];
+        uint8_t dynamicFaces = 0;
+        for (int f = 0; f < 6; f++)
+        {
+            glm::vec3 target = light.position + FACE_DIR[f];
+            face[f].view = VecMat::lookAt(VecMat::vec3(light.position.x, light.position.y, light.position.z),
+                                          VecMat::vec3(target.x, target.y, target.z),
+                                          VecMat::vec3(FACE_UP[f].x, FACE_UP[f].y, FACE_UP[f].z));
+            face[f].projection = VecMat::perspective(90.0f, 1.0f, SHADOW_NEAR, range);
+            face[f].frustum.extract(face[f].projection, face[f].view);
+            face[f].light = light.position;
+            face[f].range = range;
+            for (const Caster &caster : dynamicCasters)
+                if (reaches(face[f], caster))
+                {
+                    dynamicFaces |= 1 << f;
+                    break;
+                }
+        }
+        // nothing changed and no dynamic caster now or last frame: the sampled faces are still right
+        if (!redraw && !dynamicFaces && !slot.dynamicFaces)
+            continue;
+
+        if (!bound)
+        {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+            glViewport(0, 0, SIZE, SIZE);
+            glState.setEnabled(GL_DEPTH_TEST, true);
+            glState.depthMask(true);
+            glState.depthFunc(GL_LESS);
+            program->Bind();
+            bound = true;
+        }
+        glUniform3fv(lightLocation, 1, &light.position.x);
+        glUniform1f(rangeLocation, range);
+
+        for (int f = 0; f < 6; f++)
+        {
+            unsigned int layer = light.shadow * 6 + f, bit = 1u << f;
+            if (redraw)
+            {
+                renderFace(staticFaces, layer, face[f], staticCasters, true);
+                frameStats.shadowStaticFaces++;
+            }
+            if (!redraw && !((dynamicFaces | slot.dynamicFaces) & bit))
+                continue;
+            // the cached static depth, then this frame's dynamic casters over it
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticFaces, 0, layer);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, faces, 0, layer);
+            glBlitFramebuffer(0, 0, SIZE, SIZE, 0, 0, SIZE, SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            if (dynamicFaces & bit)
+            {
+                renderFace(faces, layer, face[f], dynamicCasters, false);
+                frameStats.shadowDynamicFaces++;
+            }
+        }
+        slot.position = light.position;
+        slot.range = range;
+        slot.hash = staticHash;
+        slot.cached = true;
+        slot.dynamicFaces = dynamicFaces;
+    }
+    if (bound)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+    }
+    timer.end();
+    frameStats.shadowMs = timer.milliseconds();
+}
+
+void ShadowMaps::bind() const
+{
+    glState.bindTexture(TEXTURE_SHADOW_MAPS, GL_TEXTURE_2D_ARRAY, faces);
+}
@@ -0,0 +1,339 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    struct Vec3
+    {
+        double x, y, z;
+    };
+
+    Vec3 sub(const Vec3 &a, const Vec3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+    Vec3 cross(const Vec3 &a, const Vec3 &b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+    double dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    double length(const Vec3 &a) { return std::sqrt(dot(a, a)); }
+
+    // symmetric 4x4 error quadric, upper triangle stored row by row
+    struct Quadric
+    {
+        double m[10] = {0};
+
+        void addPlane(const Vec3 &n, double d, double weight)
+        {
+            m[0] += weight * n.x * n.x; m[1] += weight * n.x * n.y; m[2] += weight * n.x * n.z; m[3] += weight * n.x * d;
+            m[4] += weight * n.y * n.y; m[5] += weight * n.y * n.z; m[6] += weight * n.y * d;
+            m[7] += weight * n.z * n.z; m[8] += weight * n.z * d;
+            m[9] += weight * d * d;
+        }
+
+        void add(const Quadric &q)
+        {
+            for (int i = 0; i < 10; i++)
+                m[i] += q.m[i];
+        }
+
+        double evaluate(const Vec3 &p) const
+        {
+            double e = m[0] * p.x * p.x + 2 * m[1] * p.x * p.y + 2 * m[2] * p.x * p.z + 2 * m[3] * p.x
+                     + m[4] * p.y * p.y + 2 * m[5] * p.y * p.z + 2 * m[6] * p.y
+                     + m[7] * p.z * p.z + 2 * m[8] * p.z
+                     + m[9];
+            return e < 0 ? 0 : e;
+        }
+    };
+
+    enum VertexKind : unsigned char { Manifold, Border, Locked };
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+
+    uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (uint64_t(a) << 32) | b;
+    }
+
+    struct PositionHash
+    {
+        size_t operator()(const Vec3 &p) const
+        {
+            float f[3] = {float(p.x), float(p.y), float(p.z)};
+            uint32_t h[3];
+            std::memcpy(h, f, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+
+    struct PositionEqual
+    {
+        bool operator()(const Vec3 &a, const Vec3 &b) const { return a.x == b.x && a.y == b.y && a.z == b.z; }
+    };
+}
+
+std::vector<unsigned int> weldPositions(const float *positions, size_t vertexCount, size_t stride,
+                                        std::vector<float> &packed)
+{
+    std::vector<unsigned int> remap(vertexCount);
+    std::unordered_map<Vec3, unsigned int, PositionHash, PositionEqual> slotOf;
+    slotOf.reserve(vertexCount);
+    packed.clear();
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + i * stride);
+        auto inserted = slotOf.emplace(Vec3{p[0], p[1], p[2]}, (unsigned int)(packed.size() / 3));
+        if (inserted.second)
+            packed.insert(packed.end(), p, p + 3);
+        remap[i] = inserted.first->second;
+    }
+    return remap;
+}
+
+std::vector<unsigned int> simplifyMesh(const float *positions, size_t vertexCount, size_t stride,
+                                       const std::vector<unsigned int> &indices, size_t targetIndexCount,
+                                       float *resultError)
+{
+    std::vector<unsigned int> result = indices;
+    if (resultError)
+        *resultError = 0.0f;
+    if (vertexCount == 0 || indices.size() < 3 || targetIndexCount >= indices.size())
+        return result;
+
+    std::vector<Vec3> pos(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + i * stride);
+        pos[i] = {p[0], p[1], p[2]};
+    }
+
+    // weld vertices that only differ by normal/uv so topology is seen through seams
+    std::vector<unsigned int> rep(vertexCount);
+    std::vector<unsigned int> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<Vec3, unsigned int, PositionHash, PositionEqual> firstAt;
+        firstAt.reserve(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++)
+            rep[i] = firstAt.emplace(pos[i], i).first->second;
+    }
+    {
+        // only count wedges that are actually referenced
+        std::vector<bool> used(vertexCount, false);
+        for (unsigned int index : indices)
+            used[index] = true;
+        for (unsigned int i = 0; i < vertexCount; i++)
+            if (used[i])
+                wedgeCount[rep[i]]++;
+    }
+
+    size_t triangleCount = indices.size() / 3;
+
+    // classify vertices from edge usage in welded space
+    std::unordered_map<uint64_t, unsigned int> edgeUse;
+    edgeUse.reserve(triangleCount * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = rep[indices[t * 3 + e]], b = rep[indices[t * 3 + (e + 1) % 3]];
+            if (a != b)
+                edgeUse[edgeKey(a, b)]++;
+        }
+
+    std::vector<VertexKind> kind(vertexCount, Manifold);
+    std::unordered_set<uint64_t> borderEdges;
+    for (const auto &edge : edgeUse)
+    {
+        unsigned int a = unsigned(edge.first >> 32), b = unsigned(edge.first & 0xffffffffu);
+        if (edge.second == 1)
+        {
+            borderEdges.insert(edge.first);
+            if (kind[a] == Manifold) kind[a] = Border;
+            if (kind[b] == Manifold) kind[b] = Border;
+        }
+        else if (edge.second > 2)
+        {
+            kind[a] = kind[b] = Locked;
+        }
+    }
+    for (unsigned int i = 0; i < vertexCount; i++)
+        if (wedgeCount[rep[i]] > 1)
+            kind[rep[i]] = Locked;
+    for (unsigned int i = 0; i < vertexCount; i++)
+        kind[i] = kind[rep[i]];
+
+    // plane quadrics per welded vertex, plus border planes that keep open edges in place
+    std::vector<Quadric> quadric(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int v[3] = {rep[indices[t * 3]], rep[indices[t * 3 + 1]], rep[indices[t * 3 + 2]]};
+        Vec3 n = cross(sub(pos[v[1]], pos[v[0]]), sub(pos[v[2]], pos[v[0]]));
+        double area = length(n);
+        if (area == 0)
+            continue;
+        n = {n.x / area, n.y / area, n.z / area};
+        double d = -dot(n, pos[v[0]]);
+        for (int k = 0; k < 3; k++)
+            quadric[v[k]].addPlane(n, d, 1.0);
+
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = v[e], b = v[(e + 1) % 3];
+            if (!borderEdges.count(edgeKey(a, b)))
+                continue;
+            Vec3 edge = sub(pos[b], pos[a]);
+            Vec3 bn = cross(edge, n);
+            double len = length(bn);
+            if (len == 0)
+                continue;
+            bn = {bn.x / len, bn.y / len, bn.z / len};
+            double bd = -dot(bn, pos[a]);
+            quadric[a].addPlane(bn, bd, 10.0);
+            quadric[b].addPlane(bn, bd, 10.0);
+        }
+    }
+
+    // vertex -> triangle adjacency on actual vertex ids
+    std::vector<std::vector<unsigned int>> adjacency(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[result[t * 3 + k]].push_back(unsigned(t));
+
+    std::vector<bool> alive(triangleCount, true);
+    size_t liveTriangles = triangleCount;
+    size_t targetTriangles = targetIndexCount / 3;
+    double maxError = 0;
+
+    std::vector<Collapse> candidates;
+    std::vector<bool> touched(vertexCount);
+
+    auto canCollapse = [&](unsigned int from, unsigned int to) {
+        if (kind[from] == Manifold)
+            return true;
+        if (kind[from] == Border)
+            return kind[to] != Manifold && borderEdges.count(edgeKey(rep[from], rep[to])) != 0;
+        return false;
+    };
+
+    // a collapse must not flip (or nearly flip) any of the triangles that survive it
+    auto keepsOrientation = [&](unsigned int from, unsigned int to) {
+        for (unsigned int t : adjacency[from])
+        {
+            if (!alive[t])
+                continue;
+            unsigned int *tri = &result[t * 3];
+            if (rep[tri[0]] == rep[to] || rep[tri[1]] == rep[to] || rep[tri[2]] == rep[to])
+                continue;
+            Vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = pos[tri[k]];
+                q[k] = tri[k] == from ? pos[to] : p[k];
+            }
+            Vec3 before = cross(sub(p[1], p[0]), sub(p[2], p[0]));
+            Vec3 after = cross(sub(q[1], q[0]), sub(q[2], q[0]));
+            double la = length(after);
+            if (la == 0 || dot(before, after) < 0.25 * length(before) * la)
+                return false;
+        }
+        return true;
+    };
+
+    while (liveTriangles > targetTriangles)
+    {
+        candidates.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            if (!alive[t])
+                continue;
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = result[t * 3 + e], b = result[t * 3 + (e + 1) % 3];
+                if (rep[a] == rep[b] || a > b)
+                    continue;
+                Quadric q = quadric[rep[a]];
+                q.add(quadric[rep[b]]);
+                double costA = canCollapse(a, b) ? q.evaluate(pos[b]) : -1;
+                double costB = canCollapse(b, a) ? q.evaluate(pos[a]) : -1;
+                if (costA >= 0 && (costB < 0 || costA <= costB))
+                    candidates.push_back({a, b, costA});
+                else if (costB >= 0)
+                    candidates.push_back({b, a, costB});
+            }
+        }
+        if (candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Collapse &l, const Collapse &r) { return l.cost < r.cost; });
+
+        std::fill(touched.begin(), touched.end(), false);
+        size_t collapsed = 0;
+        for (const Collapse &c : candidates)
+        {
+            if (liveTriangles <= targetTriangles)
+                break;
+            if (touched[c.from] || touched[c.to] || !keepsOrientation(c.from, c.to))
+                continue;
+
+            // border edges leaving the removed vertex will leave its replacement instead
+            std::vector<unsigned int> borderNeighbours;
+            if (kind[c.from] == Border)
+                for (unsigned int t : adjacency[c.from])
+                    if (alive[t])
+                        for (int k = 0; k < 3; k++)
+                        {
+                            unsigned int w = rep[result[t * 3 + k]];
+                            if (w != rep[c.to] && w != c.from && borderEdges.count(edgeKey(c.from, w)))
+                                borderNeighbours.push_back(w);
+                        }
+
+            for (unsigned int t : adjacency[c.from])
+            {
+                if (!alive[t])
+                    continue;
+                unsigned int *tri = &result[t * 3];
+                for (int k = 0; k < 3; k++)
+                {
+                    touched[tri[k]] = true;
+                    if (tri[k] == c.from)
+                        tri[k] = c.to;
+                }
+                if (rep[tri[0]] == rep[tri[1]] || rep[tri[1]] == rep[tri[2]] || rep[tri[0]] == rep[tri[2]])
+                {
+                    alive[t] = false;
+                    liveTriangles--;
+                }
+                else
+                {
+                    adjacency[c.to].push_back(t);
+                }
+            }
+            adjacency[c.from].clear();
+
+            for (unsigned int w : borderNeighbours)
+                borderEdges.insert(edgeKey(rep[c.to], w));
+            quadric[rep[c.to]].add(quadric[rep[c.from]]);
+            maxError = std::max(maxError, c.cost);
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+    }
+
+    std::vector<unsigned int> compact;
+    compact.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (alive[t])
+            compact.insert(compact.end(), &result[t * 3], &result[t * 3] + 3);
+
+    if (resultError)
+        *resultError = float(std::sqrt(maxError));
+    return compact;
+}
@@ -0,0 +1,156 @@
+#include "upload_ring.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "stats.hpp"
+
+#include <cstring>
+#include <iostream>
+
+UploadRing frameUploads;
+
+UploadRing::UploadRing(size_t frameBytes) : frameBytes(frameBytes)
+{
+}
+
+void UploadRing::create(size_t frameBytes)
+{
+    this->frameBytes = frameBytes;
+    glGenBuffers(1, &name);
+    // the copy target leaves the array, uniform and indirect bindings alone
+    glState.bindBuffer(GL_COPY_WRITE_BUFFER, name);
+    if (glCaps.bufferStorage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, frameBytes * FRAMES, NULL, flags);
+        mapped = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, frameBytes * FRAMES, flags);
+        if (mapped)
+            return;
+        // immutable storage can't be respecified, start over with a plain buffer
+        std::cout << "UploadRing: persistent mapping failed, orphaning instead" << std::endl;
+        glDeleteBuffers(1, &name);
+        glState.bufferDeleted(name);
+        glGenBuffers(1, &name);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, name);
+    }
+    glBufferData(GL_COPY_WRITE_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+}
+
+void UploadRing::wait(unsigned int part)
+{
+    if (!fences[part])
+        return;
+    GLenum result = glClientWaitSync(fences[part], 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        frameStats.uploadStalls++;
+        do
+            result = glClientWaitSync(fences[part], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);   // 1 ms
+        while (result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fences[part]);
+    fences[part] = 0;
+}
+
+void UploadRing::beginFrame()
+{
+    if (name == 0)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment > 0)
+            uniformOffsetAlignment = (size_t)alignment;
+        create(frameBytes);
+    }
+    ranges.clear();
+    cursor = 0;
+
+    if (!mapped)
+    {
+        // orphan: the draws still reading last frame's storage keep it, this frame gets a new one
+        base = 0;
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glBufferData(GL_COPY_WRITE_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+        return;
+    }
+
+    frame = (frame + 1) % FRAMES;
+    base = frame * frameBytes;
+    if (drainNext)
+    {
+        for (unsigned int part = 0; part < FRAMES; part++)
+            wait(part);
+        drainNext = false;
+    }
+    else
+        wait(frame);
+}
+
+GLintptr UploadRing::write(const void *data, size_t bytes, size_t alignment)
+{
+    size_t offset = (cursor + alignment - 1) & ~(alignment - 1);
+    if (offset + bytes > frameBytes)
+        grow(offset + bytes);
+    cursor = offset + bytes;
+    frameStats.uploadBytes += (unsigned int)bytes;
+
+    if (mapped)
+        std::memcpy(mapped + base + offset, data, bytes);
+    else
+    {
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, base + offset, bytes, data);
+    }
+    return GLintptr(base + offset);
+}
+
+void UploadRing::bindRange(GLenum target, GLuint index, GLintptr offset, size_t bytes)
+{
+    glState.bindBufferRange(target, index, name, offset, bytes);
+    ranges.push_back({target, index, offset, bytes});
+}
+
+// A write did not fit. The new buffer keeps this frame's data at the same offsets, so
+// everything written so far stays where the caller was told it is. Its later parts may
+// overlap that range, which is why the next frame waits for all fences instead of one.
+void UploadRing::grow(size_t needed)
+{
+    size_t bigger = frameBytes * 2;
+    while (bigger < needed)
+        bigger *= 2;
+    std::cout << "UploadRing: growing to " << bigger / 1024 << " KB per frame" << std::endl;
+
+    for (unsigned int part = 0; part < FRAMES; part++)
+        wait(part);
+
+    GLuint old = name;
+    unsigned char *oldMapping = mapped;
+    size_t oldBase = base;
+    mapped = nullptr;
+    create(bigger);
+    // the frame's part keeps its start (at most 2 old parts in, so it still fits) and is larger now
+    if (cursor > 0)
+    {
+        glState.bindBuffer(GL_COPY_READ_BUFFER, old);
+        glState.bindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, oldBase, oldBase, cursor);
+    }
+    if (oldMapping)
+    {
+        glState.bindBuffer(GL_COPY_READ_BUFFER, old);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    glDeleteBuffers(1, &old);
+    glState.bufferDeleted(old);
+
+    drainNext = mapped != nullptr;
+
+    for (const BoundRange &range : ranges)
+        glState.bindBufferRange(range.target, range.index, name, range.offset, range.bytes);
+}
+
+void UploadRing::endFrame()
+{
+    if (!mapped)
+        return;
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
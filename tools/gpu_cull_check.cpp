@@ -0,0 +1,200 @@
+// Checks the GPU-driven culling path without showing anything: a hidden window gets a
+// GL 4.3+ context (software drivers such as llvmpipe are enough, e.g. LIBGL_ALWAYS_SOFTWARE=1
+// under xvfb-run), a grid of cubes is culled by cull.comp and the surviving draws read back
+// are compared with the CPU frustum test. Also prints the CPU time of culling and of drawing
+// per frame for growing object counts; drawing should stay flat. (A software driver runs the
+// compute shader on the calling thread, inside cull(), so there cull time grows.)
+// Exits with 1 on a mismatch.
+// usage: GpuCullCheck [object count ...]   (defaults to 1000 10000 100000)
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "frame_uniforms.hpp"
+#include "frustum.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "gpu_culling.hpp"
+#include "mesh.hpp"
+#include "render_queue.hpp"
+#include "shader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    const float LOD_SCREEN_SIZE[LOD_MAX_LEVELS - 1] = {0.5f, 0.2f, 0.08f};
+    const int FRAMES = 20;
+
+    Mesh unitCube()
+    {
+        std::vector<Vertex> vertices;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            Vertex v;
+            v.Position = glm::vec3(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f);
+            v.Normal = glm::normalize(v.Position);
+            v.TexCoords = glm::vec2(0.0f);
+            vertices.push_back(v);
+        }
+        std::vector<unsigned int> indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                             2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+        return Mesh(vertices, indices, {});
+    }
+
+    // runs `count` cubes spread over a square in front of the camera, returns the mismatches
+    size_t check(unsigned int count, const Mesh &cube, const Shader &drawShader)
+    {
+        GpuCulling culling;
+        if (!culling.init("../resources/shaders/cull.comp"))
+            return 1;
+
+        // cubes on a grid around the origin, the camera at the front edge looking in
+        unsigned int side = (unsigned int)std::ceil(std::sqrt((double)count));
+        float spacing = 3.0f;
+        std::vector<VecMat::mat4> transforms;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float x = (float(i % side) - side * 0.5f) * spacing, z = -float(i / side) * spacing;
+            transforms.push_back(VecMat::translate(VecMat::mat4(1.0f), VecMat::vec3(x, 0.0f, z)));
+            culling.addMesh(culling.addObject(transforms.back()), cube);
+        }
+        VecMat::vec3 eyePosition(0.0f, 2.0f, 5.0f);
+        VecMat::mat4 projection = VecMat::perspective(45.0f, 16.0f / 9.0f);
+        VecMat::mat4 view = VecMat::lookAt(eyePosition, VecMat::vec3(10.0f, 0.0f, -40.0f), VecMat::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum;
+        frustum.extract(projection, view);
+        glm::vec3 eye(eyePosition.x, eyePosition.y, eyePosition.z);
+        float tanHalfFov = std::tan(to_radians(45.0f / 2.0f));
+
+        FrameUniforms frame = {};
+        frame.projection = projection;
+        frame.view = view;
+        GLuint frameBuffer;
+        glGenBuffers(1, &frameBuffer);
+        glState.bindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), &frame, GL_STATIC_DRAW);
+        glState.bindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameBuffer);
+
+        // the first frame uploads the records, it is not timed
+        RenderQueue queue;
+        culling.cull(frustum, eye, tanHalfFov, LOD_SCREEN_SIZE);
+        culling.draw(drawShader, queue);
+        glFinish();
+        double cullMs = 0.0, drawMs = 0.0;
+        for (int frameIndex = 0; frameIndex < FRAMES; frameIndex++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            culling.cull(frustum, eye, tanHalfFov, LOD_SCREEN_SIZE);
+            auto culled = std::chrono::steady_clock::now();
+            culling.draw(drawShader, queue);
+            auto drawn = std::chrono::steady_clock::now();
+            cullMs += std::chrono::duration<double, std::milli>(culled - start).count();
+            drawMs += std::chrono::duration<double, std::milli>(drawn - culled).count();
+            glFinish();
+        }
+
+        // read back what survived
+        std::vector<DrawElementsIndirectCommand> commands(culling.recordCount());
+        std::vector<GLuint> counts(culling.groupOffsets().size());
+        glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, culling.commandBuffer());
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, culling.countBuffer());
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(GLuint), counts.data());
+        std::vector<char> gpuVisible(count, 0);
+        for (size_t g = 0; g < counts.size(); g++)
+            for (GLuint k = 0; k < counts[g]; k++)
+            {
+                const DrawElementsIndirectCommand &command = commands[culling.groupOffsets()[g] + k];
+                if (command.baseInstance < count)
+                    gpuVisible[command.baseInstance]++;
+            }
+
+        // every object drawn once when the CPU finds it inside, never otherwise; boxes touching
+        // a plane may go either way in float
+        size_t visible = 0, mismatches = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            glm::vec3 center, extent;
+            transformBox(transforms[i], cube.boundsMin, cube.boundsMax, center, extent);
+            bool inside = frustum.intersectsBox(center, extent);
+            visible += inside;
+            if (gpuVisible[i] == (inside ? 1 : 0))
+                continue;
+            bool grown = frustum.intersectsBox(center, extent * 1.001f);
+            bool shrunk = frustum.intersectsBox(center, extent * 0.999f);
+            if (gpuVisible[i] > 1 || grown == shrunk)
+                mismatches++;
+        }
+        std::printf("%8u objects: %zu visible, %zu mismatches, CPU per frame: cull %.3f ms, draw %.3f ms\n",
+                    count, visible, mismatches, cullMs / FRAMES, drawMs / FRAMES);
+
+        glState.bufferDeleted(frameBuffer);
+        glDeleteBuffers(1, &frameBuffer);
+        return mismatches;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<unsigned int> counts;
+    for (int i = 1; i < argc; i++)
+        counts.push_back((unsigned int)std::max(1, std::atoi(argv[i])));
+    if (counts.empty())
+        counts = {1000, 10000, 100000};
+
+    if (!glfwInit())
+    {
+        std::printf("could not initialise GLFW\n");
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    const int contextVersions[][2] = {{4, 6}, {4, 5}, {4, 3}};
+    GLFWwindow *window = nullptr;
+    for (const auto &version : contextVersions)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(64, 64, "GpuCullCheck", nullptr, nullptr);
+        if (window)
+            break;
+    }
+    if (!window)
+    {
+        std::printf("no OpenGL 4.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    loadGlCapabilities((GLADloadproc)glfwGetProcAddress);
+    glState.invalidate();
+    if (!glCaps.computeShaders || !glCaps.multiDrawIndirect)
+    {
+        std::printf("the context has no compute shaders or multi-draw indirect\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    Shader depthShader("../resources/shaders/depth.vs", "../resources/shaders/depth.fs");
+    depthShader.bindUniformBlock("Frame", FRAME_UNIFORM_BINDING);
+    depthShader.Bind();
+    depthShader.setBool("instanced", true);
+    glState.setEnabled(GL_DEPTH_TEST, true);
+
+    size_t mismatches = 0;
+    {
+        Mesh cube = unitCube();
+        for (unsigned int count : counts)
+            mismatches += check(count, cube, depthShader);
+    }
+    std::printf("%s\n", mismatches ? "FAILED" : "ok");
+
+    glfwTerminate();
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+// Checks the clustered light binning without showing anything: a hidden window gets a GL 3.3
+// context (software drivers such as llvmpipe are enough, e.g. LIBGL_ALWAYS_SOFTWARE=1 under
+// xvfb-run), a field of small lights plus a few large ones is binned for a camera, and random
+// points of the view are then looked up the way mainfragment.fs does it (pixel and depth to
+// cluster through the frame's cluster scale). Every light whose sphere holds a point has to be
+// in that point's cluster list. The per draw lists (select()) are checked too: for random
+// boxes they have to hold the DrawLights::COUNT brightest lights at the box, ranked like a
+// brute force ranking of every light (leaving the baked ones out for every other box). Also prints the CPU time of build() per frame and of one
+// select().
+// Exits with 1 on a mismatch.
+// usage: LightClusterCheck [light count ...]   (defaults to 100 1000 10000)
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "frame_uniforms.hpp"
+#include "glcaps.hpp"
+#include "glstate.hpp"
+#include "light_clusters.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const int WIDTH = 1280, HEIGHT = 720;
+    const int FRAMES = 20;
+    const int POINTS = 100000;
+    const int BOXES = 20000;
+
+    // `count` short range lights over a 40 x 10 x 40 box around the origin, and three bright
+    // far reaching ones above it like the day lamps, baked like them
+    void addLights(LightClusters &lights, unsigned int count, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        lights.clear();
+        for (unsigned int i = 0; i < count; i++)
+        {
+            PointLight light;
+            light.position = glm::vec3(unit(rng) * 20.0f, unit(rng) * 5.0f, unit(rng) * 20.0f);
+            light.ambient = glm::vec3(0.0f);
+            light.diffuse = glm::vec3(0.5f);
+            light.specular = glm::vec3(0.2f);
+            light.linear = 0.7f;
+            light.quadratic = 1.8f;
+            lights.add(light);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            PointLight light;
+            light.position = glm::vec3(float(i - 1) * 5.0f, 40.0f, 0.0f);
+            light.ambient = glm::vec3(0.05f);
+            light.diffuse = glm::vec3(0.8f);
+            light.specular = glm::vec3(1.0f);
+            light.constant = 0.01f;
+            light.linear = 0.0004f;
+            light.quadratic = 0.0013f;
+            light.baked = true;
+            lights.add(light);
+        }
+    }
+
+    // world position of a pixel at a view space depth, the inverse of the rigid view matrix
+    glm::vec3 unproject(const VecMat::mat4 &projection, const VecMat::mat4 &view, float x, float y, float depth)
+    {
+        glm::vec3 viewSpace((x / WIDTH * 2.0f - 1.0f) * depth / projection.mat[0][0],
+                            (y / HEIGHT * 2.0f - 1.0f) * depth / projection.mat[1][1], -depth);
+        glm::vec3 offset = viewSpace - glm::vec3(view.mat[3][0], view.mat[3][1], view.mat[3][2]);
+        glm::vec3 world;
+        for (int c = 0; c < 3; c++)
+            world[c] = view.mat[c][0] * offset.x + view.mat[c][1] * offset.y + view.mat[c][2] * offset.z;
+        return world;
+    }
+
+    // select() for random boxes against ranking every light, returns the slots that differ
+    size_t checkSelection(const LightClusters &lights, std::mt19937 &rng)
+    {
+        const std::vector<PointLight> &all = lights.all();
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        size_t wrong = 0;
+        double selectMs = 0.0;
+        std::vector<std::pair<float, unsigned int>> ranking;
+        for (int n = 0; n < BOXES; n++)
+        {
+            glm::vec3 center(unit(rng) * 20.0f, unit(rng) * 5.0f, unit(rng) * 20.0f);
+            glm::vec3 extent = glm::abs(glm::vec3(unit(rng), unit(rng), unit(rng))) * 2.0f + glm::vec3(0.01f);
+            bool skipBaked = n % 2 == 1;
+            DrawLights selected;
+            auto start = std::chrono::steady_clock::now();
+            lights.select(center, extent, selected, skipBaked);
+            selectMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            ranking.clear();
+            for (unsigned int l = 0; l < all.size(); l++)
+            {
+                const PointLight &light = all[l];
+                if (skipBaked && light.baked)
+                    continue;
+                glm::vec3 offset = glm::clamp(light.position, center - extent, center + extent) - light.position;
+                float distance = glm::length(offset);
+                if (distance > light.radius)
+                    continue;
+                float brightest = 0.0f;
+                for (const glm::vec3 &colour : {light.ambient, light.diffuse, light.specular})
+                    brightest = std::max(brightest, std::max(colour.x, std::max(colour.y, colour.z)));
+                float value = brightest / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+                ranking.push_back({-value, l});
+            }
+            std::sort(ranking.begin(), ranking.end());
+            for (unsigned int slot = 0; slot < DrawLights::COUNT; slot++)
+                wrong += selected.index[slot] != (slot < ranking.size() ? ranking[slot].second : DrawLights::END);
+        }
+        std::printf("%8u lights: %d boxes selected for, %zu slots differ from the ranking, select %.4f ms\n",
+                    (unsigned int)all.size(), BOXES, wrong, selectMs / BOXES);
+        return wrong;
+    }
+
+    // bins `count` lights, looks up random points and selects for random boxes, returns the
+    // lights missing from a cluster list plus the selected slots that differ
+    size_t check(unsigned int count)
+    {
+        std::mt19937 rng(count);
+        LightClusters lights;
+        addLights(lights, count, rng);
+        VecMat::mat4 projection = VecMat::perspective(45.0f, float(WIDTH) / HEIGHT);
+        VecMat::mat4 view = VecMat::lookAt(VecMat::vec3(3.0f, 2.0f, 8.0f), VecMat::vec3(0.0f, 1.0f, 0.0f),
+                                           VecMat::vec3(0.0f, 1.0f, 0.0f));
+        FrameUniforms frame = {};
+        double buildMs = 0.0;
+        for (int frameIndex = 0; frameIndex < FRAMES; frameIndex++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            lights.build(projection, view, WIDTH, HEIGHT, frame);
+            buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        const std::vector<uint32_t> &grid = lights.clusterGrid();
+        const std::vector<uint16_t> &indices = lights.clusterIndices();
+        const std::vector<PointLight> &all = lights.all();
+        float nearPlane = projection.mat[3][2] / (projection.mat[2][2] - 1.0f);
+        float farPlane = projection.mat[3][2] / (projection.mat[2][2] + 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        size_t tested = 0, missing = 0;
+        for (int n = 0; n < POINTS; n++)
+        {
+            // depths spread like the slices, over the near half of the range where the lights are
+            float x = unit(rng) * WIDTH, y = unit(rng) * HEIGHT;
+            float depth = nearPlane * std::pow(farPlane / nearPlane, unit(rng) * 0.45f);
+            glm::vec3 world = unproject(projection, view, x, y, depth);
+
+            // the cluster lookup of mainfragment.fs
+            unsigned int cx = std::min((unsigned int)(x * frame.clusterScale.x), frame.clusterDims[0] - 1);
+            unsigned int cy = std::min((unsigned int)(y * frame.clusterScale.y), frame.clusterDims[1] - 1);
+            unsigned int cz = std::min((unsigned int)std::max(std::log(depth) * frame.clusterScale.z + frame.clusterScale.w, 0.0f),
+                                       frame.clusterDims[2] - 1);
+            unsigned int cluster = cx + frame.clusterDims[0] * (cy + frame.clusterDims[1] * cz);
+            const uint16_t *first = indices.data() + grid[2 * cluster];
+            const uint16_t *last = first + grid[2 * cluster + 1];
+
+            // lights right at the edge of their sphere may go either way in float
+            for (unsigned int l = 0; l < all.size(); l++)
+            {
+                if (glm::length(world - all[l].position) >= all[l].radius * 0.999f)
+                    continue;
+                tested++;
+                if (std::find(first, last, (uint16_t)l) == last)
+                    missing++;
+            }
+        }
+        std::printf("%8u lights: %zu light references, %zu lit points tested, %zu missing, build %.3f ms\n",
+                    (unsigned int)all.size(), indices.size(), tested, missing, buildMs / FRAMES);
+        // past the driver's buffer texture size the lists are cut short, lights go missing then
+        if (frameStats.clusterLightRefsDropped)
+        {
+            std::printf("%8u lights: %u references over the buffer texture size, missing ones are expected\n",
+                        (unsigned int)all.size(), frameStats.clusterLightRefsDropped);
+            missing = 0;
+        }
+        return missing + checkSelection(lights, rng);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<unsigned int> counts;
+    for (int i = 1; i < argc; i++)
+        counts.push_back((unsigned int)std::max(1, std::atoi(argv[i])));
+    if (counts.empty())
+        counts = {100, 1000, 10000};
+
+    if (!glfwInit())
+    {
+        std::printf("could not initialise GLFW\n");
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "LightClusterCheck", nullptr, nullptr);
+    if (!window)
+    {
+        std::printf("no OpenGL 3.3 context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    loadGlCapabilities((GLADloadproc)glfwGetProcAddress);
+    glState.invalidate();
+
+    size_t mismatches = 0;
+    for (unsigned int count : counts)
+        mismatches += check(std::min(count, LightClusters::lightCapacity() - 3));
+    std::printf("%s\n", mismatches ? "FAILED" : "ok");
+
+    glfwTerminate();
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,581 @@
+// Bakes the day lights (dayLights() in scene.hpp) into lightmaps for the static objects of the
+// escape room. The static objects are loaded, batched and unwrapped exactly as the renderer does,
+// so meshes and their lightmap coordinates match. Every lightmap texel a triangle covers gets the
+// direct light of each baked light, as CalcPointLight in mainfragment.fs computes it without the
+// specular term, with a shadow ray per light. One bounce of indirect light is added on top:
+// cosine distributed rays from the texel pick up the direct light of whatever they hit, times its
+// diffuse texture. Finally the padding around each chart is filled from the chart's edge.
+// The probe grid for the objects that move is baked from the result: every probe over the box the
+// camera is kept in (ROOM_MIN / ROOM_MAX) sees the day lights directly and the lightmapped static
+// surfaces around it, and keeps that as spherical harmonics. It is written next to the lightmaps.
+// Objects that move (the door included) are left out, their light stays dynamic.
+// usage: LightmapBake [--rays n] [--probe-cell size] [-o out.lightmap]
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "light_clusters.hpp"
+#include "lightmap.hpp"
+#include "model.hpp"
+#include "probe_grid.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // shadow and bounce rays start this far off the surface so they don't hit it again
+    const float RAY_OFFSET = 0.01f;
+
+    // a static mesh as the baker sees it
+    struct BakeMesh
+    {
+        const Mesh *mesh;
+        unsigned int size;              // lightmap texels across, 0 without one
+        const unsigned char *albedo;    // RGBA8 diffuse texture, null when there is none
+        int albedoWidth, albedoHeight;
+    };
+
+    // where a texel's centre lies on the mesh
+    struct Sample
+    {
+        glm::vec3 position, normal;
+        float distance = -1.0f;         // from the triangle in texels, 0 inside, < 0 not covered
+    };
+
+    struct BakeScene
+    {
+        std::vector<BakeMesh> meshes;
+        std::vector<unsigned int> triangleMesh, triangleFirst;  // BVH id -> mesh, its first index
+        TriangleBvh bvh;
+        std::vector<PointLight> lights;
+    };
+
+    // the light CalcPointLight adds for a surface facing `normal`, before the diffuse texture
+    glm::vec3 directLight(const BakeScene &scene, const glm::vec3 &position, const glm::vec3 &normal)
+    {
+        glm::vec3 result(0.0f);
+        for (const PointLight &light : scene.lights)
+        {
+            glm::vec3 toLight = light.position - position;
+            float distance = glm::length(toLight);
+            if (distance >= light.radius || distance <= 0.0f)
+                continue;
+            float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+            float fade = glm::clamp(1.0f - std::pow(distance / light.radius, 4.0f), 0.0f, 1.0f);
+            attenuation *= fade * fade;
+            glm::vec3 dir = toLight / distance;
+            float diff = std::max(glm::dot(normal, dir), 0.0f);
+            if (diff > 0.0f && scene.bvh.occluded(position + normal * RAY_OFFSET, dir, distance - RAY_OFFSET))
+                diff = 0.0f;
+            result += (light.ambient + light.diffuse * diff) * attenuation;
+        }
+        return result;
+    }
+
+    // the diffuse texture at uv, grey for meshes without a readable one
+    glm::vec3 albedoAt(const BakeMesh &mesh, glm::vec2 uv)
+    {
+        if (!mesh.albedo)
+            return glm::vec3(0.5f);
+        // nearest texel, repeating like the sampler
+        int x = (int)std::floor(uv.x * mesh.albedoWidth), y = (int)std::floor(uv.y * mesh.albedoHeight);
+        x = ((x % mesh.albedoWidth) + mesh.albedoWidth) % mesh.albedoWidth;
+        y = ((y % mesh.albedoHeight) + mesh.albedoHeight) % mesh.albedoHeight;
+        const unsigned char *texel = mesh.albedo + 4 * (size_t(y) * mesh.albedoWidth + x);
+        return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+    }
+
+    // the closest point of triangle abc to p (2D), as barycentric weights of b and c
+    glm::vec2 closestOnTriangle(const glm::vec2 &p, const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c)
+    {
+        glm::vec2 ab = b - a, ac = c - a;
+        float d00 = glm::dot(ab, ab), d01 = glm::dot(ab, ac), d11 = glm::dot(ac, ac);
+        float denominator = d00 * d11 - d01 * d01;
+        if (std::fabs(denominator) < 1e-12f)
+            return glm::vec2(0.0f);
+        glm::vec2 ap = p - a;
+        float d20 = glm::dot(ap, ab), d21 = glm::dot(ap, ac);
+        float v = (d11 * d20 - d01 * d21) / denominator, w = (d00 * d21 - d01 * d20) / denominator;
+        if (v >= 0.0f && w >= 0.0f && v + w <= 1.0f)
+            return glm::vec2(v, w);
+        // outside: the nearest of the three edges
+        glm::vec2 best(0.0f);
+        float bestDistance = INFINITY;
+        const glm::vec2 ends[3][2] = {{a, b}, {a, c}, {b, c}};
+        for (int e = 0; e < 3; e++)
+        {
+            glm::vec2 edge = ends[e][1] - ends[e][0];
+            float t = glm::clamp(glm::dot(p - ends[e][0], edge) / std::max(glm::dot(edge, edge), 1e-12f), 0.0f, 1.0f);
+            glm::vec2 offset = ends[e][0] + edge * t - p;
+            float distance = glm::dot(offset, offset);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = e == 0 ? glm::vec2(t, 0.0f) : e == 1 ? glm::vec2(0.0f, t) : glm::vec2(1.0f - t, t);
+            }
+        }
+        return best;
+    }
+
+    // finds the surface point of every texel; texels just outside a triangle (its edge runs
+    // through them) take its nearest point so that bilinear filtering along the edge stays lit
+    void rasterize(const BakeMesh &bake, std::vector<Sample> &samples)
+    {
+        const Mesh &mesh = *bake.mesh;
+        const float size = float(bake.size);
+        samples.assign(size_t(bake.size) * bake.size, Sample());
+        for (unsigned int k = 0; k + 2 < mesh.lods[0].indexCount; k += 3)
+        {
+            const Vertex *v[3] = {&mesh.vertices[mesh.indices[k]], &mesh.vertices[mesh.indices[k + 1]],
+                                  &mesh.vertices[mesh.indices[k + 2]]};
+            glm::vec2 t[3];
+            for (int i = 0; i < 3; i++)
+                t[i] = mesh.lightmapCoords[mesh.indices[k + i]] * size;
+            glm::vec3 geometric = glm::cross(v[1]->Position - v[0]->Position, v[2]->Position - v[0]->Position);
+            if (glm::dot(geometric, geometric) <= 0.0f)
+                continue;
+            int x0 = std::max(0, (int)std::floor(std::min({t[0].x, t[1].x, t[2].x}) - 1.0f));
+            int y0 = std::max(0, (int)std::floor(std::min({t[0].y, t[1].y, t[2].y}) - 1.0f));
+            int x1 = std::min((int)bake.size - 1, (int)std::ceil(std::max({t[0].x, t[1].x, t[2].x}) + 1.0f));
+            int y1 = std::min((int)bake.size - 1, (int)std::ceil(std::max({t[0].y, t[1].y, t[2].y}) + 1.0f));
+            for (int y = y0; y <= y1; y++)
+                for (int x = x0; x <= x1; x++)
+                {
+                    glm::vec2 centre(x + 0.5f, y + 0.5f);
+                    glm::vec2 weights = closestOnTriangle(centre, t[0], t[1], t[2]);
+                    float u = 1.0f - weights.x - weights.y;
+                    float distance = glm::length(t[0] * u + t[1] * weights.x + t[2] * weights.y - centre);
+                    Sample &sample = samples[size_t(y) * bake.size + x];
+                    if (distance > 1.0f || (sample.distance >= 0.0f && sample.distance <= distance))
+                        continue;
+                    sample.distance = distance;
+                    sample.position = v[0]->Position * u + v[1]->Position * weights.x + v[2]->Position * weights.y;
+                    glm::vec3 normal = v[0]->Normal * u + v[1]->Normal * weights.x + v[2]->Normal * weights.y;
+                    sample.normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : glm::normalize(geometric);
+                }
+        }
+    }
+
+    // the light leaving the surface a ray hit back along the ray: what `lit` holds for it (per
+    // mesh, laid out like its lightmap) times the diffuse texture there. False for back faces
+    // (inside walls, under the floor), which give nothing back
+    bool hitLight(const BakeScene &scene, const std::vector<const glm::vec3 *> &lit, const glm::vec3 &dir,
+                  const TriangleBvh::Hit &hit, glm::vec3 &light)
+    {
+        unsigned int id = scene.bvh.triangle(hit.triangle).id;
+        const BakeMesh &bake = scene.meshes[scene.triangleMesh[id]];
+        const Mesh &mesh = *bake.mesh;
+        const unsigned int first = scene.triangleFirst[id];
+        const Vertex &a = mesh.vertices[mesh.indices[first]], &b = mesh.vertices[mesh.indices[first + 1]],
+                     &c = mesh.vertices[mesh.indices[first + 2]];
+        float w = 1.0f - hit.u - hit.v;
+        light = glm::vec3(0.0f);
+        if (glm::dot(a.Normal * w + b.Normal * hit.u + c.Normal * hit.v, dir) >= 0.0f)
+            return false;
+        if (bake.size == 0)
+            return true;
+        const glm::vec2 *coords = mesh.lightmapCoords.data();
+        glm::vec2 texel = (coords[mesh.indices[first]] * w + coords[mesh.indices[first + 1]] * hit.u +
+                           coords[mesh.indices[first + 2]] * hit.v) * float(bake.size);
+        int x = glm::clamp((int)texel.x, 0, (int)bake.size - 1), y = glm::clamp((int)texel.y, 0, (int)bake.size - 1);
+        glm::vec2 uv = a.TexCoords * w + b.TexCoords * hit.u + c.TexCoords * hit.v;
+        light = albedoAt(bake, uv) * lit[scene.triangleMesh[id]][size_t(y) * bake.size + x];
+        return true;
+    }
+
+    // cosine distributed direction around the normal
+    glm::vec3 cosineDirection(const glm::vec3 &normal, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float r = std::sqrt(unit(rng)), phi = 6.2831853f * unit(rng);
+        glm::vec3 tangent = glm::normalize(glm::cross(std::fabs(normal.x) > 0.5f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0), normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) +
+               normal * std::sqrt(std::max(0.0f, 1.0f - r * r));
+    }
+
+    // uniformly distributed direction on the unit sphere
+    glm::vec3 randomDirection(std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float z = 2.0f * unit(rng) - 1.0f;
+        float phi = 6.2831853f * unit(rng);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    // The probe at `position` as irradiance SH in lightmap units (light over pi). The day lights
+    // it sees are deltas, the surfaces around it are sampled with `rays` rays; both are projected
+    // onto the basis and convolved with the clamped cosine. False when a quarter of the rays or
+    // more hit back faces: the probe is inside something and has to borrow its neighbours' light.
+    bool bakeProbe(const BakeScene &scene, const std::vector<const glm::vec3 *> &lit, const glm::vec3 &position,
+                   int rays, std::mt19937 &rng, ProbeGrid::Probe &probe)
+    {
+        // the clamped cosine's SH coefficients per band: pi, 2 pi / 3, pi / 4
+        const float LOBE[SH_COEFFICIENTS] = {3.1415927f, 2.0943951f, 2.0943951f, 2.0943951f, 0.7853982f,
+                                             0.7853982f, 0.7853982f, 0.7853982f, 0.7853982f};
+        float basis[SH_COEFFICIENTS];
+        std::fill(probe.sh, probe.sh + SH_COEFFICIENTS, glm::vec3(0.0f));
+
+        for (const PointLight &light : scene.lights)
+        {
+            glm::vec3 toLight = light.position - position;
+            float distance = glm::length(toLight);
+            if (distance >= light.radius || distance <= 0.0f)
+                continue;
+            float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+            float fade = glm::clamp(1.0f - std::pow(distance / light.radius, 4.0f), 0.0f, 1.0f);
+            attenuation *= fade * fade;
+            // the ambient term has no direction: only the constant band, Y0 times it is the term
+            probe.sh[0] += light.ambient * (attenuation / 0.282095f);
+            glm::vec3 dir = toLight / distance;
+            if (scene.bvh.occluded(position, dir, distance))
+                continue;
+            shBasis(dir, basis);
+            for (unsigned int k = 0; k < SH_COEFFICIENTS; k++)
+                probe.sh[k] += light.diffuse * (attenuation * basis[k] * LOBE[k]);
+        }
+
+        int backFaces = 0;
+        glm::vec3 surfaces[SH_COEFFICIENTS];
+        std::fill(surfaces, surfaces + SH_COEFFICIENTS, glm::vec3(0.0f));
+        for (int r = 0; r < rays; r++)
+        {
+            glm::vec3 dir = randomDirection(rng), light;
+            TriangleBvh::Hit hit;
+            if (!scene.bvh.intersect(position, dir, 1e4f, hit))
+                continue;
+            if (!hitLight(scene, lit, dir, hit, light))
+            {
+                backFaces++;
+                continue;
+            }
+            shBasis(dir, basis);
+            for (unsigned int k = 0; k < SH_COEFFICIENTS; k++)
+                surfaces[k] += light * basis[k];
+        }
+        // Monte Carlo over the sphere (4 pi / rays), then from radiance to light over pi
+        for (unsigned int k = 0; k < SH_COEFFICIENTS && rays > 0; k++)
+            probe.sh[k] += surfaces[k] * (4.0f * LOBE[k] / float(rays));
+        return backFaces * 4 < rays;
+    }
+
+    // probes inside geometry take the average of their valid neighbours, ring by ring
+    unsigned int fillInvalidProbes(ProbeGrid &grid, std::vector<char> &valid)
+    {
+        const int dims[3] = {grid.probeCount(0), grid.probeCount(1), grid.probeCount(2)};
+        const int offsets[6][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+        unsigned int filled = 0;
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            std::vector<char> next = valid;
+            for (int z = 0; z < dims[2]; z++)
+                for (int y = 0; y < dims[1]; y++)
+                    for (int x = 0; x < dims[0]; x++)
+                    {
+                        size_t index = (size_t(z) * dims[1] + y) * dims[0] + x;
+                        if (valid[index])
+                            continue;
+                        ProbeGrid::Probe sum;
+                        std::fill(sum.sh, sum.sh + SH_COEFFICIENTS, glm::vec3(0.0f));
+                        int count = 0;
+                        for (const int *offset : offsets)
+                        {
+                            int nx = x + offset[0], ny = y + offset[1], nz = z + offset[2];
+                            if (nx < 0 || ny < 0 || nz < 0 || nx >= dims[0] || ny >= dims[1] || nz >= dims[2] ||
+                                !valid[(size_t(nz) * dims[1] + ny) * dims[0] + nx])
+                                continue;
+                            const ProbeGrid::Probe &neighbour = grid.probe(nx, ny, nz);
+                            for (unsigned int k = 0; k < SH_COEFFICIENTS; k++)
+                                sum.sh[k] += neighbour.sh[k];
+                            count++;
+                        }
+                        if (!count)
+                            continue;
+                        ProbeGrid::Probe &probe = grid.probe(x, y, z);
+                        for (unsigned int k = 0; k < SH_COEFFICIENTS; k++)
+                            probe.sh[k] = sum.sh[k] / float(count);
+                        next[index] = true;
+                        changed = true;
+                        filled++;
+                    }
+            valid.swap(next);
+        }
+        return filled;
+    }
+
+    // spreads the covered texels into the padding, one ring per pass
+    void dilate(glm::vec3 *texels, std::vector<bool> &covered, unsigned int size)
+    {
+        for (unsigned int pass = 0; pass < LIGHTMAP_PADDING; pass++)
+        {
+            std::vector<bool> next = covered;
+            for (int y = 0; y < (int)size; y++)
+                for (int x = 0; x < (int)size; x++)
+                {
+                    if (covered[size_t(y) * size + x])
+                        continue;
+                    glm::vec3 sum(0.0f);
+                    int count = 0;
+                    for (int dy = -1; dy <= 1; dy++)
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            int nx = x + dx, ny = y + dy;
+                            if (nx < 0 || ny < 0 || nx >= (int)size || ny >= (int)size || !covered[size_t(ny) * size + nx])
+                                continue;
+                            sum += texels[size_t(ny) * size + nx];
+                            count++;
+                        }
+                    if (count)
+                    {
+                        texels[size_t(y) * size + x] = sum / float(count);
+                        next[size_t(y) * size + x] = true;
+                    }
+                }
+            covered.swap(next);
+        }
+    }
+
+    // runs job(0 .. count - 1) on every core, each thread takes the next job
+    template <typename Job>
+    void parallelFor(unsigned int count, const Job &job)
+    {
+        std::atomic<unsigned int> next(0);
+        auto worker = [&]() {
+            for (unsigned int i = next++; i < count; i = next++)
+                job(i);
+        };
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < std::max(1u, std::thread::hardware_concurrency()); t++)
+            threads.emplace_back(worker);
+        worker();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int rays = 128;
+    float probeCell = 1.0f;
+    std::string outPath = SCENE_LIGHTMAP_PATH;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            rays = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--probe-cell") == 0 && i + 1 < argc)
+            probeCell = std::max(0.1f, (float)std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else
+        {
+            std::printf("usage: LightmapBake [--rays n] [--probe-cell size] [-o out.lightmap]\n");
+            return 1;
+        }
+    }
+
+    // static meshes in the renderer's order: objects in scene order, meshes after static batching
+    Scene objects;
+    buildScene(objects);
+    std::vector<Model> models;
+    models.reserve(objects.root.children.size());
+    for (Object *object : objects.root.children)
+    {
+        if (!object->isStatic())
+            continue;
+        models.emplace_back(object->getModelName(), false, object->getModelLoader(), false);
+        models.back().bakeStatic(object->getModelMatrix(), true);
+    }
+
+    BakeScene scene;
+    std::vector<TriangleBvh::Triangle> triangles;
+    std::vector<unsigned int> counts, sizes;
+    std::map<std::string, std::vector<unsigned char>> images;
+    std::map<std::string, glm::ivec2> imageSizes;
+    for (const Model &model : models)
+        for (const Mesh &mesh : model.meshes)
+        {
+            BakeMesh bake = {&mesh, mesh.lightmapSize, nullptr, 0, 0};
+            for (const Textures &texture : mesh.textures)
+            {
+                if (texture.type != "texture_diffuse")
+                    continue;
+                std::string path = model.directory + '/' + texture.path;
+                if (!images.count(path))
+                {
+                    int width, height, channels;
+                    unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+                    images[path] = data ? std::vector<unsigned char>(data, data + size_t(width) * height * 4)
+                                        : std::vector<unsigned char>();
+                    imageSizes[path] = glm::ivec2(width, height);
+                    if (data)
+                        stbi_image_free(data);
+                    else
+                        std::printf("could not read %s, its surfaces bounce grey light\n", path.c_str());
+                }
+                if (!images[path].empty())
+                {
+                    bake.albedo = images[path].data();
+                    bake.albedoWidth = imageSizes[path].x;
+                    bake.albedoHeight = imageSizes[path].y;
+                }
+                break;
+            }
+
+            unsigned int index = (unsigned int)scene.meshes.size();
+            scene.meshes.push_back(bake);
+            counts.push_back(mesh.lods[0].indexCount);
+            counts.push_back((unsigned int)mesh.vertices.size());
+            counts.push_back(mesh.lightmapSize);
+            sizes.push_back(mesh.lightmapSize);
+            for (unsigned int k = 0; k + 2 < mesh.lods[0].indexCount; k += 3)
+            {
+                triangles.push_back({mesh.vertices[mesh.indices[k]].Position, mesh.vertices[mesh.indices[k + 1]].Position,
+                                     mesh.vertices[mesh.indices[k + 2]].Position, (unsigned int)scene.triangleMesh.size()});
+                scene.triangleMesh.push_back(index);
+                scene.triangleFirst.push_back(k);
+            }
+        }
+    if (scene.meshes.empty())
+    {
+        std::printf("no static meshes loaded, nothing to bake\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    scene.bvh.build(triangles);
+    scene.lights = dayLights();
+    for (PointLight &light : scene.lights)
+        light.radius = LightClusters::influenceRadius(light);
+
+    LightmapSet lightmaps;
+    lightmaps.create(sizes, LightmapSet::signatureOf(counts));
+
+    // where each texel is, then its direct light; rows are the jobs
+    const unsigned int meshCount = (unsigned int)scene.meshes.size();
+    std::vector<std::vector<Sample>> samples(meshCount);
+    parallelFor(meshCount, [&](unsigned int m) {
+        if (scene.meshes[m].size)
+            rasterize(scene.meshes[m], samples[m]);
+    });
+    std::vector<std::pair<unsigned int, unsigned int>> rows;
+    for (unsigned int m = 0; m < meshCount; m++)
+        for (unsigned int y = 0; y < scene.meshes[m].size; y++)
+            rows.push_back({m, y});
+    std::vector<std::vector<glm::vec3>> direct(meshCount);
+    std::vector<const glm::vec3 *> directTexels(meshCount);
+    for (unsigned int m = 0; m < meshCount; m++)
+    {
+        direct[m].assign(samples[m].size(), glm::vec3(0.0f));
+        directTexels[m] = direct[m].data();
+    }
+    parallelFor((unsigned int)rows.size(), [&](unsigned int job) {
+        unsigned int m = rows[job].first, size = scene.meshes[m].size;
+        for (unsigned int x = 0; x < size; x++)
+        {
+            const Sample &sample = samples[m][size_t(rows[job].second) * size + x];
+            if (sample.distance >= 0.0f)
+                direct[m][size_t(rows[job].second) * size + x] = directLight(scene, sample.position, sample.normal);
+        }
+    });
+
+    // one bounce, seeded per row so that a bake comes out the same on any number of threads
+    std::atomic<size_t> covered(0);
+    parallelFor((unsigned int)rows.size(), [&](unsigned int job) {
+        unsigned int m = rows[job].first, y = rows[job].second, size = scene.meshes[m].size;
+        std::mt19937 rng((job + 1) * 2654435761u);
+        glm::vec3 *texels = lightmaps.texels(m);
+        for (unsigned int x = 0; x < size; x++)
+        {
+            size_t texel = size_t(y) * size + x;
+            const Sample &sample = samples[m][texel];
+            if (sample.distance < 0.0f)
+                continue;
+            glm::vec3 indirect(0.0f);
+            glm::vec3 origin = sample.position + sample.normal * RAY_OFFSET;
+            for (int r = 0; r < rays; r++)
+            {
+                glm::vec3 dir = cosineDirection(sample.normal, rng);
+                TriangleBvh::Hit hit;
+                glm::vec3 light;
+                if (scene.bvh.intersect(origin, dir, 1e4f, hit) && hitLight(scene, directTexels, dir, hit, light))
+                    indirect += light;
+            }
+            texels[texel] = direct[m][texel] + (rays ? indirect / float(rays) : glm::vec3(0.0f));
+            covered++;
+        }
+    });
+
+    size_t texelTotal = 0;
+    for (unsigned int m = 0; m < meshCount; m++)
+    {
+        unsigned int size = scene.meshes[m].size;
+        texelTotal += size_t(size) * size;
+        std::vector<bool> filled(samples[m].size());
+        for (size_t t = 0; t < filled.size(); t++)
+            filled[t] = samples[m][t].distance >= 0.0f;
+        if (size)
+            dilate(lightmaps.texels(m), filled, size);
+    }
+
+    // the probes see the finished lightmaps, one probe per job
+    std::vector<const glm::vec3 *> litTexels(meshCount);
+    for (unsigned int m = 0; m < meshCount; m++)
+        litTexels[m] = scene.meshes[m].size ? lightmaps.texels(m) : nullptr;
+    glm::vec3 boundsMin(ROOM_MIN.x, ROOM_MIN.y, ROOM_MIN.z), boundsMax(ROOM_MAX.x, ROOM_MAX.y, ROOM_MAX.z);
+    int dims[3];
+    for (int axis = 0; axis < 3; axis++)
+        dims[axis] = std::max(2, (int)std::ceil((boundsMax[axis] - boundsMin[axis]) / probeCell) + 1);
+    ProbeGrid probes;
+    probes.create(boundsMin, boundsMax, dims, lightmaps.signature());
+    const int probeTotal = dims[0] * dims[1] * dims[2];
+    std::vector<char> valid(probeTotal);
+    parallelFor((unsigned int)probeTotal, [&](unsigned int job) {
+        int x = job % dims[0], y = (job / dims[0]) % dims[1], z = job / (dims[0] * dims[1]);
+        std::mt19937 rng((job + 1) * 2246822519u);
+        valid[job] = bakeProbe(scene, litTexels, probes.position(x, y, z), rays * 16, rng, probes.probe(x, y, z));
+    });
+    unsigned int inside = 0;
+    for (char probeValid : valid)
+        inside += !probeValid;
+    unsigned int filled = fillInvalidProbes(probes, valid);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu triangles in %u static meshes, %zu day lights, %d bounce rays per texel\n", triangles.size(),
+                meshCount, scene.lights.size(), rays);
+    std::printf("%zu of %zu lightmap texels covered, %d x %d x %d probes (%u inside geometry, %u filled in) (%.2f s)\n",
+                covered.load(), texelTotal, dims[0], dims[1], dims[2], inside, filled, seconds);
+
+    std::error_code error;
+    fs::path parent = fs::path(outPath).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent, error);
+    if (!lightmaps.save(outPath))
+    {
+        std::printf("could not write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::printf("written to %s (%zu bytes)\n", outPath.c_str(), texelTotal * sizeof(glm::vec3));
+    std::string probePath = fs::path(outPath).replace_extension(".probes").string();
+    if (!probes.save(probePath))
+    {
+        std::printf("could not write %s\n", probePath.c_str());
+        return 1;
+    }
+    std::printf("written to %s (%zu bytes)\n", probePath.c_str(), size_t(probeTotal) * sizeof(ProbeGrid::Probe));
+    return 0;
+}
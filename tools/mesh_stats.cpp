@@ -0,0 +1,408 @@
+// Loads models through the renderer's Model class without a window and reports what they cost:
+// per-mesh counts, duplicate vertices, post-transform cache efficiency, bounds, textures and
+// GPU memory, plus a few validation checks. Exits with 1 when a model has errors.
+// usage: MeshStats [--native] [--cache size] [--json out.json] [model or directory ...]
+//        (defaults to every model under ../resources/models)
+#include "model.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct LodInfo
+{
+    unsigned int triangles;
+    float error;
+};
+
+struct MeshInfo
+{
+    size_t vertices = 0, indices = 0, triangles = 0;
+    float duplicateRatio = 0;       // vertices identical to an earlier one (position, normal and uv)
+    float sharedPositionRatio = 0;  // vertices whose position alone repeats (uv/normal seams)
+    float acmr = 0;                 // cache misses per triangle, 0.5 is ideal and 3 the worst
+    float atvr = 0;                 // cache misses per referenced vertex, 1 is ideal
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    std::vector<LodInfo> lods;
+    std::vector<std::string> textures;
+    size_t gpuBytes = 0;            // vertex buffer plus every LOD of the index buffer
+    size_t positionBytes = 0;       // the position-only stream for depth passes (welded positions + indices)
+    std::vector<std::string> errors, warnings;
+};
+
+struct TextureInfo
+{
+    std::string path;
+    int width, height, channels;
+    size_t gpuBytes;
+};
+
+struct ModelInfo
+{
+    std::string path;
+    std::vector<MeshInfo> meshes;
+    std::vector<TextureInfo> textures;
+    size_t vertices = 0, triangles = 0, geometryBytes = 0, textureBytes = 0;
+    size_t errors = 0, warnings = 0;
+};
+
+namespace
+{
+    struct VertexHash
+    {
+        size_t operator()(const Vertex &v) const
+        {
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+            size_t h = 1469598103934665603ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                h = (h ^ bytes[i]) * 1099511628211ull;
+            return h;
+        }
+    };
+
+    struct VertexEqual
+    {
+        bool operator()(const Vertex &a, const Vertex &b) const { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; }
+    };
+
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            uint32_t h[3];
+            std::memcpy(h, &p.x, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+
+    // FIFO post-transform cache, the model most drivers are closest to
+    size_t cacheMisses(const unsigned int *indices, size_t count, size_t vertexCount, unsigned int cacheSize)
+    {
+        std::vector<size_t> insertedAt(vertexCount, 0);   // 0 = never in the cache
+        size_t misses = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            unsigned int index = indices[i];
+            if (index >= vertexCount)
+                continue;
+            if (insertedAt[index] == 0 || misses - insertedAt[index] + 1 > cacheSize)
+            {
+                misses++;
+                insertedAt[index] = misses;
+            }
+        }
+        return misses;
+    }
+
+    std::string formatName(int channels)
+    {
+        switch (channels)
+        {
+        case 1: return "grey";
+        case 2: return "grey+alpha";
+        case 3: return "rgb";
+        case 4: return "rgba";
+        default: return "unreadable";
+        }
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+                continue;
+            }
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    std::string jsonVec3(const glm::vec3 &v)
+    {
+        char text[96];
+        std::snprintf(text, sizeof(text), "[%g, %g, %g]", v.x, v.y, v.z);
+        return text;
+    }
+
+    std::string jsonList(const std::vector<std::string> &items)
+    {
+        std::string out = "[";
+        for (size_t i = 0; i < items.size(); i++)
+            out += (i ? ", " : "") + jsonString(items[i]);
+        return out + "]";
+    }
+}
+
+MeshInfo analyseMesh(const Mesh &mesh, unsigned int cacheSize)
+{
+    MeshInfo info;
+    const MeshLod &full = mesh.lods[0];
+    info.vertices = mesh.vertices.size();
+    info.indices = full.indexCount;
+    info.triangles = full.indexCount / 3;
+    info.boundsMin = mesh.boundsMin;
+    info.boundsMax = mesh.boundsMax;
+    info.gpuBytes = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+    if (keepPositionStreams && !mesh.vertices.empty())
+    {
+        std::vector<float> positions;
+        std::vector<unsigned int> positionIndices;
+        mesh.buildPositionStream(positions, positionIndices);
+        info.positionBytes = positions.size() * sizeof(float) + positionIndices.size() * sizeof(unsigned int);
+    }
+    for (const MeshLod &lod : mesh.lods)
+        info.lods.push_back({lod.indexCount / 3, lod.error});
+    for (const Textures &texture : mesh.textures)
+        info.textures.push_back(texture.type + ":" + texture.path);
+
+    if (mesh.vertices.empty() || full.indexCount == 0)
+    {
+        info.errors.push_back("empty mesh");
+        return info;
+    }
+    if (full.indexCount % 3 != 0)
+        info.errors.push_back("index count is not a multiple of 3");
+
+    std::unordered_set<Vertex, VertexHash, VertexEqual> unique;
+    std::unordered_set<glm::vec3, PositionHash> positions;
+    size_t nonFinite = 0, zeroNormals = 0;
+    for (const Vertex &v : mesh.vertices)
+    {
+        unique.insert(v);
+        positions.insert(v.Position);
+        if (!std::isfinite(v.Position.x) || !std::isfinite(v.Position.y) || !std::isfinite(v.Position.z))
+            nonFinite++;
+        if (glm::dot(v.Normal, v.Normal) < 1e-12f)
+            zeroNormals++;
+    }
+    info.duplicateRatio = 1.0f - float(unique.size()) / mesh.vertices.size();
+    info.sharedPositionRatio = 1.0f - float(positions.size()) / mesh.vertices.size();
+
+    size_t outOfRange = 0, degenerate = 0;
+    std::vector<bool> referenced(mesh.vertices.size(), false);
+    for (size_t t = 0; t + 2 < full.indexCount; t += 3)
+    {
+        const unsigned int *tri = &mesh.indices[t];
+        if (tri[0] >= info.vertices || tri[1] >= info.vertices || tri[2] >= info.vertices)
+        {
+            outOfRange++;
+            continue;
+        }
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+            degenerate++;
+        referenced[tri[0]] = referenced[tri[1]] = referenced[tri[2]] = true;
+    }
+    size_t used = std::count(referenced.begin(), referenced.end(), true);
+
+    size_t misses = cacheMisses(mesh.indices.data(), full.indexCount, mesh.vertices.size(), cacheSize);
+    info.acmr = info.triangles ? float(misses) / info.triangles : 0.0f;
+    info.atvr = used ? float(misses) / used : 0.0f;
+
+    if (outOfRange)
+        info.errors.push_back(std::to_string(outOfRange) + " triangles index past the vertex buffer");
+    if (nonFinite)
+        info.errors.push_back(std::to_string(nonFinite) + " vertices with non-finite positions");
+    if (degenerate)
+        info.warnings.push_back(std::to_string(degenerate) + " degenerate triangles");
+    if (zeroNormals)
+        info.warnings.push_back(std::to_string(zeroNormals) + " vertices with a zero normal");
+    if (used < mesh.vertices.size())
+        info.warnings.push_back(std::to_string(mesh.vertices.size() - used) + " unreferenced vertices");
+    for (const Textures &texture : mesh.textures)
+        if (texture.width == 0)
+            info.warnings.push_back("texture not found or unreadable: " + texture.path);
+    return info;
+}
+
+ModelInfo analyseModel(const std::string &path, Model_Loader loader, unsigned int cacheSize)
+{
+    ModelInfo info;
+    info.path = path;
+    Model model(path, false, loader, false);
+    if (model.meshes.empty())
+    {
+        info.errors++;
+        return info;
+    }
+
+    for (const Mesh &mesh : model.meshes)
+    {
+        MeshInfo meshInfo = analyseMesh(mesh, cacheSize);
+        info.vertices += meshInfo.vertices;
+        info.triangles += meshInfo.triangles;
+        info.geometryBytes += meshInfo.gpuBytes + meshInfo.positionBytes;
+        info.errors += meshInfo.errors.size();
+        info.warnings += meshInfo.warnings.size();
+        info.meshes.push_back(meshInfo);
+    }
+    // every texture is uploaded as RGBA8 with a full mip chain (4/3 of the base level)
+    for (const Textures &texture : model.textures_loaded)
+    {
+        size_t bytes = size_t(texture.width) * texture.height * 4 * 4 / 3;
+        info.textures.push_back({texture.path, texture.width, texture.height, texture.channels, bytes});
+        info.textureBytes += bytes;
+    }
+    return info;
+}
+
+void printModel(const ModelInfo &model)
+{
+    std::printf("\n%s\n", model.path.c_str());
+    if (model.meshes.empty())
+    {
+        std::printf("  ERROR: no meshes could be loaded\n");
+        return;
+    }
+    for (size_t i = 0; i < model.meshes.size(); i++)
+    {
+        const MeshInfo &mesh = model.meshes[i];
+        std::printf("  mesh %zu: %zu vertices, %zu indices (%zu triangles), %.1f KB + %.1f KB position stream\n",
+                    i, mesh.vertices, mesh.indices, mesh.triangles, mesh.gpuBytes / 1024.0, mesh.positionBytes / 1024.0);
+        std::printf("    duplicates %.1f%%, shared positions %.1f%%, ACMR %.3f, ATVR %.3f\n",
+                    mesh.duplicateRatio * 100, mesh.sharedPositionRatio * 100, mesh.acmr, mesh.atvr);
+        std::printf("    bounds (%g, %g, %g) - (%g, %g, %g)\n", mesh.boundsMin.x, mesh.boundsMin.y, mesh.boundsMin.z,
+                    mesh.boundsMax.x, mesh.boundsMax.y, mesh.boundsMax.z);
+        std::printf("    lods");
+        for (const LodInfo &lod : mesh.lods)
+            std::printf(" %u", lod.triangles);
+        std::printf("\n");
+        for (const std::string &texture : mesh.textures)
+            std::printf("    texture %s\n", texture.c_str());
+        for (const std::string &error : mesh.errors)
+            std::printf("    ERROR: %s\n", error.c_str());
+        for (const std::string &warning : mesh.warnings)
+            std::printf("    warning: %s\n", warning.c_str());
+    }
+    for (const TextureInfo &texture : model.textures)
+        std::printf("  texture %s: %dx%d %s -> RGBA8 + mips, %.1f KB\n", texture.path.c_str(), texture.width,
+                    texture.height, formatName(texture.channels).c_str(), texture.gpuBytes / 1024.0);
+    std::printf("  total: %zu vertices, %zu triangles, geometry %.1f KB, textures %.1f KB, %zu errors, %zu warnings\n",
+                model.vertices, model.triangles, model.geometryBytes / 1024.0, model.textureBytes / 1024.0,
+                model.errors, model.warnings);
+}
+
+std::string toJson(const std::vector<ModelInfo> &models, unsigned int cacheSize)
+{
+    std::ostringstream out;
+    out << "{\n  \"cacheSize\": " << cacheSize << ",\n  \"models\": [";
+    for (size_t m = 0; m < models.size(); m++)
+    {
+        const ModelInfo &model = models[m];
+        out << (m ? "," : "") << "\n    {\n      \"path\": " << jsonString(model.path)
+            << ",\n      \"vertices\": " << model.vertices << ", \"triangles\": " << model.triangles
+            << ", \"geometryBytes\": " << model.geometryBytes << ", \"textureBytes\": " << model.textureBytes
+            << ", \"errors\": " << model.errors << ", \"warnings\": " << model.warnings
+            << ",\n      \"meshes\": [";
+        for (size_t i = 0; i < model.meshes.size(); i++)
+        {
+            const MeshInfo &mesh = model.meshes[i];
+            out << (i ? "," : "") << "\n        {\"vertices\": " << mesh.vertices << ", \"indices\": " << mesh.indices
+                << ", \"triangles\": " << mesh.triangles << ", \"duplicateRatio\": " << mesh.duplicateRatio
+                << ", \"sharedPositionRatio\": " << mesh.sharedPositionRatio << ", \"acmr\": " << mesh.acmr
+                << ", \"atvr\": " << mesh.atvr << ", \"boundsMin\": " << jsonVec3(mesh.boundsMin)
+                << ", \"boundsMax\": " << jsonVec3(mesh.boundsMax) << ", \"gpuBytes\": " << mesh.gpuBytes
+                << ", \"positionBytes\": " << mesh.positionBytes
+                << ", \"lods\": [";
+            for (size_t l = 0; l < mesh.lods.size(); l++)
+                out << (l ? ", " : "") << "{\"triangles\": " << mesh.lods[l].triangles << ", \"error\": " << mesh.lods[l].error << "}";
+            out << "], \"textures\": " << jsonList(mesh.textures) << ", \"errors\": " << jsonList(mesh.errors)
+                << ", \"warnings\": " << jsonList(mesh.warnings) << "}";
+        }
+        out << "\n      ],\n      \"textures\": [";
+        for (size_t i = 0; i < model.textures.size(); i++)
+        {
+            const TextureInfo &texture = model.textures[i];
+            out << (i ? "," : "") << "\n        {\"path\": " << jsonString(texture.path) << ", \"width\": " << texture.width
+                << ", \"height\": " << texture.height << ", \"format\": " << jsonString(formatName(texture.channels))
+                << ", \"gpuBytes\": " << texture.gpuBytes << "}";
+        }
+        out << "\n      ]\n    }";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char **argv)
+{
+    Model_Loader loader = LOADER_ASSIMP;
+    unsigned int cacheSize = 32;
+    std::string jsonPath;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--native") == 0)
+            loader = LOADER_NATIVE_OBJ;
+        else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cacheSize = std::max(3, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else
+            inputs.push_back(argv[i]);
+    }
+    if (inputs.empty())
+        inputs.push_back("../resources/models");
+
+    // directories are searched for anything Assimp can read that the demo uses
+    std::vector<std::string> files;
+    for (const std::string &input : inputs)
+    {
+        std::error_code error;
+        if (!fs::is_directory(input, error))
+        {
+            files.push_back(input);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const fs::directory_entry &entry : fs::recursive_directory_iterator(input, error))
+        {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file() && (extension == ".obj" || extension == ".fbx" || extension == ".gltf" || extension == ".glb"))
+                found.push_back(entry.path().generic_string());
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    std::vector<ModelInfo> models;
+    size_t errors = 0;
+    for (const std::string &file : files)
+    {
+        models.push_back(analyseModel(file, loader, cacheSize));
+        errors += models.back().errors;
+    }
+    for (const ModelInfo &model : models)
+        printModel(model);
+    std::printf("\n%zu models, %zu errors\n", models.size(), errors);
+
+    if (!jsonPath.empty())
+    {
+        std::ofstream json(jsonPath);
+        if (!json)
+        {
+            std::printf("could not write %s\n", jsonPath.c_str());
+            return 1;
+        }
+        json << toJson(models, cacheSize);
+        std::printf("JSON summary written to %s\n", jsonPath.c_str());
+    }
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+// Compares the native OBJ/MTL loader against Assimp on the same files.
+// usage: ObjBenchmark [-n runs] [file.obj ...]   (defaults to the candle and the door)
+#include "objloader.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Result
+{
+    double bestMs = 1e30, totalMs = 0;
+    size_t meshes = 0, vertices = 0, triangles = 0;
+};
+
+template <class Load>
+Result measure(int runs, Load load)
+{
+    Result result;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        load(result);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.bestMs = std::min(result.bestMs, ms);
+        result.totalMs += ms;
+    }
+    return result;
+}
+
+void print(const char *name, const Result &result, int runs)
+{
+    std::printf("  %-12s %4zu meshes %8zu vertices %8zu triangles   best %8.2f ms   mean %8.2f ms\n",
+                name, result.meshes, result.vertices, result.triangles, result.bestMs, result.totalMs / runs);
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 10;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty())
+        files = {"../resources/models/Candle/candle.obj", "../resources/models/Door/door.obj"};
+
+    for (const std::string &file : files)
+    {
+        std::printf("%s (%d runs)\n", file.c_str(), runs);
+
+        // same post-processing as Model::loadModel
+        Result assimp = measure(runs, [&](Result &result) {
+            Assimp::Importer importer;
+            const aiScene *scene = importer.ReadFile(file, aiProcess_Triangulate | aiProcess_FlipUVs |
+                                                           aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+            result.meshes = result.vertices = result.triangles = 0;
+            if (!scene)
+                return;
+            result.meshes = scene->mNumMeshes;
+            for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+            {
+                result.vertices += scene->mMeshes[m]->mNumVertices;
+                result.triangles += scene->mMeshes[m]->mNumFaces;
+            }
+        });
+
+        Result native = measure(runs, [&](Result &result) {
+            ObjScene scene;
+            std::string error;
+            result.meshes = result.vertices = result.triangles = 0;
+            if (!loadObj(file, scene, error))
+            {
+                std::printf("  native loader failed: %s\n", error.c_str());
+                return;
+            }
+            result.meshes = scene.meshes.size();
+            for (const ObjMesh &mesh : scene.meshes)
+            {
+                result.vertices += mesh.vertices.size();
+                result.triangles += mesh.indices.size() / 3;
+            }
+        });
+
+        print("assimp", assimp, runs);
+        print("native", native, runs);
+        if (native.bestMs > 0)
+            std::printf("  speedup      %.1fx\n\n", assimp.bestMs / native.bestMs);
+    }
+    return 0;
+}
@@ -0,0 +1,189 @@
+// Bakes the potentially visible set of the escape room for the box the camera is kept in
+// (ROOM_MIN / ROOM_MAX). The static objects are loaded and baked to world space exactly as the
+// renderer does, so mesh numbers match. For every grid cell rays are shot from points spread
+// over the cell (its corners included) in all directions; the first mesh each ray meets is
+// visible from the cell, a ray that leaves the scene sees the sky. Each cell finally takes in
+// its neighbours' sets, which covers what a few rays per point miss near the cell faces.
+// Objects that move (the door included) are never occluders, so rays pass where they may open.
+// usage: PvsBake [--cell size] [--points n] [--rays n] [-o out.pvs]
+#include "bvh.hpp"
+#include "camera.hpp"
+#include "model.hpp"
+#include "pvs.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // uniformly distributed direction on the unit sphere
+    glm::vec3 randomDirection(std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float z = 2.0f * unit(rng) - 1.0f;
+        float phi = 6.2831853f * unit(rng);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    void bakeCell(const TriangleBvh &bvh, const PotentiallyVisibleSet &pvs, int x, int y, int z, int points, int rays,
+                  uint32_t *bits)
+    {
+        std::mt19937 rng((uint32_t)((z * pvs.cellCount(1) + y) * pvs.cellCount(0) + x) * 2654435761u);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        glm::vec3 origin = pvs.cellMin(x, y, z), size = pvs.cellSize();
+        float reach = 0.0f;
+        for (int axis = 0; axis < 3; axis++)
+            reach += size[axis] * pvs.cellCount(axis);
+
+        for (int p = 0; p < points; p++)
+        {
+            glm::vec3 eye;
+            for (int axis = 0; axis < 3; axis++)
+                eye[axis] = origin[axis] + size[axis] * (p < 8 ? float((p >> axis) & 1) : unit(rng));
+            for (int r = 0; r < rays; r++)
+            {
+                TriangleBvh::Hit hit;
+                // the scene is open (window, door): anything past the far side of the grid counts as sky
+                if (bvh.intersect(eye, randomDirection(rng), reach * 100.0f, hit))
+                    PotentiallyVisibleSet::set(bits, bvh.triangle(hit.triangle).id);
+                else
+                    PotentiallyVisibleSet::set(bits, pvs.skyBit());
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    float cellSize = 1.0f;
+    int points = 24, rays = 2048;
+    std::string outPath = SCENE_PVS_PATH;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--cell") == 0 && i + 1 < argc)
+            cellSize = std::max(0.1f, (float)std::atof(argv[++i]));
+        else if (std::strcmp(argv[i], "--points") == 0 && i + 1 < argc)
+            points = std::max(8, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            rays = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else
+        {
+            std::printf("usage: PvsBake [--cell size] [--points n] [--rays n] [-o out.pvs]\n");
+            return 1;
+        }
+    }
+
+    // static meshes in the renderer's order: objects in scene order, meshes after static batching
+    Scene scene;
+    buildScene(scene);
+    std::vector<TriangleBvh::Triangle> triangles;
+    std::vector<unsigned int> indexCounts;
+    for (Object *object : scene.root.children)
+    {
+        if (!object->isStatic())
+            continue;
+        Model model(object->getModelName(), false, object->getModelLoader(), false);
+        model.bakeStatic(object->getModelMatrix());
+        for (const Mesh &mesh : model.meshes)
+        {
+            unsigned int id = (unsigned int)indexCounts.size();
+            indexCounts.push_back(mesh.lods[0].indexCount);
+            for (unsigned int k = 0; k + 2 < mesh.lods[0].indexCount; k += 3)
+                triangles.push_back({mesh.vertices[mesh.indices[k]].Position, mesh.vertices[mesh.indices[k + 1]].Position,
+                                     mesh.vertices[mesh.indices[k + 2]].Position, id});
+        }
+    }
+    if (indexCounts.empty())
+    {
+        std::printf("no static meshes loaded, nothing to bake\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    TriangleBvh bvh;
+    bvh.build(triangles);
+
+    glm::vec3 boundsMin(ROOM_MIN.x, ROOM_MIN.y, ROOM_MIN.z), boundsMax(ROOM_MAX.x, ROOM_MAX.y, ROOM_MAX.z);
+    int dims[3];
+    for (int axis = 0; axis < 3; axis++)
+        dims[axis] = std::max(1, (int)std::ceil((boundsMax[axis] - boundsMin[axis]) / cellSize));
+    PotentiallyVisibleSet sampled;
+    sampled.create(boundsMin, boundsMax, dims, (unsigned int)indexCounts.size(),
+                   PotentiallyVisibleSet::signatureOf(indexCounts));
+
+    // cells are independent, every thread takes the next one
+    const int cellTotal = dims[0] * dims[1] * dims[2];
+    std::atomic<int> nextCell(0);
+    auto worker = [&]() {
+        for (int cell = nextCell++; cell < cellTotal; cell = nextCell++)
+        {
+            int x = cell % dims[0], y = (cell / dims[0]) % dims[1], z = cell / (dims[0] * dims[1]);
+            bakeCell(bvh, sampled, x, y, z, points, rays, sampled.cellBits(x, y, z));
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < std::max(1u, std::thread::hardware_concurrency()); t++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    // each cell takes in its six neighbours
+    PotentiallyVisibleSet pvs;
+    pvs.create(boundsMin, boundsMax, dims, sampled.meshCount(), sampled.signature());
+    const int offsets[7][3] = {{0, 0, 0}, {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+    size_t visibleTotal = 0, skyCells = 0;
+    for (int z = 0; z < dims[2]; z++)
+        for (int y = 0; y < dims[1]; y++)
+            for (int x = 0; x < dims[0]; x++)
+            {
+                uint32_t *bits = pvs.cellBits(x, y, z);
+                for (const int *offset : offsets)
+                {
+                    int nx = x + offset[0], ny = y + offset[1], nz = z + offset[2];
+                    if (nx < 0 || ny < 0 || nz < 0 || nx >= dims[0] || ny >= dims[1] || nz >= dims[2])
+                        continue;
+                    const uint32_t *neighbour = sampled.cellBits(nx, ny, nz);
+                    for (unsigned int w = 0; w < pvs.wordCount(); w++)
+                        bits[w] |= neighbour[w];
+                }
+                for (unsigned int m = 0; m < pvs.meshCount(); m++)
+                    visibleTotal += PotentiallyVisibleSet::test(bits, m);
+                skyCells += PotentiallyVisibleSet::test(bits, pvs.skyBit());
+            }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu triangles in %u static meshes, %d x %d x %d cells of %.2f, %d points x %d rays per cell\n",
+                triangles.size(), pvs.meshCount(), dims[0], dims[1], dims[2], cellSize, points, rays);
+    std::printf("on average %.1f of %u meshes potentially visible, sky seen from %zu of %d cells (%.2f s)\n",
+                double(visibleTotal) / cellTotal, pvs.meshCount(), skyCells, cellTotal, seconds);
+
+    std::error_code error;
+    fs::path parent = fs::path(outPath).parent_path();
+    if (!parent.empty())
+        fs::create_directories(parent, error);
+    if (!pvs.save(outPath))
+    {
+        std::printf("could not write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::printf("written to %s (%zu bytes)\n", outPath.c_str(),
+                size_t(cellTotal) * pvs.wordCount() * sizeof(uint32_t));
+    return 0;
+}